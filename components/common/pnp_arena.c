@@ -0,0 +1,158 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Header associated with this .c file
+#include "pnp_arena.h"
+
+// JSON parsing library
+#include "parson.h"
+
+// IoT core utility related header files
+#include "azure_c_shared_utility/xlogging.h"
+
+// Every allocation is aligned for the widest type parson stores (double).
+#define PNP_ARENA_ALIGNMENT 8
+
+// Arena that PnP_Arena_ScopedMalloc allocates from, or NULL outside of a scope.
+static PNP_ARENA* g_activeArena = NULL;
+
+static bool IsArenaMemory(const PNP_ARENA* arena, const void* ptr)
+{
+    return ((const unsigned char*)ptr >= arena->buffer) && ((const unsigned char*)ptr < arena->buffer + arena->capacity);
+}
+
+void PnP_Arena_Init(PNP_ARENA* arena, void* buffer, size_t capacity)
+{
+    // Align the start of the buffer so every offset handed out stays aligned.
+    uintptr_t start = ((uintptr_t)buffer + PNP_ARENA_ALIGNMENT - 1) & ~(uintptr_t)(PNP_ARENA_ALIGNMENT - 1);
+    size_t skipped = (size_t)(start - (uintptr_t)buffer);
+
+    arena->buffer = (unsigned char*)start;
+    arena->capacity = (capacity > skipped) ? capacity - skipped : 0;
+    arena->used = 0;
+    arena->lastAllocation = 0;
+    arena->highWaterMark = 0;
+    arena->loggedHighWaterMark = 0;
+    arena->heapFallbacks = 0;
+}
+
+bool PnP_Arena_BeginScope(PNP_ARENA* arena)
+{
+    if (g_activeArena != NULL)
+    {
+        LogError("An arena scope is already active");
+        return false;
+    }
+
+    g_activeArena = arena;
+    json_set_allocation_functions(PnP_Arena_ScopedMalloc, PnP_Arena_ScopedFree);
+    return true;
+}
+
+void PnP_Arena_EndScope(void)
+{
+    PNP_ARENA* arena = g_activeArena;
+
+    if (arena == NULL)
+    {
+        return;
+    }
+
+    // Parson keeps no allocations alive between calls, so going back to the heap here cannot strand arena memory.
+    json_set_allocation_functions(malloc, free);
+    g_activeArena = NULL;
+
+    if (arena->highWaterMark > arena->loggedHighWaterMark)
+    {
+        arena->loggedHighWaterMark = arena->highWaterMark;
+        LogInfo("PnP arena high-water mark %lu of %lu bytes, %lu heap fallbacks", (unsigned long)arena->highWaterMark, (unsigned long)arena->capacity, (unsigned long)arena->heapFallbacks);
+    }
+
+    arena->used = 0;
+    arena->lastAllocation = 0;
+}
+
+void* PnP_Arena_ScopedMalloc(size_t size)
+{
+    PNP_ARENA* arena = g_activeArena;
+
+    if (arena == NULL)
+    {
+        return malloc(size);
+    }
+
+    size_t alignedSize = (size + PNP_ARENA_ALIGNMENT - 1) & ~(size_t)(PNP_ARENA_ALIGNMENT - 1);
+    if ((alignedSize < size) || (alignedSize > arena->capacity - arena->used))
+    {
+        arena->heapFallbacks++;
+        return malloc(size);
+    }
+
+    void* ptr = arena->buffer + arena->used;
+    arena->lastAllocation = arena->used;
+    arena->used += alignedSize;
+    // Measured here: frees of the most recent allocation roll used back before the scope ends.
+    if (arena->used > arena->highWaterMark)
+    {
+        arena->highWaterMark = arena->used;
+    }
+    return ptr;
+}
+
+void PnP_Arena_ScopedFree(void* ptr)
+{
+    PNP_ARENA* arena = g_activeArena;
+
+    if (ptr == NULL)
+    {
+        return;
+    }
+    else if ((arena == NULL) || (IsArenaMemory(arena, ptr) == false))
+    {
+        free(ptr);
+    }
+    else if ((unsigned char*)ptr == arena->buffer + arena->lastAllocation)
+    {
+        // Freeing the most recent allocation (e.g. a buffer parson grew and replaced) gives the space back right away.
+        arena->used = arena->lastAllocation;
+    }
+}
+
+char* PnP_Arena_ScopedSprintf(const char* format, ...)
+{
+    va_list args;
+    va_list argsCopy;
+    char* result = NULL;
+    int length;
+
+    va_start(args, format);
+    va_copy(argsCopy, args);
+
+    if ((length = vsnprintf(NULL, 0, format, args)) < 0)
+    {
+        LogError("Unable to size formatted string");
+    }
+    else if ((result = (char*)PnP_Arena_ScopedMalloc((size_t)length + 1)) == NULL)
+    {
+        LogError("Unable to allocate %lu size string", (unsigned long)(length + 1));
+    }
+    else
+    {
+        (void)vsnprintf(result, (size_t)length + 1, format, argsCopy);
+    }
+
+    va_end(argsCopy);
+    va_end(args);
+
+    return result;
+}
+
+size_t PnP_Arena_GetHighWaterMark(const PNP_ARENA* arena)
+{
+    return arena->highWaterMark;
+}
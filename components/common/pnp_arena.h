@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+//
+// A bump allocator for the short-lived allocations made while processing a twin update, a command, or while building
+// reported properties.  On a device with a small heap, thousands of small malloc/free pairs per day (parson nodes, payload
+// copies, formatted JSON) fragment memory over weeks of uptime.  Routing them into a preallocated arena that is reset in O(1)
+// when the callback returns keeps the heap untouched in steady state.
+//
+// Usage: the application wraps each callback in PnP_Arena_BeginScope / PnP_Arena_EndScope.  While a scope is active,
+// parson and the pnp_protocol helpers allocate from the arena.  When the arena is exhausted allocations fall back to the heap,
+// and are counted so the arena can be sized from the field.
+//
+
+#ifndef PNP_ARENA_H
+#define PNP_ARENA_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct PNP_ARENA_TAG
+{
+    unsigned char* buffer;
+    size_t capacity;
+    size_t used;
+    // Start of the most recent allocation, so freeing it can roll the arena back.
+    size_t lastAllocation;
+    // Largest number of bytes in use at any point of any scope.
+    size_t highWaterMark;
+    // High-water mark last logged, so each scope that raises it logs once.
+    size_t loggedHighWaterMark;
+    // Number of allocations that did not fit and were served by the heap.
+    size_t heapFallbacks;
+} PNP_ARENA;
+
+//
+// PnP_Arena_Init prepares arena to hand out memory from buffer.  The buffer must outlive the arena.
+//
+void PnP_Arena_Init(PNP_ARENA* arena, void* buffer, size_t capacity);
+
+//
+// PnP_Arena_BeginScope makes arena the target of PnP_Arena_ScopedMalloc and installs it as parson's allocator.
+// Scopes do not nest; returns false if a scope is already active, in which case the caller must not end it.
+//
+bool PnP_Arena_BeginScope(PNP_ARENA* arena);
+
+//
+// PnP_Arena_EndScope resets the active arena in O(1), restores parson's heap allocator, and logs the high-water mark
+// if the scope raised it.
+//
+void PnP_Arena_EndScope(void);
+
+//
+// PnP_Arena_ScopedMalloc allocates from the active scope's arena, or from the heap when no scope is active or the arena is full.
+//
+void* PnP_Arena_ScopedMalloc(size_t size);
+
+//
+// PnP_Arena_ScopedFree releases memory returned by PnP_Arena_ScopedMalloc.  Arena memory is reclaimed when the scope ends
+// (or immediately, when it was the most recent allocation); heap memory is freed.
+//
+void PnP_Arena_ScopedFree(void* ptr);
+
+//
+// PnP_Arena_ScopedSprintf formats into memory from PnP_Arena_ScopedMalloc.  Release with PnP_Arena_ScopedFree.
+//
+char* PnP_Arena_ScopedSprintf(const char* format, ...);
+
+//
+// PnP_Arena_GetHighWaterMark returns the largest number of bytes arena has had in use at once, measured at each allocation.
+//
+size_t PnP_Arena_GetHighWaterMark(const PNP_ARENA* arena);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PNP_ARENA_H */
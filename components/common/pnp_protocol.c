@@ -1,12 +1,17 @@
 // Copyright (c) Microsoft. All rights reserved.
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 
+#include <stdarg.h>
+
 // Header associated with this .c file
 #include "pnp_protocol.h"
 
 // JSON parsing library
 #include "parson.h"
 
+// Scoped arena allocator
+#include "pnp_arena.h"
+
 // IoT core utility related header files
 #include "azure_c_shared_utility/xlogging.h"
 #include "azure_c_shared_utility/strings.h"
@@ -78,6 +83,48 @@ STRING_HANDLE PnP_CreateReportedPropertyWithStatus(const char* componentName, co
     return jsonToSend;    
 }
 
+char* PnP_FormatReportedProperty(const char* componentName, const char* propertyName, const char* propertyValue)
+{
+    char* jsonToSend;
+
+    if (componentName == NULL) 
+    {
+        jsonToSend = PnP_Arena_ScopedSprintf(g_propertyWithoutResponseSchemaWithoutComponent, propertyName, propertyValue);
+    }
+    else 
+    {
+        jsonToSend = PnP_Arena_ScopedSprintf(g_propertyWithoutResponseSchemaWithComponent, componentName, propertyName, propertyValue);
+    }
+
+    if (jsonToSend == NULL)
+    {
+        LogError("Unable to allocate JSON buffer");
+    }
+
+    return jsonToSend;
+}
+
+char* PnP_FormatReportedPropertyWithStatus(const char* componentName, const char* propertyName, const char* propertyValue, int result, const char* description, int ackVersion)
+{
+    char* jsonToSend;
+
+    if (componentName == NULL) 
+    {
+        jsonToSend = PnP_Arena_ScopedSprintf(g_propertyWithResponseSchemaWithoutComponent, propertyName, propertyValue, result, description, ackVersion);
+    }
+    else 
+    {
+        jsonToSend = PnP_Arena_ScopedSprintf(g_propertyWithResponseSchemaWithComponent, componentName, propertyName, propertyValue, result, description, ackVersion);
+    }
+
+    if (jsonToSend == NULL)
+    {
+        LogError("Unable to allocate JSON buffer");
+    }
+
+    return jsonToSend;
+}
+
 void PnP_ParseCommandName(const char* deviceMethodName, unsigned const char** componentName, size_t* componentNameSize, const char** pnpCommandName)
 {
     const char* separator;
@@ -100,6 +147,39 @@ void PnP_ParseCommandName(const char* deviceMethodName, unsigned const char** co
     }
 }
 
+bool PnP_CreateCommandResponse(unsigned char** response, size_t* responseSize, const char* format, ...)
+{
+    va_list args;
+    va_list argsCopy;
+    int length;
+    bool result;
+
+    va_start(args, format);
+    va_copy(argsCopy, args);
+
+    if ((length = vsnprintf(NULL, 0, format, args)) < 0)
+    {
+        LogError("Unable to size command response");
+        result = false;
+    }
+    else if ((*response = (unsigned char*)malloc((size_t)length + 1)) == NULL)
+    {
+        LogError("Unable to allocate %lu size command response", (unsigned long)(length + 1));
+        result = false;
+    }
+    else
+    {
+        (void)vsnprintf((char*)*response, (size_t)length + 1, format, argsCopy);
+        *responseSize = (size_t)length;
+        result = true;
+    }
+
+    va_end(argsCopy);
+    va_end(args);
+
+    return result;
+}
+
 IOTHUB_MESSAGE_HANDLE PnP_CreateTelemetryMessageHandle(const char* componentName, const char* telemetryData) 
 {
     IOTHUB_MESSAGE_HANDLE messageHandle;
@@ -304,7 +384,7 @@ bool PnP_ProcessTwinData(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned ch
     }
 
     json_value_free(rootValue);
-    free(jsonStr);
+    PnP_Arena_ScopedFree(jsonStr);
 
     return result;
 }
@@ -314,7 +394,7 @@ char* PnP_CopyPayloadToString(const unsigned char* payload, size_t size)
     char* jsonStr;
     size_t sizeToAllocate = size + 1;
 
-    if ((jsonStr = (char*)malloc(sizeToAllocate)) == NULL)
+    if ((jsonStr = (char*)PnP_Arena_ScopedMalloc(sizeToAllocate)) == NULL)
     {
         LogError("Unable to allocate %lu size buffer", (unsigned long)(sizeToAllocate));
     }
@@ -23,9 +23,13 @@ extern "C" {
 // Status codes for PnP, closely mapping to HTTP status.
 //
 #define PNP_STATUS_SUCCESS 200
+#define PNP_STATUS_ACCEPTED 202
 #define PNP_STATUS_BAD_FORMAT 400
 #define PNP_STATUS_NOT_FOUND  404
+#define PNP_STATUS_CONFLICT 409
+#define PNP_STATUS_TOO_MANY_REQUESTS 429
 #define PNP_STATUS_INTERNAL_ERROR 500
+#define PNP_STATUS_SERVICE_UNAVAILABLE 503
 
 //
 // The PnP convention defines the maximum length of a component 
@@ -57,6 +61,13 @@ STRING_HANDLE PnP_CreateReportedProperty(const char* componentName, const char*
 //
 STRING_HANDLE PnP_CreateReportedPropertyWithStatus(const char* componentName, const char* propertyName, const char* propertyValue, int result, const char* description, int ackVersion);
 
+//
+// PnP_FormatReportedProperty and PnP_FormatReportedPropertyWithStatus build the same JSON as the two functions above, but into
+// memory from PnP_Arena_ScopedMalloc.  Inside an arena scope this costs no heap allocation.  Release the result with PnP_Arena_ScopedFree.
+//
+char* PnP_FormatReportedProperty(const char* componentName, const char* propertyName, const char* propertyValue);
+char* PnP_FormatReportedPropertyWithStatus(const char* componentName, const char* propertyName, const char* propertyValue, int result, const char* description, int ackVersion);
+
 // 
 // PnP_ParseCommandName is invoked by the application when an incoming device method arrives.  This function
 // parses the device method name into the targeted (optional) component and PnP specific command.  Note that 
@@ -65,6 +76,12 @@ STRING_HANDLE PnP_CreateReportedPropertyWithStatus(const char* componentName, co
 //
 void PnP_ParseCommandName(const char* deviceMethodName, unsigned const char** componentName, size_t* componentNameSize, const char** pnpCommandName);
 
+//
+// PnP_CreateCommandResponse formats the JSON response of a PnP command directly into a single, exactly sized allocation that the 
+// IoTHub SDK takes ownership of once the device method callback returns.  No intermediate STRING_HANDLE or scratch buffer is used.
+//
+bool PnP_CreateCommandResponse(unsigned char** response, size_t* responseSize, const char* format, ...);
+
 //
 // PnP_CreateTelemetryMessageHandle creates an IOTHUB_MESSAGE_HANDLE that contains tho contents of the telemetryData.
 // If the optional componentName parameter is specified, the created message will have this as a property.
@@ -83,6 +100,7 @@ bool PnP_ProcessTwinData(DEVICE_TWIN_UPDATE_STATE updateState, const unsigned ch
 //
 // PnP_CopyTwinPayloadToString takes the payload data, which arrives as a potentially non-NULL terminated string from the IoTHub SDK, and creates
 // a new copy of the data with a NULL terminator.  The JSON parser this sample uses, parson, only operates over NULL terminated strings.
+// The copy comes from PnP_Arena_ScopedMalloc and must be released with PnP_Arena_ScopedFree.
 //
 char* PnP_CopyPayloadToString(const unsigned char* payload, size_t size);
 
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "regmap.hpp"
+#include "env.h"
+
+/*
+    BMP280 register map, see regmap.hpp
+*/
+namespace bmp280_regs
+{
+
+using regmap::Burst;
+using regmap::Field;
+using regmap::Order;
+using regmap::Register;
+
+/* compensation words are little endian, T1 and P1 unsigned */
+using DIG_T1 = Register<BMP280_DIG_T1_LSB_REG, 2, false, Order::LsbFirst>;
+using DIG_T2 = Register<BMP280_DIG_T2_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_T3 = Register<BMP280_DIG_T3_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_P1 = Register<BMP280_DIG_P1_LSB_REG, 2, false, Order::LsbFirst>;
+using DIG_P2 = Register<BMP280_DIG_P2_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_P3 = Register<BMP280_DIG_P3_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_P4 = Register<BMP280_DIG_P4_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_P5 = Register<BMP280_DIG_P5_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_P6 = Register<BMP280_DIG_P6_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_P7 = Register<BMP280_DIG_P7_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_P8 = Register<BMP280_DIG_P8_LSB_REG, 2, true, Order::LsbFirst>;
+using DIG_P9 = Register<BMP280_DIG_P9_LSB_REG, 2, true, Order::LsbFirst>;
+
+using CHIP_ID = Register<BMP280_CHIPID_REG>;
+using RESET = Register<BMP280_RESET_REG>;
+using CTRL_MEAS = Register<BMP280_CTRLMEAS_REG>;
+using CONFIG = Register<BMP280_CONFIG_REG>;
+using PRESS = Register<BMP280_PRESSURE_MSB_REG, 3>;
+using TEMP = Register<BMP280_TEMPERATURE_MSB_REG, 3>;
+
+using OSRS_T = Field<CTRL_MEAS, 5, 3>;
+using OSRS_P = Field<CTRL_MEAS, 2, 3>;
+using MODE = Field<CTRL_MEAS, 0, 2>;
+using T_SB = Field<CONFIG, 5, 3>;
+using FILTER = Field<CONFIG, 2, 3>;
+
+/* 20 bit conversion results, msb, lsb and the top nibble of xlsb */
+using ADC_P = Field<PRESS, 4, 20>;
+using ADC_T = Field<TEMP, 4, 20>;
+
+using Calibration = Burst<DIG_T1, DIG_T2, DIG_T3, DIG_P1, DIG_P2, DIG_P3, DIG_P4, DIG_P5, DIG_P6, DIG_P7, DIG_P8, DIG_P9>;
+using Control = Burst<CTRL_MEAS, CONFIG>;
+using Sample = Burst<ADC_P, ADC_T>;
+using Temperature = Burst<ADC_T>;
+using Pressure = Burst<ADC_P>;
+
+static_assert(Calibration::length == 24, "calibration block is 0x88 - 0x9F");
+static_assert(Sample::length == 6, "pressure and temperature results are one block");
+
+} // namespace bmp280_regs
@@ -0,0 +1,287 @@
+#include "freertos/FreeRTOS.h"
+#include "i2c_device.h"
+#include "env.h"
+#include "bmp280_regs.hpp"
+
+using namespace bmp280_regs;
+
+#define dig_T1 bmp280->T1
+#define dig_T2 bmp280->T2
+#define dig_T3 bmp280->T3
+#define dig_P1 bmp280->P1
+#define dig_P2 bmp280->P2
+#define dig_P3 bmp280->P3
+#define dig_P4 bmp280->P4
+#define dig_P5 bmp280->P5
+#define dig_P6 bmp280->P6
+#define dig_P7 bmp280->P7
+#define dig_P8 bmp280->P8
+#define dig_P9 bmp280->P9
+
+struct bmp280 *bmp280;
+
+static int32_t bmp280_compensate_temperature(int32_t adc_T);
+static uint32_t bmp280_compensate_pressure(int32_t adc_P);
+
+/*
+    Both parts run at Fast-mode, like the MPU6886 on the same bus. Both also support Fast-mode Plus;
+    define these as 1000000 where the pull-ups and wiring of the bus allow 1 MHz.
+*/
+#ifndef BMP280_I2C_FREQ
+#define BMP280_I2C_FREQ 400000
+#endif
+#ifndef SHT30_I2C_FREQ
+#define SHT30_I2C_FREQ 400000
+#endif
+
+static I2CDevice_t Bmp280_I2cHandle;
+static Sample::buffer_type bmp280_sample_raw;
+static uint8_t bmp280_ctrlmeas_forced;
+
+void BMP280_I2C_Init(void)
+{
+    /* bmp280_init runs again when the sensor is plugged back in, the device is kept */
+    if (Bmp280_I2cHandle == NULL)
+    {
+        Bmp280_I2cHandle = i2c_malloc_device(I2C_NUM_1, 21, 22, BMP280_I2C_FREQ, 0x76);
+    }
+}
+
+double bmp280_get_temperature(void)
+{
+    Temperature::buffer_type raw;
+    regmap::read<Temperature>(Bmp280_I2cHandle, raw);
+
+    return (float)bmp280_compensate_temperature(Temperature::get<ADC_T>(raw)) * 0.01f;
+}
+
+double bmp280_get_pressure(void)
+{
+    Pressure::buffer_type raw;
+    regmap::read<Pressure>(Bmp280_I2cHandle, raw);
+
+    return (float)bmp280_compensate_pressure(Pressure::get<ADC_P>(raw)) * (1.0f / 256.0f);
+}
+
+uint8_t bmp280_init(void)
+{
+    uint8_t bmp280_id = 0;
+    Calibration::buffer_type calibration;
+    uint8_t ctrlmeas_reg, config_reg;
+
+    BMP280_I2C_Init();
+    regmap::read<CHIP_ID>(Bmp280_I2cHandle, &bmp280_id);
+    if (bmp280_id == 0x58)
+    {
+        if (bmp280 == NULL)
+        {
+            bmp280 = (struct bmp280 *)malloc(sizeof(struct bmp280));
+        }
+
+        bmp280->mode = BMP280_SLEEP_MODE;
+        bmp280->t_sb = BMP280_T_SB1;
+        bmp280->p_oversampling = BMP280_P_MODE_1;
+        bmp280->t_oversampling = BMP280_T_MODE_1;
+        bmp280->filter_coefficient = BMP280_FILTER_MODE_1;
+    }
+    else
+    {
+        printf("Read BMP280 id error!\r\n");
+        return 1;
+    }
+
+    /* all twelve compensation words in one burst */
+    regmap::read<Calibration>(Bmp280_I2cHandle, calibration);
+    dig_T1 = Calibration::get<DIG_T1>(calibration);
+    dig_T2 = Calibration::get<DIG_T2>(calibration);
+    dig_T3 = Calibration::get<DIG_T3>(calibration);
+    dig_P1 = Calibration::get<DIG_P1>(calibration);
+    dig_P2 = Calibration::get<DIG_P2>(calibration);
+    dig_P3 = Calibration::get<DIG_P3>(calibration);
+    dig_P4 = Calibration::get<DIG_P4>(calibration);
+    dig_P5 = Calibration::get<DIG_P5>(calibration);
+    dig_P6 = Calibration::get<DIG_P6>(calibration);
+    dig_P7 = Calibration::get<DIG_P7>(calibration);
+    dig_P8 = Calibration::get<DIG_P8>(calibration);
+    dig_P9 = Calibration::get<DIG_P9>(calibration);
+
+    bmp280_reset();
+
+    ctrlmeas_reg = OSRS_T::insert(OSRS_P::insert(MODE::insert(0, bmp280->mode), bmp280->p_oversampling), bmp280->t_oversampling);
+    config_reg = T_SB::insert(FILTER::insert(0, bmp280->filter_coefficient), bmp280->t_sb);
+
+    /* ctrl_meas and config are shadowed, both go out in one transaction and the setters skip the read */
+    i2c_shadow_enable(Bmp280_I2cHandle, Control::first, Control::length, I2C_SHADOW_ADDRESS_PAIRS);
+    i2c_shadow_defer(Bmp280_I2cHandle);
+    regmap::write<CTRL_MEAS>(Bmp280_I2cHandle, ctrlmeas_reg);
+    regmap::write<CONFIG>(Bmp280_I2cHandle, config_reg);
+    i2c_shadow_flush(Bmp280_I2cHandle);
+
+    vTaskDelay(100 / portTICK_PERIOD_MS);
+
+    return 0;
+}
+
+void bmp280_reset(void)
+{
+    regmap::write<RESET>(Bmp280_I2cHandle, BMP280_RESET_VALUE);
+    /* the registers are back at their defaults after the 2 ms start-up; a delay of n ticks can end
+       right after the next tick, so one more keeps a full 2 ms at any tick rate */
+    vTaskDelay(pdMS_TO_TICKS(2) + 1);
+    i2c_shadow_sync(Bmp280_I2cHandle);
+}
+
+void bmp280_set_standby_time(BMP280_T_SB t_standby)
+{
+    bmp280->t_sb = t_standby;
+    regmap::write<T_SB>(Bmp280_I2cHandle, t_standby);
+}
+
+void bmp280_set_work_mode(BMP280_WORK_MODE mode)
+{
+    bmp280->mode = mode;
+    regmap::write<MODE>(Bmp280_I2cHandle, mode);
+}
+
+void bmp280_set_temperature_oversampling_mode(BMP280_T_OVERSAMPLING t_osl)
+{
+    bmp280->t_oversampling = t_osl;
+    regmap::write<OSRS_T>(Bmp280_I2cHandle, t_osl);
+}
+
+void bmp280_set_pressure_oversampling_mode(BMP280_P_OVERSAMPLING p_osl)
+{
+    bmp280->p_oversampling = p_osl;
+    regmap::write<OSRS_P>(Bmp280_I2cHandle, p_osl);
+}
+
+void bmp280_set_filter_mode(BMP280_FILTER_COEFFICIENT f_coefficient)
+{
+    bmp280->filter_coefficient = f_coefficient;
+    regmap::write<FILTER>(Bmp280_I2cHandle, f_coefficient);
+}
+
+/*
+    Compensation in the datasheet's fixed point. The ESP32 FPU has no doubles, the double precision formulas
+    ran in software, and single precision loses the pressure in the cancellation of its large terms.
+*/
+
+/* temperature in 0.01 Celsius */
+static int32_t bmp280_compensate_temperature(int32_t adc_T)
+{
+    int32_t var1, var2;
+
+    var1 = ((((adc_T >> 3) - ((int32_t)dig_T1 << 1))) * ((int32_t)dig_T2)) >> 11;
+    var2 = (((((adc_T >> 4) - ((int32_t)dig_T1)) * ((adc_T >> 4) - ((int32_t)dig_T1))) >> 12) * ((int32_t)dig_T3)) >> 14;
+    bmp280->t_fine = var1 + var2;
+
+    return (bmp280->t_fine * 5 + 128) >> 8;
+}
+
+/* pressure in 1/256 Pa */
+static uint32_t bmp280_compensate_pressure(int32_t adc_P)
+{
+    int64_t var1, var2, pressure;
+
+    var1 = ((int64_t)bmp280->t_fine) - 128000;
+    var2 = var1 * var1 * (int64_t)dig_P6;
+    var2 = var2 + ((var1 * (int64_t)dig_P5) * 131072);
+    var2 = var2 + (((int64_t)dig_P4) * 34359738368LL);
+    var1 = ((var1 * var1 * (int64_t)dig_P3) >> 8) + ((var1 * (int64_t)dig_P2) * 4096);
+    var1 = ((((int64_t)1) << 47) + var1) * ((int64_t)dig_P1) >> 33;
+
+    if (var1 == 0)
+    {
+        return 0;
+    }
+
+    pressure = 1048576 - adc_P;
+    pressure = (((pressure << 31) - var2) * 3125) / var1;
+    var1 = (((int64_t)dig_P9) * (pressure >> 13) * (pressure >> 13)) >> 25;
+    var2 = (((int64_t)dig_P8) * pressure) >> 19;
+    pressure = ((pressure + var1 + var2) >> 8) + (((int64_t)dig_P7) << 4);
+
+    return (uint32_t)pressure;
+}
+
+void bmp280_get_temperature_and_pressure(double *temperature, double *pressure)
+{
+    *temperature = bmp280_get_temperature();
+    *pressure = bmp280_get_pressure();
+}
+
+esp_err_t bmp280_add_sample_ops(i2c_transaction_t *transaction)
+{
+    esp_err_t err;
+
+    err = regmap::add_read<Sample>(transaction, Bmp280_I2cHandle, bmp280_sample_raw);
+    if (err != ESP_OK || bmp280->mode != BMP280_FORCED_MODE)
+    {
+        return err;
+    }
+
+    bmp280_ctrlmeas_forced = OSRS_T::insert(OSRS_P::insert(MODE::insert(0, BMP280_FORCED_MODE), bmp280->p_oversampling), bmp280->t_oversampling);
+    return i2c_transaction_add_write_reg(transaction, Bmp280_I2cHandle, CTRL_MEAS::addr, &bmp280_ctrlmeas_forced, 1);
+}
+
+void bmp280_get_sample(double *temperature, double *pressure)
+{
+    int32_t adc_P = Sample::get<ADC_P>(bmp280_sample_raw);
+    int32_t adc_T = Sample::get<ADC_T>(bmp280_sample_raw);
+
+    /* temperature first, it sets t_fine used by the pressure compensation */
+    *temperature = (float)bmp280_compensate_temperature(adc_T) * 0.01f;
+    *pressure = (float)bmp280_compensate_pressure(adc_P) * (1.0f / 256.0f);
+}
+
+static I2CDevice_t SHT30_I2cHandle;
+static uint8_t SHT30_fetch_lsb = 0x00;
+static uint8_t SHT30_sample_raw[6];
+
+/* big endian words, temperature then humidity, each followed by its CRC */
+static void SHT30_convert(const uint8_t *raw, double *temp, double *humidity)
+{
+    *temp = (float)((raw[0] << 8) | raw[1]) * (175.0f / 65535.0f) - 45.0f;
+    *humidity = (float)((raw[3] << 8) | raw[4]) * (100.0f / 65535.0f);
+}
+
+uint8_t SHT30_Init(void)
+{
+    if (SHT30_I2cHandle == NULL)
+    {
+        SHT30_I2cHandle = i2c_malloc_device(I2C_NUM_1, 21, 22, SHT30_I2C_FREQ, 0x44);
+    }
+    /* periodic mode, 1 mps, high repeatability */
+    if (i2c_write_byte(SHT30_I2cHandle, 0x21, 0x26) != ESP_OK)
+    {
+        printf("SHT30 periodic mode command not acknowledged!\r\n");
+        return 1;
+    }
+    return 0;
+}
+
+void SHT30_get(double *temp, double *humidity)
+{
+    uint8_t buff[6];
+    i2c_write_byte(SHT30_I2cHandle, 0xe0, 0x00);
+    i2c_read(SHT30_I2cHandle, buff, 6);
+    SHT30_convert(buff, temp, humidity);
+}
+
+esp_err_t SHT30_add_sample_ops(i2c_transaction_t *transaction)
+{
+    esp_err_t err;
+
+    /* Fetch Data command 0xE000, then the 6 byte result of the last periodic measurement */
+    err = i2c_transaction_add_write_reg(transaction, SHT30_I2cHandle, 0xe0, &SHT30_fetch_lsb, 1);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return i2c_transaction_add_read(transaction, SHT30_I2cHandle, SHT30_sample_raw, 6);
+}
+
+void SHT30_get_sample(double *temp, double *humidity)
+{
+    SHT30_convert(SHT30_sample_raw, temp, humidity);
+}
\ No newline at end of file
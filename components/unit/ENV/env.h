@@ -1,4 +1,5 @@
 #pragma once
+#include "i2c_device.h"
 #ifdef __cplusplus
 extern "C"
 {
@@ -129,8 +130,17 @@ extern "C"
 	extern void bmp280_get_temperature_and_pressure(double *temperature, double *pressure);
 	extern void bmp280_forced_mode_get_temperature_and_pressure(double *temperature, double *pressure);
 
-	void SHT30_Init(void);
+	/*
+		Queue the reads of one sample on transaction; decode it with bmp280_get_sample after the transaction ran.
+		In forced mode the next conversion is triggered at the end of the sweep, so it is ready for the following one.
+	*/
+	extern esp_err_t bmp280_add_sample_ops(i2c_transaction_t *transaction);
+	extern void bmp280_get_sample(double *temperature, double *pressure);
+
+	uint8_t SHT30_Init(void);
 	void SHT30_get(double *temp, double *humidity);
+	esp_err_t SHT30_add_sample_ops(i2c_transaction_t *transaction);
+	void SHT30_get_sample(double *temp, double *humidity);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,123 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "i2c_async.h"
+
+#define TAG "I2C-ASYNC"
+
+#define I2C_ASYNC_STACK_SIZE (2048)
+
+static QueueHandle_t i2c_async_queue[I2C_NUM_MAX];
+
+static void i2c_async_complete(i2c_async_request_t *request, esp_err_t err) {
+    request->err = err;
+
+    if (request->callback != NULL) {
+        request->callback(request->transaction, err, request->arg);
+    } else {
+        xSemaphoreGive(request->done_sem);
+    }
+    // Only now may the request be submitted again: the callback is done with the transaction,
+    // and the completion is in the semaphore, where the next submit drains it if no wait took it
+    request->done = 1;
+}
+
+static void i2c_async_task(void *arg) {
+    QueueHandle_t queue = (QueueHandle_t)arg;
+    i2c_async_request_t *request;
+
+    for (;;) {
+        if (xQueueReceive(queue, &request, portMAX_DELAY) == pdTRUE) {
+            i2c_async_complete(request, i2c_transaction_execute(request->transaction));
+        }
+    }
+}
+
+esp_err_t i2c_async_start(i2c_port_t port, UBaseType_t priority, uint32_t queue_length) {
+    if (port >= I2C_NUM_MAX || queue_length == 0) {
+        return ESP_FAIL;
+    }
+
+    if (i2c_async_queue[port] != NULL) {
+        return ESP_OK;
+    }
+
+    QueueHandle_t queue = xQueueCreate(queue_length, sizeof(i2c_async_request_t *));
+    if (queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreate(i2c_async_task, "i2c_async", I2C_ASYNC_STACK_SIZE, queue, priority, NULL) != pdPASS) {
+        vQueueDelete(queue);
+        return ESP_ERR_NO_MEM;
+    }
+
+    i2c_async_queue[port] = queue;
+    ESP_LOGI(TAG, "Bus task started on port %d", port);
+    return ESP_OK;
+}
+
+esp_err_t i2c_async_submit(i2c_async_request_t *request, i2c_transaction_t *transaction, i2c_async_callback_t callback, void *arg) {
+    if (request == NULL || transaction == NULL || transaction->count == 0) {
+        return ESP_FAIL;
+    }
+
+    if (request->transaction != NULL && request->done == 0) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (callback == NULL && request->done_sem == NULL) {
+        request->done_sem = xSemaphoreCreateBinary();
+        if (request->done_sem == NULL) {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+    if (request->done_sem != NULL) {
+        // Drop the completion of an earlier run whose wait timed out or found it done
+        xSemaphoreTake(request->done_sem, 0);
+    }
+
+    request->transaction = transaction;
+    request->callback = callback;
+    request->arg = arg;
+    request->err = ESP_FAIL;
+    request->done = 0;
+
+    i2c_port_t port = i2c_device_port(transaction->ops[0].device);
+    if (i2c_async_queue[port] == NULL) {
+        i2c_async_complete(request, i2c_transaction_execute(transaction));
+        return ESP_OK;
+    }
+
+    if (xQueueSend(i2c_async_queue[port], &request, 0) != pdTRUE) {
+        request->transaction = NULL;
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+esp_err_t i2c_async_wait(i2c_async_request_t *request, TickType_t timeout) {
+    if (request == NULL || request->transaction == NULL || request->done_sem == NULL) {
+        return ESP_FAIL;
+    }
+
+    // err is written before the semaphore is given, and done after it: done with the semaphore
+    // empty means an earlier wait already took this completion
+    if (request->done != 0 && uxSemaphoreGetCount(request->done_sem) == 0) {
+        return request->err;
+    }
+    if (xSemaphoreTake(request->done_sem, timeout) != pdTRUE) {
+        return request->done != 0 ? request->err : ESP_ERR_TIMEOUT;
+    }
+    // The give can wake this task before the bus task sets done; submitting again
+    // before then would be refused, and the late write would mark the new run done
+    while (request->done == 0) {
+        vTaskDelay(1);
+    }
+    return request->err;
+}
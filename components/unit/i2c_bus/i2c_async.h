@@ -0,0 +1,58 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "i2c_device.h"
+
+/*
+    Asynchronous I2C service.
+
+    i2c_async_start creates a bus-owner task for a port. Requests submitted with i2c_async_submit are queued
+    and executed one after another by that task as i2c_transactions, so the caller can start a read,
+    do other work, and collect the result later.
+
+    Completion is reported either through a callback, which runs on the bus task and must not block
+    or submit its request again, or, with no callback, through a binary semaphore of the request that
+    i2c_async_wait takes; it leaves the notifications of the waiting task alone.
+    Synchronous i2c_* calls keep working next to the service, both go through the port mutex.
+*/
+
+typedef void (*i2c_async_callback_t)(i2c_transaction_t *transaction, esp_err_t err, void *arg);
+
+typedef struct {
+    i2c_transaction_t *transaction;
+    i2c_async_callback_t callback;
+    void *arg;
+    SemaphoreHandle_t done_sem;     // created by the first submit without callback
+    volatile esp_err_t err;
+    volatile uint8_t done;
+} i2c_async_request_t;
+
+/*
+    Create the bus-owner task of port
+    queue_length: number of requests that can be pending at once
+*/
+esp_err_t i2c_async_start(i2c_port_t port, UBaseType_t priority, uint32_t queue_length);
+
+/*
+    Queue transaction; request and transaction must stay valid until the request is done.
+    If no service runs on the transaction's port the transaction is executed before returning.
+    return ESP_ERR_INVALID_STATE if request is still pending, ESP_ERR_TIMEOUT if the queue is full
+*/
+esp_err_t i2c_async_submit(i2c_async_request_t *request, i2c_transaction_t *transaction, i2c_async_callback_t callback, void *arg);
+
+/*
+    Wait for a request submitted without callback
+    return the transaction result, or ESP_ERR_TIMEOUT if it is still pending
+*/
+esp_err_t i2c_async_wait(i2c_async_request_t *request, TickType_t timeout);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,6 +5,11 @@
 #include "esp_log.h"
 #include "esp_err.h"
 
+#include "esp_idf_version.h"
+#include "esp_timer.h"
+#include "esp32/rom/ets_sys.h"
+#include <string.h>
+
 #include "i2c_device.h"
 
 #define TAG "I2C-DEVICE"
@@ -27,27 +32,281 @@
 #define log_reg(buffer, buffer_len)
 #endif
 
-#define I2C_TIMEOUT_MS (100) // 1000ms
+// Sensor transfers take well under a millisecond, a longer wait only delays noticing a dead bus
+#define I2C_TIMEOUT_MS (20)
+// Extra attempts after a NACK or timeout before an op is reported failed
+#define I2C_RETRY_COUNT 1
+// SCL pulses clocking out a device that holds SDA low, one byte and its ACK
+#define I2C_BUS_CLEAR_PULSES 9
 #define MAX_DEVICE_NUMBER 24
 
-typedef struct _i2c_port_obj_t {
+#if ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(4, 4, 0)
+// Command links are built in a per-port buffer instead of the heap, and can be run more than once:
+// older drivers advance byte_num and data of the link's commands while running it, so a link works only once.
+// Largest link: start, address, register, repeated start, address, burst read, last byte read, stop
+#define I2C_CMD_LINK_STATIC
+#define I2C_CMD_LINK_SIZE I2C_LINK_RECOMMENDED_SIZE(8)
+static uint8_t i2c_cmd_link_buffer[I2C_NUM_MAX][I2C_CMD_LINK_SIZE];
+#endif
+
+/*
+    One bus object per port, shared by every device on it.
+    The driver is installed once; moving between devices with different clocks only retimes it.
+*/
+typedef struct _i2c_bus_t {
     i2c_port_t port;
     gpio_num_t scl;
     gpio_num_t sda;
-    uint32_t freq;
-} i2c_port_obj_t;
+    uint32_t freq;          // clock the driver currently runs at
+    uint8_t installed;
+    uint8_t device_count;
+    struct _i2c_device_t* devices[MAX_DEVICE_NUMBER];
+    i2c_bus_stats_t stats;
+} i2c_bus_t;
+
+typedef struct {
+    uint8_t first_reg;
+    uint8_t count;
+    uint8_t burst;          // i2c_shadow_burst_t
+    uint8_t deferred;
+    uint8_t dirty[32];      // one bit per register
+    uint8_t *values;
+    uint8_t *pairs;         // flush buffer for I2C_SHADOW_ADDRESS_PAIRS
+} i2c_shadow_t;
 
 typedef struct _i2c_device_t {
-    i2c_port_obj_t* i2c_port;
+    i2c_bus_t* bus;
     uint8_t addr;
+    uint32_t freq;          // highest clock the device supports
+    i2c_device_stats_t stats;
+    uint8_t failures;       // failed ops in a row
+    uint8_t quarantined;
+    uint32_t backoff_ms;    // wait before the next re-probe, doubled on every failed one
+    int64_t probe_at_us;    // esp_timer time of the next re-probe
+    i2c_shadow_t *shadow;
 } i2c_device_t;
 
 static SemaphoreHandle_t i2c_mutex[I2C_NUM_MAX];
-static i2c_port_obj_t *i2c_port_used[2] = { NULL, NULL };
+static i2c_bus_t i2c_bus[I2C_NUM_MAX];
+
+/*
+    ESP-IDF I2C master backend, the default
+*/
+// Start a command link for port; the caller holds the port mutex, which also guards the port's static link buffer
+static i2c_cmd_handle_t i2c_cmd_link_begin(i2c_port_t port) {
+#ifdef I2C_CMD_LINK_STATIC
+    return i2c_cmd_link_create_static(i2c_cmd_link_buffer[port], I2C_CMD_LINK_SIZE);
+#else
+    return i2c_cmd_link_create();
+#endif
+}
+
+static void i2c_cmd_link_end(i2c_cmd_handle_t cmd) {
+#ifdef I2C_CMD_LINK_STATIC
+    i2c_cmd_link_delete_static(cmd);
+#else
+    i2c_cmd_link_delete(cmd);
+#endif
+}
+
+// Append the read phase of an op: address in read mode, length bytes with NACK on the last
+static void i2c_cmd_add_read(i2c_cmd_handle_t cmd, uint8_t addr, uint8_t *data, uint16_t length) {
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_READ, 1);
+    if (length > 1) {
+        i2c_master_read(cmd, data, length - 1, I2C_MASTER_ACK);
+    }
+    if (length > 0) {
+        i2c_master_read_byte(cmd, &data[length-1], I2C_MASTER_NACK);
+    }
+    i2c_master_stop(cmd);
+}
+
+// Register read with a repeated start between the register address and the data, no STOP in between
+static void i2c_cmd_add_read_reg(i2c_cmd_handle_t cmd, uint8_t addr, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, 1);
+    i2c_master_write_byte(cmd, reg_addr, 1);
+    if (length == 0) {
+        i2c_master_stop(cmd);
+        return ;
+    }
+    i2c_cmd_add_read(cmd, addr, data, length);
+}
+
+static void i2c_cmd_add_write_reg(i2c_cmd_handle_t cmd, uint8_t addr, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, 1);
+    i2c_master_write_byte(cmd, reg_addr, 1);
+    if (length > 0) {
+        i2c_master_write(cmd, data, length, 1);
+    }
+    i2c_master_stop(cmd);
+}
+
+// Append the bus traffic of op to cmd
+static esp_err_t i2c_cmd_add_op(i2c_cmd_handle_t cmd, uint8_t addr, const i2c_op_t *op) {
+    switch (op->type) {
+        case I2C_OP_READ_REG:
+            i2c_cmd_add_read_reg(cmd, addr, op->reg_addr, op->data, op->length);
+            return ESP_OK;
+
+        case I2C_OP_WRITE_REG:
+            i2c_cmd_add_write_reg(cmd, addr, op->reg_addr, op->data, op->length);
+            return ESP_OK;
+
+        case I2C_OP_READ:
+            if (op->length == 0) {
+                return ESP_FAIL;
+            }
+            i2c_cmd_add_read(cmd, addr, op->data, op->length);
+            return ESP_OK;
+
+        case I2C_OP_PROBE:
+            i2c_master_start(cmd);
+            i2c_master_write_byte(cmd, (addr << 1) | I2C_MASTER_WRITE, 1);
+            i2c_master_stop(cmd);
+            return ESP_OK;
+
+        default:
+            return ESP_FAIL;
+    }
+}
+
+static esp_err_t i2c_esp_bus_config(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t installed) {
+    i2c_config_t conf = {
+        .mode = I2C_MODE_MASTER,
+        .sda_io_num = sda,
+        .sda_pullup_en = GPIO_PULLUP_ENABLE,
+        .scl_io_num = scl,
+        .scl_pullup_en = GPIO_PULLUP_ENABLE,
+        .master.clk_speed = freq,
+    };
+
+    // On an installed driver i2c_param_config only retimes the controller, no reinstall is needed
+    esp_err_t err = i2c_param_config(port, &conf);
+    if (err != ESP_OK || installed) {
+        return err;
+    }
+    return i2c_driver_install(port, I2C_MODE_MASTER, 0, 0, 0);
+}
+
+static void i2c_esp_bus_delete(i2c_port_t port) {
+    i2c_driver_delete(port);
+}
+
+// Clock SCL by hand until the device holding SDA lets go, send a STOP and reinstall the driver
+static esp_err_t i2c_esp_bus_recover(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t freq) {
+    i2c_driver_delete(port);
+
+    gpio_reset_pin(sda);
+    gpio_reset_pin(scl);
+    gpio_set_direction(sda, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_direction(scl, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level(sda, 1);
+    gpio_set_level(scl, 1);
+    ets_delay_us(5);
+
+    for (uint8_t i = 0; i < I2C_BUS_CLEAR_PULSES && gpio_get_level(sda) == 0; i++) {
+        gpio_set_level(scl, 0);
+        ets_delay_us(5);
+        gpio_set_level(scl, 1);
+        ets_delay_us(5);
+    }
+
+    gpio_set_level(scl, 0);
+    ets_delay_us(5);
+    gpio_set_level(sda, 0);
+    ets_delay_us(5);
+    gpio_set_level(scl, 1);
+    ets_delay_us(5);
+    gpio_set_level(sda, 1);
+    ets_delay_us(5);
+    int released = gpio_get_level(sda);
+
+    esp_err_t err = i2c_esp_bus_config(port, sda, scl, freq, 0);
+    if (err == ESP_OK && !released) {
+        err = ESP_ERR_INVALID_STATE;
+    }
+    return err;
+}
+
+static esp_err_t i2c_esp_execute(i2c_port_t port, uint8_t addr, const i2c_op_t *op, TickType_t timeout) {
+    if (op->prepared != NULL) {
+        return i2c_master_cmd_begin(port, (i2c_cmd_handle_t)op->prepared, timeout);
+    }
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_begin(port);
+    esp_err_t err = i2c_cmd_add_op(cmd, addr, op);
+    if (err == ESP_OK) {
+        err = i2c_master_cmd_begin(port, cmd, timeout);
+    }
+    i2c_cmd_link_end(cmd);
+    return err;
+}
+
+#ifdef I2C_CMD_LINK_STATIC
+// Links kept across executions come from the heap, the static buffer is reused by every call
+static esp_err_t i2c_esp_prepare(uint8_t addr, i2c_op_t *op) {
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    if (cmd == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (i2c_cmd_add_op(cmd, addr, op) != ESP_OK) {
+        i2c_cmd_link_delete(cmd);
+        return ESP_FAIL;
+    }
+    op->prepared = cmd;
+    return ESP_OK;
+}
+
+static void i2c_esp_release(i2c_op_t *op) {
+    i2c_cmd_link_delete((i2c_cmd_handle_t)op->prepared);
+}
+#endif
+
+static const i2c_backend_t i2c_esp_backend = {
+    .bus_config = i2c_esp_bus_config,
+    .bus_delete = i2c_esp_bus_delete,
+    .bus_recover = i2c_esp_bus_recover,
+    .execute = i2c_esp_execute,
+#ifdef I2C_CMD_LINK_STATIC
+    .prepare = i2c_esp_prepare,
+    .release = i2c_esp_release,
+#endif
+};
+
+static const i2c_backend_t *i2c_backend = &i2c_esp_backend;
+
+void i2c_set_backend(const i2c_backend_t *backend) {
+    i2c_backend = (backend != NULL) ? backend : &i2c_esp_backend;
+}
+
+// Upper bounds of the latency histogram buckets, the last bucket takes everything slower
+static const uint32_t i2c_latency_bucket_us[I2C_LATENCY_BUCKETS - 1] = { 100, 200, 500, 1000, 2000, 5000, 10000 };
+
+// Take the port mutex, accounting the time spent waiting for it
+static BaseType_t i2c_bus_lock(i2c_port_t port, TickType_t timeout) {
+    int64_t start = esp_timer_get_time();
+    BaseType_t taken = xSemaphoreTakeRecursive(i2c_mutex[port], timeout);
+    if (taken != pdTRUE) {
+        return taken;
+    }
+
+    uint32_t wait_us = (uint32_t)(esp_timer_get_time() - start);
+    i2c_bus[port].stats.lock_count++;
+    i2c_bus[port].stats.lock_wait_us += wait_us;
+    if (wait_us > i2c_bus[port].stats.max_lock_wait_us) {
+        i2c_bus[port].stats.max_lock_wait_us = wait_us;
+    }
+    return taken;
+}
+
 
 I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr) {
-    if (i2c_num > I2C_NUM_MAX) {
-        i2c_num = I2C_NUM_MAX;
+    if (i2c_num >= I2C_NUM_MAX) {
+        i2c_num = I2C_NUM_MAX - 1;
     }
 
     if (i2c_mutex[0] == NULL) {
@@ -58,25 +317,46 @@ I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl
         i2c_mutex[1] = xSemaphoreCreateRecursiveMutex(); 
     }
 
-    i2c_port_obj_t* new_device_port = (i2c_port_obj_t *)malloc(sizeof(i2c_port_obj_t));
-    if (new_device_port == NULL) {
+    xSemaphoreTakeRecursive(i2c_mutex[i2c_num], portMAX_DELAY);
+    i2c_bus_t* bus = &i2c_bus[i2c_num];
+    if (bus->device_count == 0) {
+        bus->port = i2c_num;
+        bus->sda = sda;
+        bus->scl = scl;
+        if (bus->stats.since_us == 0) {
+            bus->stats.since_us = esp_timer_get_time();
+        }
+    } else if ((bus->sda != sda) || (bus->scl != scl)) {
+        log_e("I2C port %d already uses scl: %d, sda: %d", i2c_num, bus->scl, bus->sda);
+        xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
         return NULL;
     }
 
-    new_device_port->sda = sda;
-    new_device_port->scl = scl;
-    new_device_port->freq = freq;
-    new_device_port->port = i2c_num;
+    if (bus->device_count >= MAX_DEVICE_NUMBER) {
+        xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
+        return NULL;
+    }
 
     i2c_device_t* device = (i2c_device_t *)malloc(sizeof(i2c_device_t));
     if (device == NULL) {
+        xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
         return NULL;
     }
 
-    device->i2c_port = new_device_port;
+    device->bus = bus;
     device->addr = device_addr;
-    log_i("New device malloc, scl: %d, sda: %d, freq: %d HZ",
-        device->i2c_port->scl, device->i2c_port->sda, device->i2c_port->freq);
+    device->freq = freq;
+    memset(&device->stats, 0, sizeof(device->stats));
+    device->failures = 0;
+    device->quarantined = 0;
+    device->backoff_ms = 0;
+    device->probe_at_us = 0;
+    device->shadow = NULL;
+    bus->devices[bus->device_count++] = device;
+    xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
+
+    log_i("New device malloc, addr: 0x%02x, scl: %d, sda: %d, max freq: %d HZ",
+        device->addr, bus->scl, bus->sda, device->freq);
 
     return (I2CDevice_t)device;
 }
@@ -85,8 +365,43 @@ void i2c_free_device(I2CDevice_t i2c_device) {
     if (i2c_device == NULL) {
         return ;
     }
-    free(((i2c_device_t *)i2c_device)->i2c_port);
-    free(i2c_device);
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_bus_t* bus = device->bus;
+
+    xSemaphoreTakeRecursive(i2c_mutex[bus->port], portMAX_DELAY);
+    for (uint8_t i = 0; i < bus->device_count; i++) {
+        if (bus->devices[i] == device) {
+            bus->devices[i] = bus->devices[--bus->device_count];
+            break;
+        }
+    }
+
+    if (bus->device_count == 0 && bus->installed) {
+        i2c_backend->bus_delete(bus->port);
+        bus->installed = 0;
+    }
+    xSemaphoreGiveRecursive(i2c_mutex[bus->port]);
+
+    i2c_shadow_disable(i2c_device);
+    free(device);
+}
+
+I2CDevice_t i2c_bus_find_device(i2c_port_t i2c_num, uint8_t device_addr) {
+    if (i2c_num >= I2C_NUM_MAX || i2c_mutex[i2c_num] == NULL) {
+        return NULL;
+    }
+
+    I2CDevice_t found = NULL;
+    xSemaphoreTakeRecursive(i2c_mutex[i2c_num], portMAX_DELAY);
+    for (uint8_t i = 0; i < i2c_bus[i2c_num].device_count; i++) {
+        if (i2c_bus[i2c_num].devices[i]->addr == device_addr) {
+            found = (I2CDevice_t)i2c_bus[i2c_num].devices[i];
+            break;
+        }
+    }
+    xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
+    return found;
 }
 
 BaseType_t i2c_take_port(i2c_port_t i2c_num, uint32_t timeout) {
@@ -94,7 +409,7 @@ BaseType_t i2c_take_port(i2c_port_t i2c_num, uint32_t timeout) {
         return pdFAIL;
     }
 
-    return xSemaphoreTakeRecursive(i2c_mutex[i2c_num], timeout);
+    return i2c_bus_lock(i2c_num, timeout);
 }
 
 BaseType_t i2c_free_port(i2c_port_t i2c_num) {
@@ -105,136 +420,237 @@ BaseType_t i2c_free_port(i2c_port_t i2c_num) {
     return xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
 }
 
-esp_err_t i2c_apply_bus(I2CDevice_t i2c_device) {
-    if (i2c_device == NULL) {
-        return ESP_FAIL;
+// Execute op on the bus of device and account it; the caller holds the port mutex and the bus is set up for device
+static esp_err_t i2c_op_transfer(i2c_device_t* device, const i2c_op_t *op) {
+    int64_t start = esp_timer_get_time();
+    esp_err_t err = i2c_backend->execute(device->bus->port, device->addr, op, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+    uint32_t latency_us = (uint32_t)(esp_timer_get_time() - start);
+
+    i2c_device_stats_t* stats = &device->stats;
+    stats->transactions++;
+    stats->total_latency_us += latency_us;
+    if (latency_us > stats->max_latency_us) {
+        stats->max_latency_us = latency_us;
     }
 
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
-    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
-    i2c_port_obj_t* used_port = i2c_port_used[device->i2c_port->port];
-    
-    if (used_port == device->i2c_port) {
-        return ESP_OK;
+    uint8_t bucket = 0;
+    while (bucket < I2C_LATENCY_BUCKETS - 1 && latency_us >= i2c_latency_bucket_us[bucket]) {
+        bucket++;
+    }
+    stats->latency_histogram[bucket]++;
+
+    if (err == ESP_OK) {
+        switch (op->type) {
+            case I2C_OP_READ_REG:
+            case I2C_OP_WRITE_REG:
+                stats->bytes += 1 + op->length;
+                break;
+            case I2C_OP_READ:
+                stats->bytes += op->length;
+                break;
+            default:
+                break;
+        }
+    } else if (err == ESP_FAIL) {
+        stats->nacks++;
+    } else if (err == ESP_ERR_TIMEOUT) {
+        stats->timeouts++;
+    } else {
+        stats->errors++;
     }
 
-    if ((used_port != NULL) && 
-        (device->i2c_port->sda == used_port->sda) && 
-        (device->i2c_port->scl == used_port->scl) && 
-        ((device->i2c_port->freq == used_port->freq))) {
-            i2c_port_used[device->i2c_port->port] = device->i2c_port;
-            return ESP_OK;    
+    device->bus->stats.busy_us += latency_us;
+    return err;
+}
+
+// Run the bus at freq; the caller holds the port mutex
+static esp_err_t i2c_bus_set_freq_locked(i2c_bus_t* bus, uint32_t freq) {
+    if (bus->installed && bus->freq == freq) {
+        return ESP_OK;
     }
 
-    if (used_port != NULL) {
-        i2c_driver_delete(device->i2c_port->port);
-        if ((device->i2c_port->sda != used_port->sda) || (device->i2c_port->scl != used_port->scl)) {
-            gpio_reset_pin(used_port->sda);
-            gpio_reset_pin(used_port->scl);
-        }
+    esp_err_t err = i2c_backend->bus_config(bus->port, bus->sda, bus->scl, freq, bus->installed);
+    if (err != ESP_OK) {
+        return err;
     }
 
-    i2c_config_t conf = {
-        .mode = I2C_MODE_MASTER,
-        .sda_io_num = device->i2c_port->sda,
-        .sda_pullup_en = GPIO_PULLUP_ENABLE,
-        .scl_io_num = device->i2c_port->scl,
-        .scl_pullup_en = GPIO_PULLUP_ENABLE,
-        .master.clk_speed = device->i2c_port->freq,
-    };
+    bus->installed = 1;
+    bus->freq = freq;
+    bus->stats.clock_changes++;
+    log_i("I2C config update, scl: %d, sda: %d, freq: %d HZ", bus->scl, bus->sda, bus->freq);
+    return ESP_OK;
+}
 
-    i2c_param_config(device->i2c_port->port, &conf);
-    i2c_driver_install(device->i2c_port->port, I2C_MODE_MASTER, 0, 0, 0);
+// Configure the bus for device; the caller holds the port mutex
+static esp_err_t i2c_apply_bus_locked(i2c_device_t* device) {
+    return i2c_bus_set_freq_locked(device->bus, device->freq);
+}
 
-    i2c_port_used[device->i2c_port->port] = device->i2c_port;
-    log_i("I2C config update, scl: %d, sda: %d, freq: %d HZ",
-            device->i2c_port->scl, device->i2c_port->sda, device->i2c_port->freq);
-    return ESP_OK;
+// Free a stuck bus; the driver comes back at the clock it ran at
+static void i2c_bus_recover_locked(i2c_bus_t* bus) {
+    if (i2c_backend->bus_recover == NULL) {
+        return ;
+    }
+
+    esp_err_t err = i2c_backend->bus_recover(bus->port, bus->sda, bus->scl, bus->freq);
+    bus->stats.bus_clears++;
+    // The driver is only known to be installed again if the recovery went through
+    bus->installed = (err == ESP_OK || err == ESP_ERR_INVALID_STATE);
+    ESP_LOGW(TAG, "Bus clear on port %d: %s", bus->port, esp_err_to_name(err));
 }
 
-void i2c_free_bus(I2CDevice_t i2c_device) {
-    if (i2c_device == NULL) {
+static void i2c_device_fail(i2c_device_t* device) {
+    int64_t now = esp_timer_get_time();
+    if (device->quarantined) {
+        device->backoff_ms = (device->backoff_ms >= I2C_QUARANTINE_MAX_MS / 2) ? I2C_QUARANTINE_MAX_MS : device->backoff_ms * 2;
+    } else if (++device->failures >= I2C_QUARANTINE_FAILURES) {
+        device->quarantined = 1;
+        device->backoff_ms = I2C_QUARANTINE_MIN_MS;
+        device->stats.quarantines++;
+        ESP_LOGW(TAG, "Device 0x%02x quarantined", device->addr);
+    } else {
         return ;
     }
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
-    xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]);
+    device->probe_at_us = now + (int64_t)device->backoff_ms * 1000;
 }
 
-esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
-    if (i2c_device == NULL || (length > 0 && data == NULL)) {
-        return ESP_FAIL;
+static void i2c_device_pass(i2c_device_t* device) {
+    if (device->quarantined) {
+        ESP_LOGI(TAG, "Device 0x%02x back on the bus", device->addr);
     }
+    device->failures = 0;
+    device->quarantined = 0;
+}
 
-    i2c_device_t* device = (i2c_device_t *)i2c_device;
+// Transfer op with bounded retries, clearing the bus after a timeout
+static esp_err_t i2c_op_attempt(i2c_device_t* device, const i2c_op_t *op, uint8_t retries) {
+    esp_err_t err = i2c_op_transfer(device, op);
+    while (err != ESP_OK && retries-- > 0) {
+        if (err == ESP_ERR_TIMEOUT) {
+            i2c_bus_recover_locked(device->bus);
+            if (i2c_apply_bus_locked(device) != ESP_OK) {
+                return err;
+            }
+        } else if (err != ESP_FAIL) {
+            return err;
+        }
+        device->stats.retries++;
+        err = i2c_op_transfer(device, op);
+    }
+    return err;
+}
 
-    i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
-    i2c_master_start(write_cmd);
-    i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_write_byte(write_cmd, reg_addr, 1);
-    i2c_master_stop(write_cmd);
+// Run op unless device is quarantined, re-probing it once its backoff ran out; the caller holds the port mutex
+static esp_err_t i2c_op_run(i2c_device_t* device, const i2c_op_t *op) {
+    if (device->quarantined && op->type != I2C_OP_PROBE) {
+        if (esp_timer_get_time() < device->probe_at_us) {
+            device->stats.rejected++;
+            return ESP_ERR_INVALID_STATE;
+        }
 
-    i2c_cmd_handle_t read_cmd = i2c_cmd_link_create();
-    i2c_master_start(read_cmd);
-    i2c_master_write_byte(read_cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
-    if (length > 1) {
-        i2c_master_read(read_cmd, data, length - 1, I2C_MASTER_ACK);
+        i2c_op_t probe = { .device = device, .type = I2C_OP_PROBE };
+        if (i2c_op_transfer(device, &probe) != ESP_OK) {
+            i2c_device_fail(device);
+            return ESP_ERR_INVALID_STATE;
+        }
+        i2c_device_pass(device);
     }
-    if (length > 0) {
-        i2c_master_read_byte(read_cmd, &data[length-1], I2C_MASTER_NACK);
+
+    // A probe answers whether the device is there, retrying it would only double the cost of an absent one
+    esp_err_t err = i2c_op_attempt(device, op, (op->type == I2C_OP_PROBE) ? 0 : I2C_RETRY_COUNT);
+    if (err == ESP_OK) {
+        i2c_device_pass(device);
+    } else if (err == ESP_FAIL || err == ESP_ERR_TIMEOUT) {
+        i2c_device_fail(device);
+    }
+    return err;
+}
+
+// Fill op for a single call on the caller's stack
+static void i2c_op_fill(i2c_op_t *op, I2CDevice_t i2c_device, i2c_op_type_t type, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    op->device = i2c_device;
+    op->type = type;
+    op->reg_addr = reg_addr;
+    op->data = data;
+    op->length = length;
+    op->err = ESP_FAIL;
+    op->prepared = NULL;
+}
+
+esp_err_t i2c_apply_bus(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL) {
+        return ESP_FAIL;
     }
-    i2c_master_stop(read_cmd);
 
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_bus_lock(device->bus->port, portMAX_DELAY);
+    return i2c_apply_bus_locked(device);
+}
 
-    i2c_apply_bus(i2c_device);
-    esp_err_t err = ESP_FAIL;
-    err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    if (err == ESP_OK && length > 0) {
-        err = i2c_master_cmd_begin(device->i2c_port->port, read_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+void i2c_free_bus(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL) {
+        return ;
     }
-    i2c_free_bus(i2c_device);
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+}
 
-    i2c_cmd_link_delete(write_cmd);
-    i2c_cmd_link_delete(read_cmd);
+#define I2C_SHADOW_DIRTY(shadow, i) ((shadow)->dirty[(i) >> 3] & (1 << ((i) & 7)))
 
-    if (err != ESP_OK) {
-        log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
+static uint8_t i2c_shadow_covers(const i2c_shadow_t *shadow, uint8_t reg_addr) {
+    return shadow != NULL && reg_addr >= shadow->first_reg && reg_addr - shadow->first_reg < shadow->count;
+}
+
+static void i2c_shadow_mark(i2c_shadow_t *shadow, uint8_t index, uint8_t dirty) {
+    if (dirty) {
+        shadow->dirty[index >> 3] |= 1 << (index & 7);
     } else {
-        log_i("I2C Read Success: 0x%02x, reg: 0x%02x, length: %d", device->addr, reg_addr, length);
-        log_reg(data, length);
+        shadow->dirty[index >> 3] &= ~(1 << (index & 7));
+    }
+}
+
+/*
+    Copy bytes transferred at reg_addr into the shadowed part of the range; the caller holds the port mutex.
+    written: the bytes went to the device, so they replace pending changes; read bytes leave those alone
+*/
+static void i2c_shadow_store(i2c_shadow_t *shadow, uint8_t reg_addr, const uint8_t *data, uint16_t length, uint8_t written) {
+    if (shadow == NULL) {
+        return ;
     }
 
-    return err;
+    for (uint16_t i = 0; i < length; i++) {
+        uint16_t reg = reg_addr + i;
+        if (reg > 0xFF || !i2c_shadow_covers(shadow, (uint8_t)reg)) {
+            continue;
+        }
+
+        uint8_t index = reg - shadow->first_reg;
+        if (written) {
+            shadow->values[index] = data[i];
+            i2c_shadow_mark(shadow, index, 0);
+        } else if (!I2C_SHADOW_DIRTY(shadow, index)) {
+            shadow->values[index] = data[i];
+        }
+    }
 }
 
-esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
     if (i2c_device == NULL || (length > 0 && data == NULL)) {
         return ESP_FAIL;
     }
 
     i2c_device_t* device = (i2c_device_t *)i2c_device;
 
-    i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
-    i2c_master_start(write_cmd);
-    i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_write_byte(write_cmd, reg_addr, 1);
-    i2c_master_start(write_cmd);
-    i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
-    if (length > 1) {
-        i2c_master_read(write_cmd, data, length - 1, I2C_MASTER_ACK);
-    }
-    if (length > 0) {
-        i2c_master_read_byte(write_cmd, &data[length-1], I2C_MASTER_NACK);
-    }
-    i2c_master_stop(write_cmd);
-
+    i2c_op_t op;
+    i2c_op_fill(&op, i2c_device, I2C_OP_READ_REG, reg_addr, data, length);
 
     i2c_apply_bus(i2c_device);
-    esp_err_t err = ESP_FAIL;
-    err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+    esp_err_t err = i2c_op_run(device, &op);
+    if (err == ESP_OK) {
+        i2c_shadow_store(device->shadow, reg_addr, data, length, 0);
+    }
     i2c_free_bus(i2c_device);
 
-    i2c_cmd_link_delete(write_cmd);
-
     if (err != ESP_OK) {
         log_e("I2C Read Error: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
     } else {
@@ -245,6 +661,10 @@ esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint8_t reg_addr, uint8
     return err;
 }
 
+esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    return i2c_read_bytes(i2c_device, reg_addr, data, length);
+}
+
 esp_err_t i2c_read_byte(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t* data) {
     return i2c_read_bytes(i2c_device, reg_addr, data, 1);
 }
@@ -290,23 +710,16 @@ esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *dat
 
     i2c_device_t* device = (i2c_device_t *)i2c_device;
 
-    i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
-    i2c_master_start(write_cmd);
-    i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_write_byte(write_cmd, reg_addr, 1);
-    if (length > 0) {
-        i2c_master_write(write_cmd, data, length, 1);
-    }
-    i2c_master_stop(write_cmd);
-
-    esp_err_t err = ESP_FAIL;
+    i2c_op_t op;
+    i2c_op_fill(&op, i2c_device, I2C_OP_WRITE_REG, reg_addr, data, length);
 
     i2c_apply_bus(i2c_device);
-    err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+    esp_err_t err = i2c_op_run(device, &op);
+    if (err == ESP_OK) {
+        i2c_shadow_store(device->shadow, reg_addr, data, length, 1);
+    }
     i2c_free_bus(i2c_device);
 
-    i2c_cmd_link_delete(write_cmd);
-
     if (err != ESP_OK) {
         log_e("I2C Write Error, addr: 0x%02x, reg: 0x%02x, length: %d, Code: 0x%x", device->addr, reg_addr, length, err);
     } else {
@@ -317,30 +730,72 @@ esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *dat
     return err;
 }
 
-esp_err_t i2c_write_byte(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data) {
-    return i2c_write_bytes(i2c_device, reg_addr, &data, 1);
+esp_err_t i2c_write_bit(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data, uint8_t bit_pos) {
+    return i2c_write_bits(i2c_device, reg_addr, data, bit_pos, 1);
 }
 
-esp_err_t i2c_write_bit(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data, uint8_t bit_pos) {
-    uint8_t value = 0x00;
-    esp_err_t err = ESP_FAIL;
-    err = i2c_read_byte(i2c_device, reg_addr, &value);
-    if (err != ESP_OK) {
-        return err;
+/*
+    Change the bits of mask in a shadowed register; the caller holds the port mutex.
+    return ESP_ERR_NOT_FOUND if the register is not shadowed
+*/
+static esp_err_t i2c_shadow_update_locked(i2c_device_t* device, uint8_t reg_addr, uint8_t bits, uint8_t mask) {
+    i2c_shadow_t *shadow = device->shadow;
+    if (!i2c_shadow_covers(shadow, reg_addr)) {
+        return ESP_ERR_NOT_FOUND;
     }
 
-    value &= ~(1 << bit_pos);
-    value |= (data & 0x01) << bit_pos;
-    return i2c_write_byte(i2c_device, reg_addr, value);
+    uint8_t index = reg_addr - shadow->first_reg;
+    uint8_t value = (shadow->values[index] & ~mask) | (bits & mask);
+    if (value == shadow->values[index] && !I2C_SHADOW_DIRTY(shadow, index)) {
+        return ESP_OK;
+    }
+
+    shadow->values[index] = value;
+    if (shadow->deferred) {
+        i2c_shadow_mark(shadow, index, 1);
+        return ESP_OK;
+    }
+
+    i2c_op_t op;
+    i2c_op_fill(&op, device, I2C_OP_WRITE_REG, reg_addr, &shadow->values[index], 1);
+    esp_err_t err = i2c_apply_bus_locked(device);
+    if (err == ESP_OK) {
+        err = i2c_op_run(device, &op);
+    }
+    // Left dirty, the next flush retries it
+    i2c_shadow_mark(shadow, index, err != ESP_OK);
+    return err;
+}
+
+esp_err_t i2c_write_byte(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data) {
+    if (i2c_device != NULL) {
+        i2c_device_t* device = (i2c_device_t *)i2c_device;
+        i2c_bus_lock(device->bus->port, portMAX_DELAY);
+        esp_err_t err = i2c_shadow_update_locked(device, reg_addr, data, 0xFF);
+        xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+        if (err != ESP_ERR_NOT_FOUND) {
+            return err;
+        }
+    }
+
+    return i2c_write_bytes(i2c_device, reg_addr, &data, 1);
 }
 
 esp_err_t i2c_write_bits(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data, uint8_t bit_pos, uint8_t bit_length) {
-    if ((bit_pos + bit_length) > 8) {
+    if ((bit_pos + bit_length) > 8 || i2c_device == NULL) {
         return ESP_FAIL;
     }
 
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    uint8_t mask = ((1 << bit_length) - 1) << bit_pos;
+    i2c_bus_lock(device->bus->port, portMAX_DELAY);
+    esp_err_t err = i2c_shadow_update_locked(device, reg_addr, data << bit_pos, mask);
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+    if (err != ESP_ERR_NOT_FOUND) {
+        return err;
+    }
+
     uint8_t value = 0x00;
-    esp_err_t err = ESP_FAIL;
     err = i2c_read_byte(i2c_device, reg_addr, &value);
     if (err != ESP_OK) {
         return err;
@@ -358,17 +813,9 @@ esp_err_t i2c_device_change_freq(I2CDevice_t i2c_device, uint32_t freq) {
         return ESP_FAIL;
     }
     i2c_device_t* device = (i2c_device_t *)i2c_device;
-    xSemaphoreTakeRecursive(i2c_mutex[device->i2c_port->port], portMAX_DELAY);
-    if (device->i2c_port->freq == freq) {
-        xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]);
-        return ESP_OK;
-    }
-
-    device->i2c_port->freq = freq;
-    if (i2c_port_used[device->i2c_port->port] == device->i2c_port) {
-        i2c_port_used[device->i2c_port->port] = NULL;
-    }
-    xSemaphoreGiveRecursive(i2c_mutex[device->i2c_port->port]);
+    xSemaphoreTakeRecursive(i2c_mutex[device->bus->port], portMAX_DELAY);
+    device->freq = freq;
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
     return ESP_OK;
 }
 
@@ -379,23 +826,171 @@ esp_err_t i2c_device_valid(I2CDevice_t i2c_device) {
 
     i2c_device_t* device = (i2c_device_t *)i2c_device;
 
-    i2c_cmd_handle_t write_cmd = i2c_cmd_link_create();
-    i2c_master_start(write_cmd);
-    i2c_master_write_byte(write_cmd, (device->addr << 1) | I2C_MASTER_WRITE, 1);
-    i2c_master_stop(write_cmd);
-
-    esp_err_t err = ESP_FAIL;
+    i2c_op_t op;
+    i2c_op_fill(&op, i2c_device, I2C_OP_PROBE, 0, NULL, 0);
 
     i2c_apply_bus(i2c_device);
-    err = i2c_master_cmd_begin(device->i2c_port->port, write_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
+    esp_err_t err = i2c_op_run(device, &op);
     i2c_free_bus(i2c_device);
 
-    i2c_cmd_link_delete(write_cmd);
     return err;
 }
 
 
 
+esp_err_t i2c_shadow_enable(I2CDevice_t i2c_device, uint8_t first_reg, uint8_t count, i2c_shadow_burst_t burst) {
+    if (i2c_device == NULL || count == 0 || first_reg + count > 0x100) {
+        return ESP_FAIL;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    uint16_t size = (burst == I2C_SHADOW_ADDRESS_PAIRS) ? 3 * count : count;
+    i2c_shadow_t *shadow = (i2c_shadow_t *)malloc(sizeof(i2c_shadow_t) + size);
+    if (shadow == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    memset(shadow, 0, sizeof(i2c_shadow_t));
+    shadow->first_reg = first_reg;
+    shadow->count = count;
+    shadow->burst = burst;
+    shadow->values = (uint8_t *)(shadow + 1);
+    shadow->pairs = (burst == I2C_SHADOW_ADDRESS_PAIRS) ? shadow->values + count : NULL;
+
+    esp_err_t err = i2c_read_bytes(i2c_device, first_reg, shadow->values, count);
+    if (err != ESP_OK) {
+        free(shadow);
+        return err;
+    }
+
+    i2c_shadow_disable(i2c_device);
+    xSemaphoreTakeRecursive(i2c_mutex[device->bus->port], portMAX_DELAY);
+    device->shadow = shadow;
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+    return ESP_OK;
+}
+
+void i2c_shadow_disable(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL) {
+        return ;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    xSemaphoreTakeRecursive(i2c_mutex[device->bus->port], portMAX_DELAY);
+    i2c_shadow_t *shadow = device->shadow;
+    device->shadow = NULL;
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+    free(shadow);
+}
+
+esp_err_t i2c_shadow_sync(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL || ((i2c_device_t *)i2c_device)->shadow == NULL) {
+        return ESP_FAIL;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_bus_lock(device->bus->port, portMAX_DELAY);
+    i2c_shadow_t *shadow = device->shadow;
+    memset(shadow->dirty, 0, sizeof(shadow->dirty));
+    shadow->deferred = 0;
+    esp_err_t err = i2c_read_bytes(i2c_device, shadow->first_reg, shadow->values, shadow->count);
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+    return err;
+}
+
+esp_err_t i2c_shadow_get(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data) {
+    if (i2c_device == NULL || data == NULL) {
+        return ESP_FAIL;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+    xSemaphoreTakeRecursive(i2c_mutex[device->bus->port], portMAX_DELAY);
+    if (i2c_shadow_covers(device->shadow, reg_addr)) {
+        *data = device->shadow->values[reg_addr - device->shadow->first_reg];
+        err = ESP_OK;
+    }
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+    return err;
+}
+
+esp_err_t i2c_shadow_defer(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL || ((i2c_device_t *)i2c_device)->shadow == NULL) {
+        return ESP_FAIL;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    xSemaphoreTakeRecursive(i2c_mutex[device->bus->port], portMAX_DELAY);
+    device->shadow->deferred = 1;
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+    return ESP_OK;
+}
+
+esp_err_t i2c_shadow_flush(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL || ((i2c_device_t *)i2c_device)->shadow == NULL) {
+        return ESP_FAIL;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    i2c_bus_lock(device->bus->port, portMAX_DELAY);
+    i2c_shadow_t *shadow = device->shadow;
+    shadow->deferred = 0;
+
+    int16_t first = -1, last = -1;
+    for (uint16_t i = 0; i < shadow->count; i++) {
+        if (I2C_SHADOW_DIRTY(shadow, i)) {
+            first = (first < 0) ? i : first;
+            last = i;
+        }
+    }
+
+    esp_err_t err = ESP_OK;
+    if (first >= 0) {
+        i2c_op_t op;
+        if (shadow->burst == I2C_SHADOW_ADDRESS_PAIRS) {
+            // First register address goes in the op, then value, address, value, ... for the other dirty ones
+            uint16_t length = 0;
+            for (int16_t i = first; i <= last; i++) {
+                if (!I2C_SHADOW_DIRTY(shadow, i)) {
+                    continue;
+                }
+                if (length > 0) {
+                    shadow->pairs[length++] = shadow->first_reg + i;
+                }
+                shadow->pairs[length++] = shadow->values[i];
+            }
+            i2c_op_fill(&op, device, I2C_OP_WRITE_REG, shadow->first_reg + first, shadow->pairs, length);
+        } else {
+            // Clean registers in between hold what the device has, rewriting them keeps the burst in one piece
+            i2c_op_fill(&op, device, I2C_OP_WRITE_REG, shadow->first_reg + first, &shadow->values[first], last - first + 1);
+        }
+
+        err = i2c_apply_bus_locked(device);
+        if (err == ESP_OK) {
+            err = i2c_op_run(device, &op);
+        }
+        if (err == ESP_OK) {
+            memset(shadow->dirty, 0, sizeof(shadow->dirty));
+        } else {
+            log_e("I2C Shadow Flush Error, addr: 0x%02x, reg: 0x%02x, Code: 0x%x", device->addr, op.reg_addr, err);
+        }
+    }
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+    return err;
+}
+
+uint8_t i2c_device_quarantined(I2CDevice_t i2c_device) {
+    if (i2c_device == NULL) {
+        return 0;
+    }
+
+    return ((i2c_device_t *)i2c_device)->quarantined;
+}
+
+i2c_port_t i2c_device_port(I2CDevice_t i2c_device) {
+    return ((i2c_device_t *)i2c_device)->bus->port;
+}
+
 esp_err_t i2c_read(I2CDevice_t i2c_device, uint8_t *data, uint16_t length){
     if (i2c_device == NULL || (length > 0 && data == NULL)) {
         return ESP_FAIL;
@@ -404,26 +999,17 @@ esp_err_t i2c_read(I2CDevice_t i2c_device, uint8_t *data, uint16_t length){
     i2c_device_t* device = (i2c_device_t *)i2c_device;
 
 
-    i2c_cmd_handle_t read_cmd = i2c_cmd_link_create();
-    i2c_master_start(read_cmd);
-    i2c_master_write_byte(read_cmd, (device->addr << 1) | I2C_MASTER_READ, 1);
-    if (length > 1) {
-        i2c_master_read(read_cmd, data, length - 1, I2C_MASTER_ACK);
-    }
-    if (length > 0) {
-        i2c_master_read_byte(read_cmd, &data[length-1], I2C_MASTER_NACK);
+    if (length == 0) {
+        return ESP_FAIL;
     }
-    i2c_master_stop(read_cmd);
+
+    i2c_op_t op;
+    i2c_op_fill(&op, i2c_device, I2C_OP_READ, 0, data, length);
 
     i2c_apply_bus(i2c_device);
-    esp_err_t err = ESP_FAIL;
-    if (length > 0) {
-        err = i2c_master_cmd_begin(device->i2c_port->port, read_cmd, pdMS_TO_TICKS(I2C_TIMEOUT_MS));
-    }
+    esp_err_t err = i2c_op_run(device, &op);
     i2c_free_bus(i2c_device);
 
-    i2c_cmd_link_delete(read_cmd);
-
     if (err != ESP_OK) {
         log_e("I2C Read Error: 0x%02x, length: %d, Code: 0x%x", device->addr, length, err);
     } else {
@@ -432,4 +1018,181 @@ esp_err_t i2c_read(I2CDevice_t i2c_device, uint8_t *data, uint16_t length){
     }
 
     return err;
-}
\ No newline at end of file
+}
+
+void i2c_transaction_init(i2c_transaction_t *transaction, i2c_op_t *ops, uint8_t max_ops) {
+    transaction->ops = ops;
+    transaction->count = 0;
+    transaction->max_ops = (max_ops > I2C_TRANSACTION_MAX_OPS) ? I2C_TRANSACTION_MAX_OPS : max_ops;
+}
+
+static esp_err_t i2c_transaction_add(i2c_transaction_t *transaction, I2CDevice_t i2c_device, i2c_op_type_t type, 
+                                     uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    if (transaction == NULL || i2c_device == NULL || (length > 0 && data == NULL)) {
+        return ESP_FAIL;
+    }
+
+    if (transaction->count >= transaction->max_ops) {
+        return ESP_ERR_NO_MEM;
+    }
+
+    i2c_op_fill(&transaction->ops[transaction->count++], i2c_device, type, reg_addr, data, length);
+    return ESP_OK;
+}
+
+esp_err_t i2c_transaction_add_read_reg(i2c_transaction_t *transaction, I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    return i2c_transaction_add(transaction, i2c_device, I2C_OP_READ_REG, reg_addr, data, length);
+}
+
+esp_err_t i2c_transaction_add_write_reg(i2c_transaction_t *transaction, I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length) {
+    return i2c_transaction_add(transaction, i2c_device, I2C_OP_WRITE_REG, reg_addr, data, length);
+}
+
+esp_err_t i2c_transaction_add_read(i2c_transaction_t *transaction, I2CDevice_t i2c_device, uint8_t *data, uint16_t length) {
+    return i2c_transaction_add(transaction, i2c_device, I2C_OP_READ, 0, data, length);
+}
+
+esp_err_t i2c_transaction_prepare(i2c_transaction_t *transaction) {
+    if (transaction == NULL) {
+        return ESP_FAIL;
+    }
+
+    if (i2c_backend->prepare == NULL) {
+        return ESP_OK;
+    }
+
+    for (uint8_t i = 0; i < transaction->count; i++) {
+        i2c_op_t* op = &transaction->ops[i];
+        if (op->prepared != NULL) {
+            continue;
+        }
+
+        esp_err_t err = i2c_backend->prepare(((i2c_device_t *)op->device)->addr, op);
+        if (err != ESP_OK) {
+            i2c_transaction_release(transaction);
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+void i2c_transaction_release(i2c_transaction_t *transaction) {
+    if (transaction == NULL) {
+        return ;
+    }
+
+    for (uint8_t i = 0; i < transaction->count; i++) {
+        if (transaction->ops[i].prepared != NULL) {
+            if (i2c_backend->release != NULL) {
+                i2c_backend->release(&transaction->ops[i]);
+            }
+            transaction->ops[i].prepared = NULL;
+        }
+    }
+}
+
+esp_err_t i2c_transaction_execute(i2c_transaction_t *transaction) {
+    if (transaction == NULL || transaction->count == 0) {
+        return ESP_FAIL;
+    }
+
+    i2c_bus_t* bus = ((i2c_device_t *)transaction->ops[0].device)->bus;
+    esp_err_t result = ESP_OK;
+
+    // Ops run grouped by clock, starting with the one the bus is at, so each clock is set at most once.
+    // Ops of one device share a clock and keep their order.
+    uint32_t pending = (transaction->count >= 32) ? 0xffffffff : ((1UL << transaction->count) - 1);
+
+    i2c_bus_lock(bus->port, portMAX_DELAY);
+    uint32_t freq = bus->installed ? bus->freq : ((i2c_device_t *)transaction->ops[0].device)->freq;
+    while (pending != 0) {
+        uint32_t next_freq = 0;
+
+        for (uint8_t i = 0; i < transaction->count; i++) {
+            if ((pending & (1UL << i)) == 0) {
+                continue;
+            }
+
+            i2c_op_t* op = &transaction->ops[i];
+            i2c_device_t* device = (i2c_device_t *)op->device;
+            if (device->bus != bus) {
+                op->err = ESP_ERR_INVALID_ARG;
+            } else if (device->freq != freq) {
+                if (next_freq == 0) {
+                    next_freq = device->freq;
+                }
+                continue;
+            } else {
+                op->err = i2c_apply_bus_locked(device);
+                if (op->err == ESP_OK) {
+                    op->err = i2c_op_run(device, op);
+                }
+            }
+            pending &= ~(1UL << i);
+
+            if (op->err != ESP_OK) {
+                log_e("I2C Transaction Error: 0x%02x, op: %d, reg: 0x%02x, length: %d, Code: 0x%x", 
+                      device->addr, i, op->reg_addr, op->length, op->err);
+                if (result == ESP_OK) {
+                    result = op->err;
+                }
+            }
+        }
+
+        freq = next_freq;
+    }
+    xSemaphoreGiveRecursive(i2c_mutex[bus->port]);
+
+    return result;
+}
+
+esp_err_t i2c_device_get_stats(I2CDevice_t i2c_device, i2c_device_stats_t *stats) {
+    if (i2c_device == NULL || stats == NULL) {
+        return ESP_FAIL;
+    }
+
+    i2c_device_t* device = (i2c_device_t *)i2c_device;
+    xSemaphoreTakeRecursive(i2c_mutex[device->bus->port], portMAX_DELAY);
+    *stats = device->stats;
+    xSemaphoreGiveRecursive(i2c_mutex[device->bus->port]);
+    return ESP_OK;
+}
+
+esp_err_t i2c_bus_get_stats(i2c_port_t i2c_num, i2c_bus_stats_t *stats) {
+    if (i2c_num >= I2C_NUM_MAX || i2c_mutex[i2c_num] == NULL || stats == NULL) {
+        return ESP_FAIL;
+    }
+
+    xSemaphoreTakeRecursive(i2c_mutex[i2c_num], portMAX_DELAY);
+    *stats = i2c_bus[i2c_num].stats;
+    xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
+    return ESP_OK;
+}
+
+uint8_t i2c_bus_utilization(i2c_port_t i2c_num) {
+    i2c_bus_stats_t stats;
+    if (i2c_bus_get_stats(i2c_num, &stats) != ESP_OK) {
+        return 0;
+    }
+
+    int64_t window_us = esp_timer_get_time() - stats.since_us;
+    if (window_us <= 0) {
+        return 0;
+    }
+    return (uint8_t)((stats.busy_us * 100) / (uint64_t)window_us);
+}
+
+void i2c_bus_reset_stats(i2c_port_t i2c_num) {
+    if (i2c_num >= I2C_NUM_MAX || i2c_mutex[i2c_num] == NULL) {
+        return ;
+    }
+
+    xSemaphoreTakeRecursive(i2c_mutex[i2c_num], portMAX_DELAY);
+    i2c_bus_t* bus = &i2c_bus[i2c_num];
+    memset(&bus->stats, 0, sizeof(bus->stats));
+    bus->stats.since_us = esp_timer_get_time();
+    for (uint8_t i = 0; i < bus->device_count; i++) {
+        memset(&bus->devices[i]->stats, 0, sizeof(bus->devices[i]->stats));
+    }
+    xSemaphoreGiveRecursive(i2c_mutex[i2c_num]);
+}
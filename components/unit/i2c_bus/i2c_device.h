@@ -17,18 +17,111 @@ extern "C" {
 // Know write or read failed
 // #define I2C_DEVICE_DEBUG_ERROR
 
+// Run the drivers against the simulated sensors of i2c_sim.h instead of the I2C hardware
+// #define I2C_DEVICE_SIMULATION
+
 typedef void * I2CDevice_t;
 
+#define I2C_LATENCY_BUCKETS 8
+
+/*
+    Counters of one device, updated on every bus transaction
+    latency_histogram buckets: <100us, <200us, <500us, <1ms, <2ms, <5ms, <10ms, >=10ms
+*/
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;             // payload bytes of successful transactions, register address included
+    uint32_t nacks;             // ESP_FAIL from the driver, the device did not acknowledge
+    uint32_t timeouts;          // ESP_ERR_TIMEOUT, the bus was held or the transfer did not finish in time
+    uint32_t errors;            // any other failure
+    uint32_t retries;           // transfers repeated after a failure
+    uint32_t quarantines;       // times the device was taken off the bus
+    uint32_t rejected;          // ops failed without touching the bus while quarantined
+    uint32_t max_latency_us;
+    uint64_t total_latency_us;
+    uint32_t latency_histogram[I2C_LATENCY_BUCKETS];
+} i2c_device_stats_t;
+
+typedef struct {
+    int64_t since_us;           // start of the measurement window, esp_timer time
+    uint64_t busy_us;           // time spent inside i2c_master_cmd_begin
+    uint32_t lock_count;
+    uint64_t lock_wait_us;
+    uint32_t max_lock_wait_us;
+    uint32_t clock_changes;
+    uint32_t bus_clears;        // stuck bus recoveries
+} i2c_bus_stats_t;
+
+// Ops in one transaction are tracked in a 32 bit mask
+#define I2C_TRANSACTION_MAX_OPS 32
+
+typedef enum {
+    I2C_OP_READ_REG = 0,    // write reg_addr, then read length bytes
+    I2C_OP_WRITE_REG,       // write reg_addr followed by length bytes
+    I2C_OP_READ,            // read length bytes without addressing a register
+    I2C_OP_PROBE,           // address the device and check for an ACK
+} i2c_op_type_t;
+
+typedef struct {
+    I2CDevice_t device;
+    i2c_op_type_t type;
+    uint8_t reg_addr;
+    uint16_t length;
+    uint8_t *data;
+    esp_err_t err;          // result of this op, filled in by i2c_transaction_execute
+    void *prepared;         // backend form kept by i2c_transaction_prepare, NULL otherwise
+} i2c_op_t;
+
+/*
+    A list of reads and writes, possibly across devices, that share one port.
+    i2c_transaction_execute runs the whole list under a single acquisition of the bus,
+    so a sensor sweep costs one lock round trip instead of one per register access.
+*/
+typedef struct {
+    i2c_op_t *ops;
+    uint8_t count;
+    uint8_t max_ops;
+} i2c_transaction_t;
+
+/*
+    Bus backend. The default drives the ESP-IDF I2C master; i2c_set_backend swaps it,
+    e.g. for the simulated sensors of i2c_sim.h. Every hook is called with the port mutex held.
+*/
+typedef struct {
+    // Install the bus (installed == 0) or change its clock
+    esp_err_t (*bus_config)(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t installed);
+    void (*bus_delete)(i2c_port_t port);
+    esp_err_t (*execute)(i2c_port_t port, uint8_t addr, const i2c_op_t *op, TickType_t timeout);
+    // Optional, free a bus held by a device stuck mid-byte and leave the driver installed at freq
+    esp_err_t (*bus_recover)(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t freq);
+    // Optional, build a reusable form of op in op->prepared
+    esp_err_t (*prepare)(uint8_t addr, i2c_op_t *op);
+    void (*release)(i2c_op_t *op);
+} i2c_backend_t;
+
+// Select the backend before the first transfer; NULL restores the ESP-IDF driver
+void i2c_set_backend(const i2c_backend_t *backend);
+
+/*
+    Register a device on the bus of i2c_num
+    freq: highest clock the device supports; the bus is run at that clock while talking to it
+    return NULL if the port is already used with other pins or the registry is full
+*/
 I2CDevice_t i2c_malloc_device(i2c_port_t i2c_num, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t device_addr);
 
 void i2c_free_device(I2CDevice_t i2c_device);
 
+I2CDevice_t i2c_bus_find_device(i2c_port_t i2c_num, uint8_t device_addr);
+
 esp_err_t i2c_apply_bus(I2CDevice_t i2c_device);
 
 void i2c_free_bus(I2CDevice_t i2c_device);
 
 esp_err_t i2c_device_change_freq(I2CDevice_t i2c_device, uint32_t freq);
 
+/*
+    Write reg_addr then read length bytes after a repeated start, as one bus transaction
+*/
 esp_err_t i2c_read_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length);
 
 esp_err_t i2c_read_byte(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t* data);
@@ -46,6 +139,7 @@ esp_err_t i2c_read_bits(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data,
 
 esp_err_t i2c_write_bytes(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length);
 
+// Same as i2c_read_bytes, which now always uses a repeated start; kept for existing callers
 esp_err_t i2c_read_bytes_no_stop(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length);
 
 esp_err_t i2c_write_byte(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data);
@@ -63,14 +157,102 @@ esp_err_t i2c_write_bit(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data,
 */
 esp_err_t i2c_write_bits(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t data, uint8_t bit_pos, uint8_t bit_length);
 
+/*
+    Address the device and check for an ACK.
+    Probing bypasses the quarantine and lifts it when the device answers.
+*/
 esp_err_t i2c_device_valid(I2CDevice_t i2c_device);
 
+/*
+    A device failing I2C_QUARANTINE_FAILURES transfers in a row is quarantined: its ops return
+    ESP_ERR_INVALID_STATE at once instead of waiting out the bus timeout. After a backoff, starting at
+    I2C_QUARANTINE_MIN_MS and doubling up to I2C_QUARANTINE_MAX_MS, the next op probes the device first
+    and goes through if it answers.
+*/
+#define I2C_QUARANTINE_FAILURES 3
+#define I2C_QUARANTINE_MIN_MS 1000
+#define I2C_QUARANTINE_MAX_MS 60000
+
+uint8_t i2c_device_quarantined(I2CDevice_t i2c_device);
+
+typedef enum {
+    I2C_SHADOW_AUTO_INCREMENT = 0,  // a burst write fills consecutive registers, like the MPU6886
+    I2C_SHADOW_ADDRESS_PAIRS,       // every data byte of a burst follows its own register address, like the BMP280
+} i2c_shadow_burst_t;
+
+/*
+    Keep a shadow copy of the registers [first_reg, first_reg + count), read once from the device here.
+    i2c_write_byte and i2c_write_bit(s) on a shadowed register then change the copy instead of reading
+    the device, and write the byte straight through: a read-modify-write costs one write, or nothing
+    if the value does not change. i2c_read_bytes and i2c_write_bytes keep the copy in step.
+    Only shadow configuration registers the device does not change on its own.
+*/
+esp_err_t i2c_shadow_enable(I2CDevice_t i2c_device, uint8_t first_reg, uint8_t count, i2c_shadow_burst_t burst);
+
+void i2c_shadow_disable(I2CDevice_t i2c_device);
+
+// Reload the copy from the device, e.g. after a soft reset; pending changes are dropped
+esp_err_t i2c_shadow_sync(I2CDevice_t i2c_device);
+
+// Value of a shadowed register without a bus access
+esp_err_t i2c_shadow_get(I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data);
+
+/*
+    Start a batch: until i2c_shadow_flush, i2c_write_byte and i2c_write_bit(s) on shadowed registers
+    only mark them dirty.
+    The flush writes everything from the first to the last dirty register as one burst.
+*/
+esp_err_t i2c_shadow_defer(I2CDevice_t i2c_device);
+
+esp_err_t i2c_shadow_flush(I2CDevice_t i2c_device);
+
+i2c_port_t i2c_device_port(I2CDevice_t i2c_device);
+
 BaseType_t i2c_take_port(i2c_port_t i2c_num, uint32_t timeout);
 
 BaseType_t i2c_free_port(i2c_port_t i2c_num);
 
 esp_err_t i2c_read(I2CDevice_t i2c_device, uint8_t *data, uint16_t length);
 
+void i2c_transaction_init(i2c_transaction_t *transaction, i2c_op_t *ops, uint8_t max_ops);
+
+esp_err_t i2c_transaction_add_read_reg(i2c_transaction_t *transaction, I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length);
+
+esp_err_t i2c_transaction_add_write_reg(i2c_transaction_t *transaction, I2CDevice_t i2c_device, uint8_t reg_addr, uint8_t *data, uint16_t length);
+
+esp_err_t i2c_transaction_add_read(i2c_transaction_t *transaction, I2CDevice_t i2c_device, uint8_t *data, uint16_t length);
+
+/*
+    Run every op while holding the bus once.
+    Ops are grouped by device clock so the bus is retimed at most once per distinct clock;
+    within a device, and within a clock, ops run in the order they were added.
+    Each op's status is stored in its err field; an op failing does not stop the ones after it.
+    return ESP_OK if every op succeeded, else the first error
+*/
+esp_err_t i2c_transaction_execute(i2c_transaction_t *transaction);
+
+/*
+    Build the command link of every op once and keep it, so a transaction that is run repeatedly,
+    like the periodic sensor sweep, does not rebuild its links on each execute.
+    Op buffers must stay valid until i2c_transaction_release.
+    A no-op before ESP-IDF 4.4, whose driver consumes a link while running it; links are then built on each execute.
+*/
+esp_err_t i2c_transaction_prepare(i2c_transaction_t *transaction);
+
+void i2c_transaction_release(i2c_transaction_t *transaction);
+
+esp_err_t i2c_device_get_stats(I2CDevice_t i2c_device, i2c_device_stats_t *stats);
+
+esp_err_t i2c_bus_get_stats(i2c_port_t i2c_num, i2c_bus_stats_t *stats);
+
+/*
+    Share of the measurement window the bus spent transferring, in percent
+*/
+uint8_t i2c_bus_utilization(i2c_port_t i2c_num);
+
+// Restart the measurement window and clear the counters of the bus and its devices
+void i2c_bus_reset_stats(i2c_port_t i2c_num);
+
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
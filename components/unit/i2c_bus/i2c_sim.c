@@ -0,0 +1,617 @@
+#include <string.h>
+#include <math.h>
+
+#include "i2c_sim.h"
+
+#ifdef ESP_PLATFORM
+#include "esp_timer.h"
+#include "esp32/rom/ets_sys.h"
+#endif
+
+/* MPU6886 registers the model implements */
+#define SIM_MPU_SMPLRT_DIV      0x19
+#define SIM_MPU_GYRO_CONFIG     0x1B
+#define SIM_MPU_ACCEL_CONFIG    0x1C
+#define SIM_MPU_FIFO_EN         0x23
+#define SIM_MPU_INT_STATUS      0x3A
+#define SIM_MPU_ACCEL_XOUT_H    0x3B
+#define SIM_MPU_USER_CTRL       0x6A
+#define SIM_MPU_PWR_MGMT_1      0x6B
+#define SIM_MPU_FIFO_COUNTH     0x72
+#define SIM_MPU_FIFO_COUNTL     0x73
+#define SIM_MPU_FIFO_R_W        0x74
+#define SIM_MPU_WHOAMI          0x75
+
+#define SIM_MPU_FIFO_SIZE       1024
+#define SIM_MPU_SAMPLE_SIZE     14
+
+/* BMP280 registers the model implements */
+#define SIM_BMP_CALIB           0x88
+#define SIM_BMP_CHIPID          0xD0
+#define SIM_BMP_RESET           0xE0
+#define SIM_BMP_CTRLMEAS        0xF4
+#define SIM_BMP_CONFIG          0xF5
+#define SIM_BMP_PRESS_MSB       0xF7
+#define SIM_BMP_TEMP_MSB        0xFA
+
+typedef struct {
+    uint8_t present;
+    uint8_t pointer;            // register the next read without address starts at
+    uint8_t regs[256];
+} sim_reg_device_t;
+
+static i2c_sim_config_t sim_config;
+static i2c_sim_stats_t sim_stats;
+static uint32_t sim_freq[I2C_NUM_MAX];
+static uint64_t sim_bus_clock_us;
+static int64_t sim_clock_offset_us;
+static uint32_t sim_random_state = 1;
+
+static sim_reg_device_t sim_mpu;
+static uint8_t sim_mpu_fifo[SIM_MPU_FIFO_SIZE];
+static uint16_t sim_mpu_fifo_head;
+static uint16_t sim_mpu_fifo_count;
+static int64_t sim_mpu_last_sample_us;
+
+static sim_reg_device_t sim_bmp;
+
+/* Calibration of the datasheet example part */
+static const uint16_t sim_bmp_T1 = 27504;
+static const int16_t sim_bmp_T2 = 26435, sim_bmp_T3 = -1000;
+static const uint16_t sim_bmp_P1 = 36477;
+static const int16_t sim_bmp_P2 = -10685, sim_bmp_P3 = 3024, sim_bmp_P4 = 2855, sim_bmp_P5 = 140,
+                     sim_bmp_P6 = -7, sim_bmp_P7 = 15500, sim_bmp_P8 = -14600, sim_bmp_P9 = 6000;
+
+static struct {
+    uint8_t present;
+    uint8_t periodic;
+    uint8_t ready;
+    uint8_t data[6];
+} sim_sht;
+
+static int64_t sim_now_us(void) {
+#ifdef ESP_PLATFORM
+    return esp_timer_get_time() + sim_clock_offset_us;
+#else
+    return (int64_t)sim_bus_clock_us + sim_clock_offset_us;
+#endif
+}
+
+static uint32_t sim_random(void) {
+    uint32_t x = sim_random_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    sim_random_state = x;
+    return x;
+}
+
+static float sim_noise(float amplitude) {
+    return amplitude * ((float)(sim_random() % 20001) / 10000.0f - 1.0f);
+}
+
+static uint8_t sim_chance(uint16_t per_mille) {
+    return (per_mille > 0) && ((sim_random() % 1000) < per_mille);
+}
+
+static void sim_put_be16(uint8_t *out, float value) {
+    long v = lroundf(value);
+    v = (v > 32767) ? 32767 : ((v < -32768) ? -32768 : v);
+    out[0] = (uint8_t)((uint16_t)v >> 8);
+    out[1] = (uint8_t)((uint16_t)v & 0xff);
+}
+
+/*
+    MPU6886
+*/
+
+static void sim_mpu_reset(void) {
+    memset(sim_mpu.regs, 0, sizeof(sim_mpu.regs));
+    sim_mpu.regs[SIM_MPU_WHOAMI] = 0x19;
+    sim_mpu.regs[SIM_MPU_PWR_MGMT_1] = 0x40;
+    sim_mpu.pointer = 0;
+    sim_mpu_fifo_head = 0;
+    sim_mpu_fifo_count = 0;
+    sim_mpu_last_sample_us = sim_now_us();
+}
+
+// One sample in register order: accel xyz, temperature, gyro xyz
+static void sim_mpu_sample(uint8_t *out) {
+    float accel_lsb = 32768.0f / (float)(2 << ((sim_mpu.regs[SIM_MPU_ACCEL_CONFIG] >> 3) & 0x03));
+    float gyro_lsb = 32768.0f / (float)(250 << ((sim_mpu.regs[SIM_MPU_GYRO_CONFIG] >> 3) & 0x03));
+
+    for (int i = 0; i < 3; i++) {
+        sim_put_be16(&out[i * 2], (sim_config.accel_g[i] + sim_noise(sim_config.accel_noise_g)) * accel_lsb);
+        sim_put_be16(&out[8 + i * 2], (sim_config.gyro_dps[i] + sim_noise(sim_config.gyro_noise_dps)) * gyro_lsb);
+    }
+    sim_put_be16(&out[6], (sim_config.temperature_c - 25.0f + sim_noise(sim_config.temperature_noise_c)) * 326.8f);
+}
+
+static void sim_mpu_fifo_push(const uint8_t *data, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        if (sim_mpu_fifo_count == SIM_MPU_FIFO_SIZE) {
+            // Oldest data is overwritten
+            sim_mpu_fifo_head = (sim_mpu_fifo_head + 1) % SIM_MPU_FIFO_SIZE;
+            sim_mpu_fifo_count--;
+            sim_mpu.regs[SIM_MPU_INT_STATUS] |= 0x10;
+        }
+        sim_mpu_fifo[(sim_mpu_fifo_head + sim_mpu_fifo_count) % SIM_MPU_FIFO_SIZE] = data[i];
+        sim_mpu_fifo_count++;
+    }
+}
+
+static uint8_t sim_mpu_fifo_pop(void) {
+    if (sim_mpu_fifo_count == 0) {
+        return 0xff;
+    }
+    uint8_t value = sim_mpu_fifo[sim_mpu_fifo_head];
+    sim_mpu_fifo_head = (sim_mpu_fifo_head + 1) % SIM_MPU_FIFO_SIZE;
+    sim_mpu_fifo_count--;
+    return value;
+}
+
+// Produce the samples that came due since the last access at 1 kHz / (1 + SMPLRT_DIV)
+static void sim_mpu_update(void) {
+    int64_t now = sim_now_us();
+    if (sim_mpu.regs[SIM_MPU_PWR_MGMT_1] & 0x40) {
+        sim_mpu_last_sample_us = now;
+        return ;
+    }
+
+    int64_t period_us = 1000 * (1 + (int64_t)sim_mpu.regs[SIM_MPU_SMPLRT_DIV]);
+    int64_t due = (now - sim_mpu_last_sample_us) / period_us;
+    if (due <= 0) {
+        return ;
+    }
+    sim_mpu_last_sample_us += due * period_us;
+
+    // Anything older would have been overwritten in the FIFO anyway
+    if (due > SIM_MPU_FIFO_SIZE / SIM_MPU_SAMPLE_SIZE + 1) {
+        due = SIM_MPU_FIFO_SIZE / SIM_MPU_SAMPLE_SIZE + 1;
+        sim_mpu.regs[SIM_MPU_INT_STATUS] |= 0x10;
+    }
+
+    uint8_t fifo_enabled = sim_mpu.regs[SIM_MPU_USER_CTRL] & 0x40;
+    uint8_t accel_fifo = sim_mpu.regs[SIM_MPU_FIFO_EN] & 0x08;
+    uint8_t gyro_fifo = sim_mpu.regs[SIM_MPU_FIFO_EN] & 0x10;
+    uint8_t sample[SIM_MPU_SAMPLE_SIZE];
+
+    for (int64_t n = 0; n < due; n++) {
+        sim_mpu_sample(sample);
+        if (fifo_enabled && (accel_fifo || gyro_fifo)) {
+            if (accel_fifo) {
+                sim_mpu_fifo_push(&sample[0], 6);
+            }
+            sim_mpu_fifo_push(&sample[6], 2);
+            if (gyro_fifo) {
+                sim_mpu_fifo_push(&sample[8], 6);
+            }
+        }
+    }
+
+    memcpy(&sim_mpu.regs[SIM_MPU_ACCEL_XOUT_H], sample, SIM_MPU_SAMPLE_SIZE);
+    sim_mpu.regs[SIM_MPU_INT_STATUS] |= 0x01;
+}
+
+static esp_err_t sim_mpu_read(uint8_t *data, uint16_t length) {
+    sim_mpu_update();
+    for (uint16_t i = 0; i < length; i++) {
+        uint8_t reg = sim_mpu.pointer;
+        if (reg == SIM_MPU_FIFO_R_W) {
+            data[i] = sim_mpu_fifo_pop();
+            continue;
+        }
+
+        if (reg == SIM_MPU_FIFO_COUNTH) {
+            data[i] = (uint8_t)(sim_mpu_fifo_count >> 8);
+        } else if (reg == SIM_MPU_FIFO_COUNTL) {
+            data[i] = (uint8_t)(sim_mpu_fifo_count & 0xff);
+        } else {
+            data[i] = sim_mpu.regs[reg];
+        }
+
+        if (reg == SIM_MPU_INT_STATUS) {
+            sim_mpu.regs[SIM_MPU_INT_STATUS] = 0;
+        }
+        sim_mpu.pointer++;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sim_mpu_write(const uint8_t *data, uint16_t length) {
+    sim_mpu_update();
+    for (uint16_t i = 0; i < length; i++) {
+        uint8_t reg = sim_mpu.pointer;
+        if (reg == SIM_MPU_FIFO_R_W) {
+            continue;
+        }
+
+        if (reg == SIM_MPU_PWR_MGMT_1 && (data[i] & 0x80)) {
+            sim_mpu_reset();
+            return ESP_OK;
+        }
+
+        if (reg == SIM_MPU_USER_CTRL && (data[i] & 0x04)) {
+            sim_mpu_fifo_head = 0;
+            sim_mpu_fifo_count = 0;
+        }
+
+        if (reg != SIM_MPU_WHOAMI && reg != SIM_MPU_INT_STATUS) {
+            sim_mpu.regs[reg] = (reg == SIM_MPU_USER_CTRL) ? (data[i] & ~0x04) : data[i];
+        }
+        sim_mpu.pointer++;
+    }
+    return ESP_OK;
+}
+
+/*
+    BMP280
+*/
+
+static double sim_bmp_temperature(int32_t adc_T, double *t_fine) {
+    double var1 = (adc_T / 16384.0 - sim_bmp_T1 / 1024.0) * sim_bmp_T2;
+    double var2 = (adc_T / 131072.0 - sim_bmp_T1 / 8192.0) * (adc_T / 131072.0 - sim_bmp_T1 / 8192.0) * sim_bmp_T3;
+    *t_fine = var1 + var2;
+    return (var1 + var2) / 5120.0;
+}
+
+static double sim_bmp_pressure(int32_t adc_P, double t_fine) {
+    double var1 = t_fine / 2.0 - 64000.0;
+    double var2 = var1 * var1 * sim_bmp_P6 / 32768.0;
+    var2 = var2 + var1 * sim_bmp_P5 * 2.0;
+    var2 = var2 / 4.0 + sim_bmp_P4 * 65536.0;
+    var1 = (sim_bmp_P3 * var1 * var1 / 524288.0 + sim_bmp_P2 * var1) / 524288.0;
+    var1 = (1.0 + var1 / 32768.0) * sim_bmp_P1;
+    if (var1 == 0.0) {
+        return 0.0;
+    }
+    double p = 1048576.0 - adc_P;
+    p = (p - var2 / 4096.0) * 6250.0 / var1;
+    var1 = sim_bmp_P9 * p * p / 2147483648.0;
+    var2 = p * sim_bmp_P8 / 32768.0;
+    return p + (var1 + var2 + sim_bmp_P7) / 16.0;
+}
+
+static void sim_bmp_put_adc(uint8_t reg, int32_t adc) {
+    sim_bmp.regs[reg] = (uint8_t)(adc >> 12);
+    sim_bmp.regs[reg + 1] = (uint8_t)((adc >> 4) & 0xff);
+    sim_bmp.regs[reg + 2] = (uint8_t)((adc & 0x0f) << 4);
+}
+
+// Fill the ADC registers with the raw words the compensation maps back to the configured values
+static void sim_bmp_convert(void) {
+    double temperature = sim_config.temperature_c + sim_noise(sim_config.temperature_noise_c);
+    double pressure = sim_config.pressure_pa + sim_noise(sim_config.pressure_noise_pa);
+    double t_fine;
+    int32_t lo, hi;
+
+    // Temperature rises with adc_T
+    for (lo = 0, hi = 0xfffff; lo < hi; ) {
+        int32_t mid = (lo + hi) / 2;
+        if (sim_bmp_temperature(mid, &t_fine) < temperature) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    sim_bmp_put_adc(SIM_BMP_TEMP_MSB, lo);
+    sim_bmp_temperature(lo, &t_fine);
+
+    // Pressure falls with adc_P
+    for (lo = 0, hi = 0xfffff; lo < hi; ) {
+        int32_t mid = (lo + hi) / 2;
+        if (sim_bmp_pressure(mid, t_fine) > pressure) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    sim_bmp_put_adc(SIM_BMP_PRESS_MSB, lo);
+}
+
+static void sim_bmp_put_le16(uint8_t reg, uint16_t value) {
+    sim_bmp.regs[reg] = (uint8_t)(value & 0xff);
+    sim_bmp.regs[reg + 1] = (uint8_t)(value >> 8);
+}
+
+static void sim_bmp_reset(void) {
+    memset(sim_bmp.regs, 0, sizeof(sim_bmp.regs));
+    sim_bmp.pointer = 0;
+    sim_bmp.regs[SIM_BMP_CHIPID] = 0x58;
+    sim_bmp_put_le16(SIM_BMP_CALIB + 0, sim_bmp_T1);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 2, (uint16_t)sim_bmp_T2);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 4, (uint16_t)sim_bmp_T3);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 6, sim_bmp_P1);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 8, (uint16_t)sim_bmp_P2);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 10, (uint16_t)sim_bmp_P3);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 12, (uint16_t)sim_bmp_P4);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 14, (uint16_t)sim_bmp_P5);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 16, (uint16_t)sim_bmp_P6);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 18, (uint16_t)sim_bmp_P7);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 20, (uint16_t)sim_bmp_P8);
+    sim_bmp_put_le16(SIM_BMP_CALIB + 22, (uint16_t)sim_bmp_P9);
+    /* Power-on value of the data registers */
+    sim_bmp_put_adc(SIM_BMP_PRESS_MSB, 0x80000);
+    sim_bmp_put_adc(SIM_BMP_TEMP_MSB, 0x80000);
+}
+
+static esp_err_t sim_bmp_read(uint8_t *data, uint16_t length) {
+    // Normal mode converts continuously
+    if ((sim_bmp.regs[SIM_BMP_CTRLMEAS] & 0x03) == 0x03) {
+        sim_bmp_convert();
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        data[i] = sim_bmp.regs[sim_bmp.pointer++];
+    }
+    return ESP_OK;
+}
+
+// Writes do not auto-increment: every data byte after the first follows its own register address
+static esp_err_t sim_bmp_write(const uint8_t *data, uint16_t length) {
+    for (uint16_t i = 0; i < length; i++) {
+        if (i > 0) {
+            sim_bmp.pointer = data[i++];
+            if (i == length) {
+                break;
+            }
+        }
+        uint8_t reg = sim_bmp.pointer;
+        if (reg == SIM_BMP_RESET) {
+            if (data[i] == 0xb6) {
+                sim_bmp_reset();
+                return ESP_OK;
+            }
+        } else if (reg == SIM_BMP_CTRLMEAS) {
+            sim_bmp.regs[reg] = data[i];
+            // Forced mode converts once and goes back to sleep
+            if ((data[i] & 0x03) == 0x01 || (data[i] & 0x03) == 0x02) {
+                sim_bmp_convert();
+                sim_bmp.regs[reg] &= ~0x03;
+            }
+        } else if (reg == SIM_BMP_CONFIG) {
+            sim_bmp.regs[reg] = data[i];
+        }
+    }
+    return ESP_OK;
+}
+
+/*
+    SHT30
+*/
+
+static uint8_t sim_sht_crc(const uint8_t *data) {
+    uint8_t crc = 0xff;
+    for (int i = 0; i < 2; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static uint16_t sim_sht_raw(float value) {
+    return (value < 0.0f) ? 0 : ((value > 65535.0f) ? 65535 : (uint16_t)lroundf(value));
+}
+
+static void sim_sht_measure(void) {
+    uint16_t t = sim_sht_raw((sim_config.temperature_c + sim_noise(sim_config.temperature_noise_c) + 45.0f) * 65535.0f / 175.0f);
+    uint16_t h = sim_sht_raw((sim_config.humidity_rh + sim_noise(sim_config.humidity_noise_rh)) * 65535.0f / 100.0f);
+
+    sim_sht.data[0] = (uint8_t)(t >> 8);
+    sim_sht.data[1] = (uint8_t)(t & 0xff);
+    sim_sht.data[2] = sim_sht_crc(&sim_sht.data[0]);
+    sim_sht.data[3] = (uint8_t)(h >> 8);
+    sim_sht.data[4] = (uint8_t)(h & 0xff);
+    sim_sht.data[5] = sim_sht_crc(&sim_sht.data[3]);
+    sim_sht.ready = 1;
+}
+
+// The 16 bit command arrives as the register byte followed by one data byte
+static esp_err_t sim_sht_command(uint8_t msb, const uint8_t *data, uint16_t length) {
+    if (length != 1) {
+        return ESP_FAIL;
+    }
+
+    uint16_t command = ((uint16_t)msb << 8) | data[0];
+    if (command == 0x30a2 || command == 0x3093) {
+        // Soft reset, break
+        sim_sht.periodic = 0;
+        sim_sht.ready = 0;
+    } else if (command == 0xe000) {
+        if (!sim_sht.periodic) {
+            return ESP_FAIL;
+        }
+        sim_sht_measure();
+    } else if (msb == 0x24 || msb == 0x2c) {
+        // Single shot
+        sim_sht_measure();
+    } else if (msb >= 0x20 && msb <= 0x27) {
+        sim_sht.periodic = 1;
+        sim_sht.ready = 0;
+    } else {
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+static esp_err_t sim_sht_read(uint8_t *data, uint16_t length) {
+    if (!sim_sht.ready) {
+        return ESP_FAIL;
+    }
+    memcpy(data, sim_sht.data, (length < sizeof(sim_sht.data)) ? length : sizeof(sim_sht.data));
+    sim_sht.ready = 0;
+    return ESP_OK;
+}
+
+/*
+    Backend
+*/
+
+static esp_err_t sim_reg_device_execute(sim_reg_device_t *device, const i2c_op_t *op,
+                                        esp_err_t (*read)(uint8_t *, uint16_t), esp_err_t (*write)(const uint8_t *, uint16_t)) {
+    switch (op->type) {
+        case I2C_OP_READ_REG:
+            device->pointer = op->reg_addr;
+            return read(op->data, op->length);
+        case I2C_OP_WRITE_REG:
+            device->pointer = op->reg_addr;
+            return write(op->data, op->length);
+        case I2C_OP_READ:
+            return read(op->data, op->length);
+        case I2C_OP_PROBE:
+            return ESP_OK;
+        default:
+            return ESP_FAIL;
+    }
+}
+
+static esp_err_t sim_sht_execute(const i2c_op_t *op) {
+    switch (op->type) {
+        case I2C_OP_WRITE_REG:
+            return sim_sht_command(op->reg_addr, op->data, op->length);
+        case I2C_OP_READ:
+            return sim_sht_read(op->data, op->length);
+        case I2C_OP_PROBE:
+            return ESP_OK;
+        default:
+            return ESP_FAIL;
+    }
+}
+
+static uint32_t sim_wire_bytes(const i2c_op_t *op) {
+    switch (op->type) {
+        case I2C_OP_READ_REG:
+            return (op->length > 0) ? 3 + op->length : 2;
+        case I2C_OP_WRITE_REG:
+            return 2 + op->length;
+        case I2C_OP_READ:
+            return 1 + op->length;
+        default:
+            return 1;
+    }
+}
+
+uint32_t i2c_sim_transfer_time_us(const i2c_op_t *op, uint32_t freq) {
+    // 8 data bits and the acknowledge per byte, one clock each for start and stop, one more for a repeated start
+    uint32_t clocks = sim_wire_bytes(op) * 9 + 2;
+    if (op->type == I2C_OP_READ_REG && op->length > 0) {
+        clocks += 1;
+    }
+
+    if (freq == 0) {
+        freq = 100000;
+    }
+    return (uint32_t)(((uint64_t)clocks * 1000000 + freq - 1) / freq);
+}
+
+static esp_err_t sim_bus_config(i2c_port_t port, gpio_num_t sda, gpio_num_t scl, uint32_t freq, uint8_t installed) {
+    sim_freq[port] = freq;
+    return ESP_OK;
+}
+
+static void sim_bus_delete(i2c_port_t port) {
+    sim_freq[port] = 0;
+}
+
+static esp_err_t sim_execute(i2c_port_t port, uint8_t addr, const i2c_op_t *op, TickType_t timeout) {
+    uint32_t time_us = i2c_sim_transfer_time_us(op, sim_freq[port]) + sim_config.latency_us;
+    esp_err_t err;
+
+    if (sim_chance(sim_config.timeout_per_mille)) {
+        err = ESP_ERR_TIMEOUT;
+        time_us = timeout * portTICK_PERIOD_MS * 1000;
+    } else if (sim_chance(sim_config.nack_per_mille)) {
+        err = ESP_FAIL;
+    } else if (addr == I2C_SIM_MPU6886_ADDRESS && sim_mpu.present) {
+        err = sim_reg_device_execute(&sim_mpu, op, sim_mpu_read, sim_mpu_write);
+    } else if (addr == I2C_SIM_BMP280_ADDRESS && sim_bmp.present) {
+        err = sim_reg_device_execute(&sim_bmp, op, sim_bmp_read, sim_bmp_write);
+    } else if (addr == I2C_SIM_SHT30_ADDRESS && sim_sht.present) {
+        err = sim_sht_execute(op);
+    } else {
+        err = ESP_FAIL;
+    }
+
+    sim_stats.transactions++;
+    sim_stats.bus_time_us += time_us;
+    sim_bus_clock_us += time_us;
+    if (err == ESP_OK) {
+        sim_stats.bytes += sim_wire_bytes(op);
+    } else if (err == ESP_ERR_TIMEOUT) {
+        sim_stats.timeouts++;
+    } else {
+        sim_stats.nacks++;
+    }
+
+#ifdef ESP_PLATFORM
+    if (sim_config.realtime) {
+        ets_delay_us(time_us);
+    }
+#endif
+    return err;
+}
+
+static const i2c_backend_t sim_backend = {
+    .bus_config = sim_bus_config,
+    .bus_delete = sim_bus_delete,
+    .execute = sim_execute,
+    .prepare = NULL,
+    .release = NULL,
+};
+
+void i2c_sim_default_config(i2c_sim_config_t *config) {
+    memset(config, 0, sizeof(*config));
+    config->accel_g[2] = 1.0f;
+    config->temperature_c = 25.0f;
+    config->pressure_pa = 101325.0f;
+    config->humidity_rh = 45.0f;
+    config->accel_noise_g = 0.01f;
+    config->gyro_noise_dps = 0.5f;
+    config->temperature_noise_c = 0.05f;
+    config->pressure_noise_pa = 3.0f;
+    config->humidity_noise_rh = 0.2f;
+    config->realtime = 1;
+    config->seed = 1;
+}
+
+void i2c_sim_set_config(const i2c_sim_config_t *config) {
+    sim_config = *config;
+}
+
+void i2c_sim_install(const i2c_sim_config_t *config) {
+    sim_config = *config;
+    sim_random_state = (config->seed != 0) ? config->seed : 1;
+
+    sim_mpu_reset();
+    sim_bmp_reset();
+    memset(&sim_sht, 0, sizeof(sim_sht));
+    sim_mpu.present = 1;
+    sim_bmp.present = 1;
+    sim_sht.present = 1;
+
+    i2c_sim_reset_stats();
+    i2c_set_backend(&sim_backend);
+}
+
+void i2c_sim_set_present(uint8_t addr, uint8_t present) {
+    if (addr == I2C_SIM_MPU6886_ADDRESS) {
+        sim_mpu.present = present;
+    } else if (addr == I2C_SIM_BMP280_ADDRESS) {
+        sim_bmp.present = present;
+    } else if (addr == I2C_SIM_SHT30_ADDRESS) {
+        sim_sht.present = present;
+    }
+}
+
+void i2c_sim_advance_us(uint32_t us) {
+    sim_clock_offset_us += us;
+}
+
+void i2c_sim_get_stats(i2c_sim_stats_t *stats) {
+    *stats = sim_stats;
+}
+
+void i2c_sim_reset_stats(void) {
+    memset(&sim_stats, 0, sizeof(sim_stats));
+}
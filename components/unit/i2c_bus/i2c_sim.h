@@ -0,0 +1,81 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "i2c_device.h"
+
+/*
+    Simulated I2C bus with register-level models of the M5GO sensors, installed as the i2c_device backend.
+
+    MPU6886 (0x68): WHOAMI 0x19, accel/gyro/temp outputs scaled by the configured full scale ranges,
+                    sample rate divider, latched data ready and FIFO overflow in INT_STATUS, 1 KB FIFO
+    BMP280  (0x76): chip id 0x58, calibration block, forced and normal mode conversions into the ADC registers
+    SHT30   (0x44): periodic, single shot and fetch commands, 6 byte results with CRC, NACK when no data is ready
+
+    Every transfer is timed with a bus model: 9 clocks per byte plus start, repeated start and stop,
+    at the clock the bus is configured for (100 kHz, 400 kHz, 1 MHz, ...).
+*/
+
+#define I2C_SIM_MPU6886_ADDRESS 0x68
+#define I2C_SIM_BMP280_ADDRESS  0x76
+#define I2C_SIM_SHT30_ADDRESS   0x44
+
+typedef struct {
+    // What the sensors measure
+    float accel_g[3];
+    float gyro_dps[3];
+    float temperature_c;
+    float pressure_pa;
+    float humidity_rh;
+
+    // Amplitude of the uniform noise added to every conversion
+    float accel_noise_g;
+    float gyro_noise_dps;
+    float temperature_noise_c;
+    float pressure_noise_pa;
+    float humidity_noise_rh;
+
+    uint32_t latency_us;            // added to the modelled time of every transfer
+    uint16_t nack_per_mille;        // chance of a transfer failing with ESP_FAIL
+    uint16_t timeout_per_mille;     // chance of a transfer failing with ESP_ERR_TIMEOUT
+    uint8_t realtime;               // on target, busy wait the modelled time so the i2c_device stats match hardware
+    uint32_t seed;
+} i2c_sim_config_t;
+
+typedef struct {
+    uint32_t transactions;
+    uint32_t bytes;                 // bytes on the wire, address bytes included
+    uint64_t bus_time_us;           // modelled time the bus was busy
+    uint32_t nacks;
+    uint32_t timeouts;
+} i2c_sim_stats_t;
+
+void i2c_sim_default_config(i2c_sim_config_t *config);
+
+/*
+    Reset the sensor models and make the simulation the i2c_device backend.
+    Call before the first transfer, i.e. before the drivers are initialized.
+*/
+void i2c_sim_install(const i2c_sim_config_t *config);
+
+// Update what the sensors measure and the fault settings while running
+void i2c_sim_set_config(const i2c_sim_config_t *config);
+
+// Unplug (present = 0) or plug a sensor back in; an absent sensor NACKs its address
+void i2c_sim_set_present(uint8_t addr, uint8_t present);
+
+// Move the simulated clock, which paces the MPU6886 sample rate, forward; for runs without a real time base
+void i2c_sim_advance_us(uint32_t us);
+
+void i2c_sim_get_stats(i2c_sim_stats_t *stats);
+
+void i2c_sim_reset_stats(void);
+
+// Modelled duration of op at freq
+uint32_t i2c_sim_transfer_time_us(const i2c_op_t *op, uint32_t freq);
+
+#ifdef __cplusplus
+}
+#endif
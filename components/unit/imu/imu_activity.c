@@ -0,0 +1,102 @@
+#include <math.h>
+
+#include "esp_log.h"
+#include "esp_err.h"
+
+#include "imu_sampler.h"
+#include "imu_activity.h"
+
+#define TAG "IMU-ACTIVITY"
+
+static imu_activity_config_t activity_config;
+static uint8_t activity_running;
+static volatile imu_activity_state_t activity_state;
+static volatile uint32_t activity_transitions;
+static int64_t activity_last_motion_us;
+static float activity_last_accel[3];
+
+void imu_activity_default_config(imu_activity_config_t *config) {
+    config->wake_threshold_mg = 64;
+    config->wake_odr_hz = 10;
+    config->motion_dps = 10.0f;
+    config->quiet_ms = 30000;
+}
+
+static uint8_t imu_activity_is_motion(const mpu6886_sample_t *sample) {
+    float threshold_g = activity_config.wake_threshold_mg * 0.001f;
+    uint8_t motion = 0;
+
+    for (int i = 0; i < 3; i++) {
+        if (fabsf(sample->gyro[i]) > activity_config.motion_dps || fabsf(sample->accel[i] - activity_last_accel[i]) > threshold_g) {
+            motion = 1;
+        }
+        activity_last_accel[i] = sample->accel[i];
+    }
+    return motion;
+}
+
+static void imu_activity_on_sample(const imu_sample_t *sample, void *arg) {
+    mpu6886_sample_t scaled;
+    MPU6886_ScaleSamples(&sample->raw, 1, &scaled);
+    uint8_t motion = imu_activity_is_motion(&scaled);
+
+    if (activity_state == IMU_ACTIVITY_IDLE) {
+        // Samples only come while awake, the sleep is over
+        activity_state = IMU_ACTIVITY_ACTIVE;
+        activity_transitions++;
+        activity_last_motion_us = sample->timestamp_us;
+        ESP_LOGI(TAG, "Active");
+        return;
+    }
+    if (motion) {
+        activity_last_motion_us = sample->timestamp_us;
+        return;
+    }
+    if (sample->timestamp_us - activity_last_motion_us < (int64_t)activity_config.quiet_ms * 1000) {
+        return;
+    }
+
+    // The sampler sleeps once this callback returned; if it fails to, the next sample ends the idle profile and
+    // the next attempt follows another quiet period
+    esp_err_t err = imu_sampler_request_sleep(activity_config.wake_threshold_mg, activity_config.wake_odr_hz);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Cannot sleep (%s), staying active", esp_err_to_name(err));
+        activity_last_motion_us = sample->timestamp_us;
+        return;
+    }
+    activity_state = IMU_ACTIVITY_IDLE;
+    activity_transitions++;
+    ESP_LOGI(TAG, "Idle");
+}
+
+esp_err_t imu_activity_start(const imu_activity_config_t *config) {
+    if (config == NULL || config->wake_odr_hz == 0 || config->wake_threshold_mg > 0xFF * 4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (activity_running) {
+        return ESP_OK;
+    }
+    if (!imu_sampler_running()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    activity_config = *config;
+    activity_state = IMU_ACTIVITY_ACTIVE;
+    // The first sample counts as motion, the quiet period starts with it
+    activity_last_accel[0] = activity_last_accel[1] = activity_last_accel[2] = 1e3f;
+    esp_err_t err = imu_sampler_subscribe(imu_activity_on_sample, NULL);
+    activity_running = (err == ESP_OK);
+    return err;
+}
+
+uint8_t imu_activity_running(void) {
+    return activity_running;
+}
+
+imu_activity_state_t imu_activity_get_state(void) {
+    return activity_state;
+}
+
+uint32_t imu_activity_transitions(void) {
+    return activity_transitions;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+
+/*
+    Active and idle profiles, switched by motion.
+
+    While active the IMU sampler runs at its full rate. After quiet_ms without motion the sampler is put to sleep
+    in the MPU6886 wake on motion mode: the gyro is off and the accelerometer cycles at wake_odr_hz in low power.
+    The first sample after the sampler woke up, because of motion or because someone took the sensor over,
+    makes the device active again. The application picks its own rates per profile, e.g. the telemetry interval.
+
+    While active, motion is a gyro rate above motion_dps or an accel change between two samples above
+    wake_threshold_mg, the test the sensor applies while idle. motion_dps has to stay above the gyro offset,
+    which is several dps on an uncalibrated part.
+*/
+
+typedef enum {
+    IMU_ACTIVITY_ACTIVE = 0,
+    IMU_ACTIVITY_IDLE,
+} imu_activity_state_t;
+
+typedef struct {
+    uint16_t wake_threshold_mg; // 4 mg steps
+    uint16_t wake_odr_hz;       // accelerometer rate while idle
+    float motion_dps;
+    uint32_t quiet_ms;          // without motion before going idle
+} imu_activity_config_t;
+
+void imu_activity_default_config(imu_activity_config_t *config);
+
+// Follow the samples of the IMU sampler, which has to be running
+esp_err_t imu_activity_start(const imu_activity_config_t *config);
+
+uint8_t imu_activity_running(void);
+
+// IMU_ACTIVITY_ACTIVE while not running
+imu_activity_state_t imu_activity_get_state(void);
+
+// Profile switches since the start, to notice a switch between two polls
+uint32_t imu_activity_transitions(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,239 @@
+#include <math.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "imu_sampler.h"
+#include "imu_fusion.h"
+#include "imu_calibration.h"
+
+#define TAG "IMU-CALIBRATION"
+
+// Bumped when mpu6886_calibration_t changes, older blobs are ignored
+#define IMU_CALIBRATION_VERSION 1
+
+#define IMU_CALIBRATION_FIFO_WATERMARK 16
+#define IMU_CALIBRATION_READ_SAMPLES 32
+
+// A vertical axis reads at least this much of 1 g, scales further than this from 1 are a failed calibration
+#define IMU_CALIBRATION_VERTICAL_G 0.8f
+#define IMU_CALIBRATION_MAX_SCALE_ERROR 0.1f
+
+typedef struct {
+    uint32_t version;
+    mpu6886_calibration_t calibration;
+} imu_calibration_blob_t;
+
+// Mean and spread of one measurement, in g and dps without calibration
+typedef struct {
+    float accel[3];
+    float gyro[3];
+    float accel_range;
+    float gyro_range;
+} imu_calibration_measurement_t;
+
+static float accel_up[3];
+static float accel_down[3];
+static uint8_t accel_positions;
+
+static esp_err_t imu_calibration_measure(imu_calibration_measurement_t *measurement) {
+    static mpu6886_raw_sample_t samples[IMU_CALIBRATION_READ_SAMPLES];
+    const size_t wanted = IMU_CALIBRATION_SETTLE_SAMPLES + IMU_CALIBRATION_SAMPLES;
+    int64_t deadline = esp_timer_get_time() + (int64_t)wanted * 2 * 1000000 / IMU_CALIBRATION_RATE_HZ;
+    int64_t accel_sum[3] = { 0, 0, 0 }, gyro_sum[3] = { 0, 0, 0 };
+    int16_t accel_min[3], accel_max[3], gyro_min[3], gyro_max[3];
+    size_t count = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        accel_min[axis] = gyro_min[axis] = INT16_MAX;
+        accel_max[axis] = gyro_max[axis] = INT16_MIN;
+    }
+
+    // Pausing also wakes the sensor if it sleeps in wake on motion
+    imu_sampler_pause();
+    esp_err_t err = MPU6886_FifoStart(IMU_CALIBRATION_RATE_HZ, IMU_CALIBRATION_FIFO_WATERMARK);
+    while (err == ESP_OK && count < wanted && esp_timer_get_time() < deadline) {
+        size_t read = 0;
+        int64_t timestamp;
+        size_t left = wanted - count;
+        (void)MPU6886_FifoRead(samples, (left < IMU_CALIBRATION_READ_SAMPLES) ? left : IMU_CALIBRATION_READ_SAMPLES, &read, &timestamp);
+        for (size_t i = 0; i < read; i++, count++) {
+            if (count < IMU_CALIBRATION_SETTLE_SAMPLES) {
+                continue;
+            }
+            for (int axis = 0; axis < 3; axis++) {
+                int16_t a = samples[i].accel[axis], g = samples[i].gyro[axis];
+                accel_sum[axis] += a;
+                gyro_sum[axis] += g;
+                accel_min[axis] = (a < accel_min[axis]) ? a : accel_min[axis];
+                accel_max[axis] = (a > accel_max[axis]) ? a : accel_max[axis];
+                gyro_min[axis] = (g < gyro_min[axis]) ? g : gyro_min[axis];
+                gyro_max[axis] = (g > gyro_max[axis]) ? g : gyro_max[axis];
+            }
+        }
+        if (read == 0) {
+            vTaskDelay(pdMS_TO_TICKS(IMU_CALIBRATION_FIFO_WATERMARK * 1000 / IMU_CALIBRATION_RATE_HZ));
+        }
+    }
+    MPU6886_FifoStop();
+    imu_sampler_resume();
+
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (count < wanted) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    float acc_res = MPU6886_GetAccRes(MPU6886_GetAccelFSR());
+    float gyro_res = MPU6886_GetGyroRes(MPU6886_GetGyroFSR());
+    measurement->accel_range = 0.0f;
+    measurement->gyro_range = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        measurement->accel[axis] = (float)accel_sum[axis] / IMU_CALIBRATION_SAMPLES * acc_res;
+        measurement->gyro[axis] = (float)gyro_sum[axis] / IMU_CALIBRATION_SAMPLES * gyro_res;
+        measurement->accel_range = fmaxf(measurement->accel_range, (accel_max[axis] - accel_min[axis]) * acc_res);
+        measurement->gyro_range = fmaxf(measurement->gyro_range, (gyro_max[axis] - gyro_min[axis]) * gyro_res);
+    }
+
+    if (measurement->accel_range > IMU_CALIBRATION_STILL_G || measurement->gyro_range > IMU_CALIBRATION_STILL_DPS) {
+        ESP_LOGW(TAG, "Moved during the measurement, accel spread %.3f g, gyro spread %.2f dps", measurement->accel_range, measurement->gyro_range);
+        return ESP_ERR_INVALID_STATE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t imu_calibration_load(void) {
+    nvs_handle_t handle;
+    imu_calibration_blob_t blob;
+    size_t size = sizeof(blob);
+
+    esp_err_t err = nvs_open(IMU_CALIBRATION_NVS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(handle, IMU_CALIBRATION_NVS_KEY, &blob, &size);
+        nvs_close(handle);
+    }
+    if (err == ESP_ERR_NVS_NOT_FOUND || (err == ESP_OK && (size != sizeof(blob) || blob.version != IMU_CALIBRATION_VERSION))) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    MPU6886_SetCalibration(&blob.calibration);
+    ESP_LOGI(TAG, "Gyro bias (%.2f, %.2f, %.2f) dps", blob.calibration.gyro_bias[0], blob.calibration.gyro_bias[1], blob.calibration.gyro_bias[2]);
+    return ESP_OK;
+}
+
+esp_err_t imu_calibration_save(void) {
+    nvs_handle_t handle;
+    imu_calibration_blob_t blob;
+    blob.version = IMU_CALIBRATION_VERSION;
+    MPU6886_GetCalibration(&blob.calibration);
+
+    esp_err_t err = nvs_open(IMU_CALIBRATION_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_set_blob(handle, IMU_CALIBRATION_NVS_KEY, &blob, sizeof(blob));
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t imu_calibration_reset(void) {
+    mpu6886_calibration_t calibration;
+    MPU6886_DefaultCalibration(&calibration);
+    MPU6886_SetCalibration(&calibration);
+    accel_positions = 0;
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(IMU_CALIBRATION_NVS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err != ESP_OK) {
+        return err;
+    }
+    err = nvs_erase_key(handle, IMU_CALIBRATION_NVS_KEY);
+    err = (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+    if (err == ESP_OK) {
+        err = nvs_commit(handle);
+    }
+    nvs_close(handle);
+    return err;
+}
+
+esp_err_t imu_calibration_measure_gyro(void) {
+    imu_calibration_measurement_t measurement;
+    esp_err_t err = imu_calibration_measure(&measurement);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    mpu6886_calibration_t calibration;
+    MPU6886_GetCalibration(&calibration);
+    memcpy(calibration.gyro_bias, measurement.gyro, sizeof(calibration.gyro_bias));
+    // The bias the fusion had converged on is now removed before it, start tracking the rest from zero
+    imu_sampler_pause();
+    MPU6886_SetCalibration(&calibration);
+    imu_fusion_reset_bias();
+    imu_sampler_resume();
+    ESP_LOGI(TAG, "Gyro bias (%.2f, %.2f, %.2f) dps", measurement.gyro[0], measurement.gyro[1], measurement.gyro[2]);
+    return ESP_OK;
+}
+
+esp_err_t imu_calibration_measure_accel(uint8_t *positions) {
+    imu_calibration_measurement_t measurement;
+    esp_err_t err = imu_calibration_measure(&measurement);
+    *positions = accel_positions;
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    int vertical = 0;
+    for (int axis = 1; axis < 3; axis++) {
+        vertical = (fabsf(measurement.accel[axis]) > fabsf(measurement.accel[vertical])) ? axis : vertical;
+    }
+    float g = measurement.accel[vertical];
+    if (fabsf(g) < IMU_CALIBRATION_VERTICAL_G) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Only the vertical axis learns from a position, the others read about 0 g and say little about their scale
+    if (g > 0.0f) {
+        accel_up[vertical] = g;
+        accel_positions |= 1 << (2 * vertical);
+    } else {
+        accel_down[vertical] = g;
+        accel_positions |= 1 << (2 * vertical + 1);
+    }
+    *positions = accel_positions;
+    if (accel_positions != IMU_CALIBRATION_ALL_POSITIONS) {
+        return ESP_OK;
+    }
+
+    mpu6886_calibration_t calibration;
+    MPU6886_GetCalibration(&calibration);
+    for (int axis = 0; axis < 3; axis++) {
+        float scale = 2.0f / (accel_up[axis] - accel_down[axis]);
+        if (fabsf(scale - 1.0f) > IMU_CALIBRATION_MAX_SCALE_ERROR) {
+            // A position was probably measured tilted; start over rather than apply it
+            accel_positions = 0;
+            *positions = 0;
+            return ESP_ERR_INVALID_STATE;
+        }
+        calibration.accel_offset[axis] = (accel_up[axis] + accel_down[axis]) * 0.5f;
+        calibration.accel_scale[axis] = scale;
+    }
+    MPU6886_SetCalibration(&calibration);
+    accel_positions = 0;
+    ESP_LOGI(TAG, "Accel offset (%.3f, %.3f, %.3f) g, scale (%.4f, %.4f, %.4f)", calibration.accel_offset[0], calibration.accel_offset[1],
+             calibration.accel_offset[2], calibration.accel_scale[0], calibration.accel_scale[1], calibration.accel_scale[2]);
+    return ESP_OK;
+}
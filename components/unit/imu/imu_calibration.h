@@ -0,0 +1,59 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+
+#include "mpu6886.h"
+
+/*
+    MPU6886 calibration, kept in NVS and applied by the driver's conversions, see mpu6886_calibration_t.
+
+    Every measurement pauses the IMU sampler and averages IMU_CALIBRATION_SAMPLES frames streamed through the FIFO.
+    A measurement whose readings spread more than the IMU_CALIBRATION_STILL_* limits was taken while the device
+    moved and is rejected with ESP_ERR_INVALID_STATE.
+
+    Gyro: the mean rate at rest is the bias.
+    Accelerometer, six positions: each axis is measured pointing up and pointing down, in any order, one call
+    per position. The two readings of an axis are +1 g and -1 g once corrected, which gives its offset and scale;
+    they are applied once all six positions are in. A scale further than 10 % from 1 means a position was tilted:
+    all six are discarded and ESP_ERR_INVALID_STATE returned.
+
+    Measurements only change the calibration in use; imu_calibration_save stores it.
+*/
+
+#define IMU_CALIBRATION_NVS_NAMESPACE "storage"
+#define IMU_CALIBRATION_NVS_KEY "imu_cal"
+
+#define IMU_CALIBRATION_RATE_HZ 200
+#define IMU_CALIBRATION_SAMPLES 400
+// Frames dropped at the start while a gyro coming out of standby settles
+#define IMU_CALIBRATION_SETTLE_SAMPLES 20
+
+#define IMU_CALIBRATION_STILL_DPS 2.0f
+#define IMU_CALIBRATION_STILL_G 0.05f
+
+// All six accelerometer positions, bit 2 * axis pointing up and bit 2 * axis + 1 pointing down
+#define IMU_CALIBRATION_ALL_POSITIONS 0x3F
+
+// Apply the stored calibration; ESP_ERR_NOT_FOUND if none was stored
+esp_err_t imu_calibration_load(void);
+
+esp_err_t imu_calibration_save(void);
+
+// Back to no correction, erases the stored calibration and the accelerometer positions measured so far
+esp_err_t imu_calibration_reset(void);
+
+esp_err_t imu_calibration_measure_gyro(void);
+
+/*
+    Measure the accelerometer in its current position, which must have one axis along gravity.
+    positions returns the positions measured so far; ESP_ERR_INVALID_ARG if no axis is vertical.
+*/
+esp_err_t imu_calibration_measure_accel(uint8_t *positions);
+
+#ifdef __cplusplus
+}
+#endif
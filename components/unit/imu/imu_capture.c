@@ -0,0 +1,232 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "imu_sampler.h"
+#include "imu_capture.h"
+
+#define TAG "IMU-CAPTURE"
+
+typedef enum {
+    IMU_CAPTURE_ARMED = 0,
+    IMU_CAPTURE_TRIGGERED,      // recording the samples after the trigger
+    IMU_CAPTURE_FROZEN,
+} imu_capture_state_t;
+
+static const char *const capture_trigger_names[IMU_CAPTURE_TRIGGER_COUNT] = { "threshold", "pir", "command" };
+
+static int16_t capture_ring[IMU_CAPTURE_RING_SAMPLES][IMU_CAPTURE_AXES];
+static uint16_t capture_head;   // next slot written
+static uint16_t capture_history; // contiguous samples in the ring
+static int64_t capture_last_us;
+
+static uint8_t capture_running;
+static uint16_t capture_rate_hz;
+static uint16_t capture_pre_samples;
+static uint16_t capture_post_samples;
+static uint32_t capture_threshold_sq; // raw counts, squared
+static int64_t capture_gap_us;
+
+static volatile imu_capture_state_t capture_state;
+static portMUX_TYPE capture_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t capture_request;  // trigger + 1, 0 for none
+static int64_t capture_request_us;
+static imu_capture_trigger_t capture_trigger;
+static int64_t capture_trigger_us;
+static uint16_t capture_trigger_pre;
+static uint16_t capture_remaining;
+static uint8_t capture_rotated;
+
+void imu_capture_default_config(imu_capture_config_t *config) {
+    config->pre_ms = 1000;
+    config->post_ms = 1000;
+    config->trigger_g = 3.0f;
+}
+
+const char *imu_capture_trigger_name(imu_capture_trigger_t trigger) {
+    return (trigger < IMU_CAPTURE_TRIGGER_COUNT) ? capture_trigger_names[trigger] : "unknown";
+}
+
+static void imu_capture_on_sample(const imu_sample_t *sample, void *arg) {
+    if (capture_state == IMU_CAPTURE_FROZEN) {
+        return;
+    }
+
+    if (sample->timestamp_us - capture_last_us > capture_gap_us) {
+        capture_history = 0;
+    }
+    capture_last_us = sample->timestamp_us;
+    int16_t *slot = capture_ring[capture_head];
+    memcpy(slot, sample->raw.accel, sizeof(sample->raw.accel));
+    memcpy(slot + 3, sample->raw.gyro, sizeof(sample->raw.gyro));
+    capture_head = (capture_head + 1) % IMU_CAPTURE_RING_SAMPLES;
+    capture_history += (capture_history < IMU_CAPTURE_RING_SAMPLES);
+
+    if (capture_state == IMU_CAPTURE_TRIGGERED) {
+        if (--capture_remaining == 0) {
+            capture_state = IMU_CAPTURE_FROZEN;
+        }
+        return;
+    }
+
+    portENTER_CRITICAL(&capture_lock);
+    uint8_t request = capture_request;
+    int64_t request_us = capture_request_us;
+    capture_request = 0;
+    portEXIT_CRITICAL(&capture_lock);
+    if (request != 0 && sample->timestamp_us - request_us > capture_gap_us) {
+        // Held up by a paused sampler or a failed wake up, this sample is no longer the time of the trigger
+        ESP_LOGW(TAG, "Dropped a %s trigger of %lld ms ago", capture_trigger_names[request - 1], (long long)((sample->timestamp_us - request_us) / 1000));
+        request = 0;
+    }
+    if (request == 0) {
+        // Integer math on the raw counts keeps the steady state to a few multiplies
+        uint32_t magnitude_sq = 0;
+        for (int i = 0; i < 3; i++) {
+            magnitude_sq += (uint32_t)((int32_t)slot[i] * slot[i]);
+        }
+        if (capture_threshold_sq == 0 || magnitude_sq <= capture_threshold_sq) {
+            return;
+        }
+        request = IMU_CAPTURE_TRIGGER_THRESHOLD + 1;
+    }
+
+    capture_trigger = (imu_capture_trigger_t)(request - 1);
+    capture_trigger_us = sample->timestamp_us;
+    capture_trigger_pre = (capture_history - 1 < capture_pre_samples) ? capture_history - 1 : capture_pre_samples;
+    capture_remaining = capture_post_samples - 1;
+    capture_state = (capture_remaining == 0) ? IMU_CAPTURE_FROZEN : IMU_CAPTURE_TRIGGERED;
+}
+
+esp_err_t imu_capture_start(const imu_capture_config_t *config) {
+    if (config == NULL || config->post_ms == 0) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (capture_running) {
+        return ESP_OK;
+    }
+    if (!imu_sampler_running()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    capture_rate_hz = imu_sampler_rate_hz();
+    uint32_t pre = (uint32_t)config->pre_ms * capture_rate_hz / 1000;
+    uint32_t post = ((uint32_t)config->post_ms * capture_rate_hz + 999) / 1000;
+    if (pre + post > IMU_CAPTURE_RING_SAMPLES) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    capture_pre_samples = (uint16_t)pre;
+    capture_post_samples = (uint16_t)post;
+    capture_gap_us = (int64_t)IMU_CAPTURE_GAP_PERIODS * 1000000 / capture_rate_hz;
+
+    float threshold = config->trigger_g / MPU6886_GetAccRes(MPU6886_GetAccelFSR());
+    // Beyond the full scale range the threshold could never be crossed
+    capture_threshold_sq = (threshold >= 32768.0f) ? UINT32_MAX : (uint32_t)(threshold * threshold);
+
+    esp_err_t err = imu_sampler_subscribe(imu_capture_on_sample, NULL);
+    capture_running = (err == ESP_OK);
+    if (capture_running) {
+        ESP_LOGI(TAG, "%u samples before and %u after a trigger at %u Hz", (unsigned)pre, (unsigned)post, (unsigned)capture_rate_hz);
+    }
+    return err;
+}
+
+uint8_t imu_capture_running(void) {
+    return capture_running;
+}
+
+uint8_t imu_capture_has_history(void) {
+    return capture_running && capture_state == IMU_CAPTURE_ARMED && capture_history > 1;
+}
+
+esp_err_t imu_capture_trigger(imu_capture_trigger_t trigger) {
+    if (!capture_running || trigger >= IMU_CAPTURE_TRIGGER_COUNT || capture_state != IMU_CAPTURE_ARMED) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    // Asleep in wake on motion no sample would come until the next motion, too late for the trigger
+    imu_sampler_wake();
+
+    // Stamped after the wake up, whose register writes take a while
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&capture_lock);
+    esp_err_t err = (capture_state == IMU_CAPTURE_ARMED) ? ESP_OK : ESP_ERR_INVALID_STATE;
+    if (err == ESP_OK) {
+        capture_request = (uint8_t)(trigger + 1);
+        capture_request_us = now_us;
+    }
+    portEXIT_CRITICAL(&capture_lock);
+    return err;
+}
+
+// Rotate the ring left by count slots, so the oldest sample of the window is first
+static void imu_capture_rotate(uint16_t count) {
+    uint16_t first = 0, middle = count, last = IMU_CAPTURE_RING_SAMPLES;
+    // Three reversals, in place; the ring is frozen, nothing else touches it
+    for (int pass = 0; pass < 3; pass++) {
+        uint16_t lo = (pass == 1) ? middle : first;
+        uint16_t hi = (pass == 0) ? middle : last;
+        while (lo + 1 < hi) {
+            int16_t swap[IMU_CAPTURE_AXES];
+            memcpy(swap, capture_ring[lo], sizeof(swap));
+            memcpy(capture_ring[lo], capture_ring[hi - 1], sizeof(swap));
+            memcpy(capture_ring[hi - 1], swap, sizeof(swap));
+            lo++;
+            hi--;
+        }
+    }
+}
+
+esp_err_t imu_capture_get(imu_capture_window_t *window) {
+    if (capture_state != IMU_CAPTURE_FROZEN) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint16_t samples = capture_trigger_pre + capture_post_samples;
+    if (!capture_rotated) {
+        // The last sample written is the window's last
+        imu_capture_rotate((capture_head + IMU_CAPTURE_RING_SAMPLES - samples) % IMU_CAPTURE_RING_SAMPLES);
+        capture_rotated = 1;
+    }
+    window->trigger = capture_trigger;
+    window->trigger_us = capture_trigger_us;
+    window->rate_hz = capture_rate_hz;
+    window->pre_samples = capture_trigger_pre;
+    window->samples = samples;
+    window->data = (const int16_t (*)[IMU_CAPTURE_AXES])capture_ring;
+    return ESP_OK;
+}
+
+void imu_capture_release(void) {
+    portENTER_CRITICAL(&capture_lock);
+    if (capture_state == IMU_CAPTURE_FROZEN) {
+        // The rotated ring is no history to trigger on
+        capture_head = 0;
+        capture_history = 0;
+        capture_rotated = 0;
+        capture_state = IMU_CAPTURE_ARMED;
+    }
+    portEXIT_CRITICAL(&capture_lock);
+}
+
+size_t imu_capture_encode(const int16_t (*samples)[IMU_CAPTURE_AXES], size_t count, uint8_t *out) {
+    uint8_t *start = out;
+    int32_t previous[IMU_CAPTURE_AXES] = { 0 };
+
+    for (size_t n = 0; n < count; n++) {
+        for (int axis = 0; axis < IMU_CAPTURE_AXES; axis++) {
+            int32_t delta = samples[n][axis] - previous[axis];
+            previous[axis] = samples[n][axis];
+            uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+            while (zigzag >= 0x80) {
+                *out++ = (uint8_t)(zigzag | 0x80);
+                zigzag >>= 7;
+            }
+            *out++ = (uint8_t)zigzag;
+        }
+    }
+    return out - start;
+}
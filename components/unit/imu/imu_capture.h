@@ -0,0 +1,97 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+
+#include "esp_err.h"
+
+/*
+    Pre-trigger capture of the IMU sampler's stream, the way an oscilloscope's single shot works.
+
+    Every sample goes into a preallocated ring of IMU_CAPTURE_RING_SAMPLES raw accel and gyro samples, a copy and
+    an integer threshold test per sample. A trigger (the accelerometer magnitude crossing trigger_g, or
+    imu_capture_trigger for a PIR edge or a command) keeps pre_ms of samples before it, records post_ms after
+    it and freezes the ring. The frozen window is held, and no new trigger is taken, until imu_capture_release.
+
+    The pre-trigger part only reaches back over uninterrupted sampling; a paused or sleeping sampler shortens it.
+    imu_capture_trigger wakes a sleeping sampler, so the trigger sample is the first one after the wake up.
+*/
+
+#define IMU_CAPTURE_RING_SAMPLES 512
+
+// A gap of this many sample periods ends the history the pre-trigger part can use, and a trigger request
+#define IMU_CAPTURE_GAP_PERIODS 3
+
+// Accel X/Y/Z then gyro X/Y/Z, raw counts
+#define IMU_CAPTURE_AXES 6
+
+// Worst case of imu_capture_encode, three bytes per value
+#define IMU_CAPTURE_ENCODED_MAX(samples) ((samples) * IMU_CAPTURE_AXES * 3)
+
+typedef enum {
+    IMU_CAPTURE_TRIGGER_THRESHOLD = 0,
+    IMU_CAPTURE_TRIGGER_PIR,
+    IMU_CAPTURE_TRIGGER_COMMAND,
+    IMU_CAPTURE_TRIGGER_COUNT
+} imu_capture_trigger_t;
+
+typedef struct {
+    uint16_t pre_ms;
+    uint16_t post_ms;           // including the trigger sample
+    float trigger_g;            // |a| above this triggers, 0 disables the threshold
+} imu_capture_config_t;
+
+typedef struct {
+    imu_capture_trigger_t trigger;
+    int64_t trigger_us;         // timestamp of the trigger sample
+    uint16_t rate_hz;
+    uint16_t pre_samples;       // samples before the trigger sample, which is data[pre_samples]
+    uint16_t samples;
+    const int16_t (*data)[IMU_CAPTURE_AXES]; // oldest first, valid until imu_capture_release
+} imu_capture_window_t;
+
+void imu_capture_default_config(imu_capture_config_t *config);
+
+/*
+    Record the samples of the IMU sampler, which has to be running; its rate sets how many samples the
+    window holds. ESP_ERR_INVALID_ARG if pre_ms and post_ms do not fit into the ring at that rate.
+*/
+esp_err_t imu_capture_start(const imu_capture_config_t *config);
+
+uint8_t imu_capture_running(void);
+
+/*
+    1 while armed with samples a trigger could keep as its pre-trigger part; pausing the sampler now would cut
+    them off. A held window or a ring emptied by a gap has nothing to lose.
+*/
+uint8_t imu_capture_has_history(void);
+
+/*
+    Trigger on the next sample, waking the sampler if it sleeps; call from a task, not from a sampler callback.
+    A request that no sample took within IMU_CAPTURE_GAP_PERIODS, e.g. behind a paused sampler, is dropped.
+    ESP_ERR_INVALID_STATE while not running or while a window is triggered or held
+*/
+esp_err_t imu_capture_trigger(imu_capture_trigger_t trigger);
+
+// The frozen window; ESP_ERR_NOT_FOUND until a trigger's window is complete
+esp_err_t imu_capture_get(imu_capture_window_t *window);
+
+// Drop the window and arm again
+void imu_capture_release(void);
+
+const char *imu_capture_trigger_name(imu_capture_trigger_t trigger);
+
+/*
+    Compress samples for upload: per axis the difference to the previous sample (to 0 for the first one),
+    zigzag mapped so small negative values stay small, as a little endian base 128 varint; samples are
+    interleaved, ax ay az gx gy gz of the first sample, then of the second one.
+    out holds IMU_CAPTURE_ENCODED_MAX(count) bytes; return the bytes written
+*/
+size_t imu_capture_encode(const int16_t (*samples)[IMU_CAPTURE_AXES], size_t count, uint8_t *out);
+
+#ifdef __cplusplus
+}
+#endif
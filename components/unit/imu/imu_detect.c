@@ -0,0 +1,184 @@
+#include <math.h>
+#include <string.h>
+
+#include "imu_detect.h"
+
+// Time constants of the resting level and of the step filter, about 4 Hz
+#define IMU_DETECT_REST_TAU_S 2.0f
+#define IMU_DETECT_STEP_TAU_S 0.04f
+// The resting level only follows samples this close to it
+#define IMU_DETECT_REST_BAND_G 0.1f
+// Gaps longer than this (a paused or sleeping sampler) restart the filters instead of being integrated
+#define IMU_DETECT_MAX_DT_S 0.1f
+
+static const char *const imu_detect_names[IMU_EVENT_TYPE_COUNT] = { "tap", "doubleTap", "shock", "freeFall", "step" };
+
+void imu_detect_default_config(imu_detect_config_t *config) {
+    config->tap_g = 1.0f;
+    config->tap_max_ms = 60;
+    config->tap_quiet_ms = 100;
+    config->double_tap_ms = 400;
+    config->shock_g = 3.0f;
+    config->freefall_g = 0.3f;
+    config->freefall_ms = 100;
+    config->step_g = 0.12f;
+    config->step_min_ms = 250;
+    config->step_max_ms = 1000;
+}
+
+void imu_detect_init(imu_detect_t *detect, const imu_detect_config_t *config) {
+    memset(detect, 0, sizeof(*detect));
+    detect->config = *config;
+    detect->rest = 1.0f;
+}
+
+const char *imu_detect_event_name(imu_event_type_t type) {
+    return (type < IMU_EVENT_TYPE_COUNT) ? imu_detect_names[type] : "unknown";
+}
+
+static size_t imu_detect_emit(imu_event_t *events, size_t count, imu_event_type_t type, int64_t start_us, int64_t now_us, float value) {
+    events[count].type = type;
+    events[count].timestamp_us = start_us;
+    events[count].detected_us = now_us;
+    events[count].value = value;
+    return count + 1;
+}
+
+static size_t imu_detect_shock(imu_detect_t *detect, float magnitude, int64_t now, imu_event_t *events, size_t count) {
+    const imu_detect_config_t *config = &detect->config;
+
+    if (magnitude > config->shock_g) {
+        if (!detect->in_shock) {
+            detect->in_shock = 1;
+            detect->shock_start_us = now;
+            detect->shock_peak = 0.0f;
+        }
+        detect->shock_peak = fmaxf(detect->shock_peak, magnitude);
+        detect->spike_shock = 1;
+    } else if (detect->in_shock && magnitude < 0.8f * config->shock_g) {
+        detect->in_shock = 0;
+        count = imu_detect_emit(events, count, IMU_EVENT_SHOCK, detect->shock_start_us, now, detect->shock_peak);
+    }
+    return count;
+}
+
+static size_t imu_detect_tap(imu_detect_t *detect, float magnitude, int64_t now, imu_event_t *events, size_t count) {
+    const imu_detect_config_t *config = &detect->config;
+    float excess = fabsf(magnitude - detect->rest);
+
+    if (!detect->in_spike && excess > config->tap_g && now >= detect->spike_ignore_until_us) {
+        detect->in_spike = 1;
+        detect->spike_shock = detect->in_shock;
+        detect->spike_start_us = now;
+        detect->spike_peak = 0.0f;
+    }
+    if (detect->in_spike) {
+        detect->spike_peak = fmaxf(detect->spike_peak, magnitude);
+        if (excess < 0.5f * config->tap_g) {
+            detect->in_spike = 0;
+            detect->spike_ignore_until_us = now + config->tap_quiet_ms * 1000;
+            int64_t length = now - detect->spike_start_us;
+            if (length > config->tap_max_ms * 1000 || detect->spike_shock) {
+                // Handling or an impact, not a tap; a tap waiting for its second one is part of the same motion
+                detect->tap_pending = 0;
+            } else if (detect->tap_pending) {
+                detect->tap_pending = 0;
+                count = imu_detect_emit(events, count, IMU_EVENT_DOUBLE_TAP, detect->tap_start_us, now, detect->spike_peak);
+            } else {
+                detect->tap_pending = 1;
+                detect->tap_start_us = detect->spike_start_us;
+                detect->tap_peak = detect->spike_peak;
+            }
+        } else if (now - detect->spike_start_us > config->tap_max_ms * 1000) {
+            detect->tap_pending = 0;
+        }
+    }
+    if (detect->tap_pending && !detect->in_spike && now - detect->tap_start_us > config->double_tap_ms * 1000) {
+        detect->tap_pending = 0;
+        count = imu_detect_emit(events, count, IMU_EVENT_TAP, detect->tap_start_us, now, detect->tap_peak);
+    }
+    return count;
+}
+
+static size_t imu_detect_fall(imu_detect_t *detect, float magnitude, int64_t now, imu_event_t *events, size_t count) {
+    const imu_detect_config_t *config = &detect->config;
+
+    if (magnitude < config->freefall_g) {
+        if (!detect->in_fall) {
+            detect->in_fall = 1;
+            detect->fall_reported = 0;
+            detect->fall_start_us = now;
+        }
+        if (!detect->fall_reported && now - detect->fall_start_us >= config->freefall_ms * 1000) {
+            detect->fall_reported = 1;
+            count = imu_detect_emit(events, count, IMU_EVENT_FREE_FALL, detect->fall_start_us, now, (now - detect->fall_start_us) * 1e-3f);
+        }
+    } else if (magnitude > 2.0f * config->freefall_g) {
+        detect->in_fall = 0;
+    }
+    return count;
+}
+
+static size_t imu_detect_step(imu_detect_t *detect, float level, int64_t now, imu_event_t *events, size_t count) {
+    const imu_detect_config_t *config = &detect->config;
+
+    // The filtered level of a spike or a fall, and of the ringing after it, is no step
+    if (detect->in_spike || detect->in_fall || now < detect->spike_ignore_until_us) {
+        detect->step_armed = 0;
+        return count;
+    }
+    if (level > config->step_g) {
+        if (!detect->step_armed || level > detect->step_peak) {
+            detect->step_peak = level;
+            detect->step_peak_us = now;
+        }
+        detect->step_armed = 1;
+        return count;
+    }
+    // A peak is complete once the filtered level swings as far below the resting level; taps, jolts and
+    // anything else that only pushes one way never do
+    if (!detect->step_armed || level > -config->step_g) {
+        return count;
+    }
+    detect->step_armed = 0;
+
+    int64_t interval = detect->step_peak_us - detect->last_step_us;
+    if (interval < config->step_min_ms * 1000) {
+        return count;
+    }
+    if (interval > config->step_max_ms * 1000) {
+        detect->step_run = 0;
+    }
+    detect->last_step_us = detect->step_peak_us;
+    if (++detect->step_run < IMU_DETECT_STEP_RUN) {
+        return count;
+    }
+    // The peaks that opened the run count once it is one
+    detect->steps += (detect->step_run == IMU_DETECT_STEP_RUN) ? IMU_DETECT_STEP_RUN : 1;
+    detect->step_run = (detect->step_run > IMU_DETECT_STEP_RUN) ? IMU_DETECT_STEP_RUN + 1 : detect->step_run;
+    return imu_detect_emit(events, count, IMU_EVENT_STEP, detect->step_peak_us, now, (float)detect->steps);
+}
+
+size_t imu_detect_update(imu_detect_t *detect, const float *accel, int64_t timestamp_us, imu_event_t *events) {
+    float magnitude = sqrtf(accel[0] * accel[0] + accel[1] * accel[1] + accel[2] * accel[2]);
+    float dt = (detect->last_us == 0) ? 0.0f : (timestamp_us - detect->last_us) * 1e-6f;
+    detect->last_us = timestamp_us;
+    if (dt < 0.0f || dt > IMU_DETECT_MAX_DT_S) {
+        dt = 0.0f;
+        detect->step_filter = 0.0f;
+        detect->step_armed = 0;
+    }
+
+    float deviation = magnitude - detect->rest;
+    if (fabsf(deviation) < IMU_DETECT_REST_BAND_G) {
+        detect->rest += deviation * dt / (IMU_DETECT_REST_TAU_S + dt);
+    }
+    detect->step_filter += (deviation - detect->step_filter) * dt / (IMU_DETECT_STEP_TAU_S + dt);
+
+    size_t count = 0;
+    count = imu_detect_shock(detect, magnitude, timestamp_us, events, count);
+    count = imu_detect_tap(detect, magnitude, timestamp_us, events, count);
+    count = imu_detect_fall(detect, magnitude, timestamp_us, events, count);
+    count = imu_detect_step(detect, detect->step_filter, timestamp_us, events, count);
+    return count;
+}
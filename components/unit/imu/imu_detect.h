@@ -0,0 +1,101 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Event detection on the accelerometer stream: thresholds, peak detection and a small state machine per event.
+    Works on any rate from about 100 Hz up and, like imu_spectrum, has no FreeRTOS or IDF dependency, so recorded
+    streams can be replayed on the host, see tools/imu_events_replay.c.
+
+    - shock: |a| above shock_g, reported when it drops back, with the peak
+    - tap: a spike of |a| above the resting level by tap_g that is over within tap_max_ms and is no shock;
+      a second tap within double_tap_ms makes a double tap, otherwise the tap is reported once that window passed
+    - free fall: |a| below freefall_g for freefall_ms, reported right away so a drop can still be acted on
+    - step: a peak of the low passed |a| above step_g followed by a swing below -step_g, at least step_min_ms
+      after the previous one and outside taps, shocks and falls; a run of steps needs IMU_DETECT_STEP_RUN
+      peaks at most step_max_ms apart, so single bumps do not count
+*/
+
+#define IMU_DETECT_MAX_EVENTS 4
+#define IMU_DETECT_STEP_RUN 2
+
+typedef enum {
+    IMU_EVENT_TAP = 0,
+    IMU_EVENT_DOUBLE_TAP,
+    IMU_EVENT_SHOCK,
+    IMU_EVENT_FREE_FALL,
+    IMU_EVENT_STEP,
+    IMU_EVENT_TYPE_COUNT
+} imu_event_type_t;
+
+typedef struct {
+    imu_event_type_t type;
+    int64_t timestamp_us;       // start of what was detected
+    int64_t detected_us;        // sample that completed the detection, the latency is the difference
+    float value;                // tap and shock: peak g; free fall: ms; step: steps since init
+} imu_event_t;
+
+typedef struct {
+    float tap_g;
+    uint16_t tap_max_ms;
+    uint16_t tap_quiet_ms;      // ringing after a spike that is not a new one
+    uint16_t double_tap_ms;
+    float shock_g;
+    float freefall_g;
+    uint16_t freefall_ms;
+    float step_g;
+    uint16_t step_min_ms;
+    uint16_t step_max_ms;
+} imu_detect_config_t;
+
+typedef struct {
+    imu_detect_config_t config;
+    int64_t last_us;
+    float rest;                 // |a| at rest, tracks the accelerometer's scale error
+    float step_filter;
+    // tap
+    uint8_t in_spike;
+    uint8_t spike_shock;
+    int64_t spike_start_us;
+    float spike_peak;
+    int64_t spike_ignore_until_us;
+    uint8_t tap_pending;
+    int64_t tap_start_us;
+    float tap_peak;
+    // shock
+    uint8_t in_shock;
+    int64_t shock_start_us;
+    float shock_peak;
+    // free fall
+    uint8_t in_fall;
+    uint8_t fall_reported;
+    int64_t fall_start_us;
+    // steps
+    uint8_t step_armed;
+    float step_peak;
+    int64_t step_peak_us;
+    int64_t last_step_us;
+    uint8_t step_run;
+    uint32_t steps;
+} imu_detect_t;
+
+void imu_detect_default_config(imu_detect_config_t *config);
+
+void imu_detect_init(imu_detect_t *detect, const imu_detect_config_t *config);
+
+/*
+    One accelerometer sample in g.
+    return the number of events written to events, which holds IMU_DETECT_MAX_EVENTS
+*/
+size_t imu_detect_update(imu_detect_t *detect, const float *accel, int64_t timestamp_us, imu_event_t *events);
+
+const char *imu_detect_event_name(imu_event_type_t type);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,86 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "imu_sampler.h"
+#include "imu_events.h"
+
+static imu_detect_t events_detect;
+static QueueHandle_t events_queue;
+static volatile uint32_t events_steps;
+static portMUX_TYPE events_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static imu_events_stats_t events_stats;
+
+static void imu_events_on_sample(const imu_sample_t *sample, void *arg) {
+    imu_event_t events[IMU_DETECT_MAX_EVENTS];
+    mpu6886_sample_t scaled;
+    MPU6886_ScaleSamples(&sample->raw, 1, &scaled);
+
+    int64_t start = esp_timer_get_time();
+    size_t count = imu_detect_update(&events_detect, scaled.accel, sample->timestamp_us, events);
+    uint32_t elapsed = (uint32_t)(esp_timer_get_time() - start);
+
+    uint32_t dropped = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (events[i].type == IMU_EVENT_STEP) {
+            events_steps = (uint32_t)events[i].value;
+        } else if (xQueueSend(events_queue, &events[i], 0) != pdTRUE) {
+            dropped++;
+        }
+    }
+
+    portENTER_CRITICAL(&events_stats_lock);
+    events_stats.samples++;
+    events_stats.events += count;
+    events_stats.dropped += dropped;
+    events_stats.cpu_us_total += elapsed;
+    events_stats.cpu_us_max = (elapsed > events_stats.cpu_us_max) ? elapsed : events_stats.cpu_us_max;
+    portEXIT_CRITICAL(&events_stats_lock);
+}
+
+esp_err_t imu_events_start(const imu_detect_config_t *config) {
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (events_queue != NULL) {
+        return ESP_OK;
+    }
+    if (!imu_sampler_running()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    events_queue = xQueueCreate(IMU_EVENTS_QUEUE_LENGTH, sizeof(imu_event_t));
+    if (events_queue == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    imu_detect_init(&events_detect, config);
+    esp_err_t err = imu_sampler_subscribe(imu_events_on_sample, NULL);
+    if (err != ESP_OK) {
+        vQueueDelete(events_queue);
+        events_queue = NULL;
+    }
+    return err;
+}
+
+uint8_t imu_events_running(void) {
+    return events_queue != NULL;
+}
+
+esp_err_t imu_events_receive(imu_event_t *event) {
+    if (events_queue == NULL || xQueueReceive(events_queue, event, 0) != pdTRUE) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return ESP_OK;
+}
+
+uint32_t imu_events_steps(void) {
+    return events_steps;
+}
+
+void imu_events_get_stats(imu_events_stats_t *stats) {
+    portENTER_CRITICAL(&events_stats_lock);
+    *stats = events_stats;
+    portEXIT_CRITICAL(&events_stats_lock);
+}
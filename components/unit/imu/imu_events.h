@@ -0,0 +1,44 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+
+#include "imu_detect.h"
+
+/*
+    Accelerometer events of the IMU sampler's stream, see imu_detect.h for the detection.
+
+    The detector runs on every sample on the sampling task. Taps, shocks and free falls are queued for the
+    application, IMU_EVENTS_QUEUE_LENGTH deep; steps only add to a counter, they come too often to queue.
+    The time the detector takes per sample is measured, so its cost can be read off a running device.
+*/
+
+#define IMU_EVENTS_QUEUE_LENGTH 16
+
+typedef struct {
+    uint32_t samples;
+    uint32_t events;
+    uint32_t dropped;           // the queue was full
+    uint64_t cpu_us_total;      // in imu_detect_update
+    uint32_t cpu_us_max;
+} imu_events_stats_t;
+
+// Detect events on the samples of the IMU sampler, which has to be running
+esp_err_t imu_events_start(const imu_detect_config_t *config);
+
+uint8_t imu_events_running(void);
+
+// Oldest queued event without waiting; ESP_ERR_NOT_FOUND when there is none
+esp_err_t imu_events_receive(imu_event_t *event);
+
+// Steps since the start
+uint32_t imu_events_steps(void);
+
+void imu_events_get_stats(imu_events_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,180 @@
+#include <math.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_err.h"
+
+#include "imu_sampler.h"
+#include "imu_fusion.h"
+
+#define IMU_FUSION_DEG_TO_RAD 0.0174532925f
+#define IMU_FUSION_RAD_TO_DEG 57.2957795f
+
+// Gaps longer than this (a paused sampler, lost samples) are not integrated
+#define IMU_FUSION_MAX_DT 0.1f
+
+static imu_fusion_t fusion_state;
+static uint8_t fusion_running;
+static portMUX_TYPE fusion_lock = portMUX_INITIALIZER_UNLOCKED;
+static imu_attitude_t fusion_attitude;
+static int64_t fusion_last_us;
+
+void imu_fusion_default_config(imu_fusion_config_t *config) {
+    config->kp = 1.0f;
+    config->ki = 0.02f;
+    config->accel_gate_g = 0.15f;
+}
+
+void imu_fusion_init(imu_fusion_t *fusion, const imu_fusion_config_t *config) {
+    memset(fusion, 0, sizeof(*fusion));
+    fusion->config = *config;
+    fusion->q.w = 1.0f;
+}
+
+// Attitude with zero yaw whose gravity direction matches the normalized accel
+static void imu_fusion_align(imu_fusion_t *fusion, float ax, float ay, float az) {
+    float roll = atan2f(ay, az);
+    float pitch = atan2f(-ax, sqrtf(ay * ay + az * az));
+    float cr = cosf(roll * 0.5f), sr = sinf(roll * 0.5f);
+    float cp = cosf(pitch * 0.5f), sp = sinf(pitch * 0.5f);
+
+    fusion->q.w = cr * cp;
+    fusion->q.x = sr * cp;
+    fusion->q.y = cr * sp;
+    fusion->q.z = -sr * sp;
+    fusion->initialized = 1;
+}
+
+void imu_fusion_update(imu_fusion_t *fusion, const float *accel, const float *gyro, float dt) {
+    float gx = gyro[0] * IMU_FUSION_DEG_TO_RAD;
+    float gy = gyro[1] * IMU_FUSION_DEG_TO_RAD;
+    float gz = gyro[2] * IMU_FUSION_DEG_TO_RAD;
+    float ax = accel[0], ay = accel[1], az = accel[2];
+    float norm = sqrtf(ax * ax + ay * ay + az * az);
+    imu_quaternion_t q = fusion->q;
+
+    if (norm > 0.0f && fabsf(norm - 1.0f) <= fusion->config.accel_gate_g) {
+        float recip = 1.0f / norm;
+        ax *= recip;
+        ay *= recip;
+        az *= recip;
+
+        if (!fusion->initialized) {
+            imu_fusion_align(fusion, ax, ay, az);
+            return;
+        }
+
+        // Half the gravity direction the attitude predicts, and its error against the measured one
+        float vx = q.x * q.z - q.w * q.y;
+        float vy = q.w * q.x + q.y * q.z;
+        float vz = q.w * q.w - 0.5f + q.z * q.z;
+        float ex = ay * vz - az * vy;
+        float ey = az * vx - ax * vz;
+        float ez = ax * vy - ay * vx;
+
+        if (fusion->config.ki > 0.0f) {
+            fusion->integral[0] += 2.0f * fusion->config.ki * ex * dt;
+            fusion->integral[1] += 2.0f * fusion->config.ki * ey * dt;
+            fusion->integral[2] += 2.0f * fusion->config.ki * ez * dt;
+            gx += fusion->integral[0];
+            gy += fusion->integral[1];
+            gz += fusion->integral[2];
+        }
+
+        gx += 2.0f * fusion->config.kp * ex;
+        gy += 2.0f * fusion->config.kp * ey;
+        gz += 2.0f * fusion->config.kp * ez;
+    } else if (fusion->initialized) {
+        gx += fusion->integral[0];
+        gy += fusion->integral[1];
+        gz += fusion->integral[2];
+    } else {
+        return;
+    }
+
+    gx *= 0.5f * dt;
+    gy *= 0.5f * dt;
+    gz *= 0.5f * dt;
+    fusion->q.w = q.w - q.x * gx - q.y * gy - q.z * gz;
+    fusion->q.x = q.x + q.w * gx + q.y * gz - q.z * gy;
+    fusion->q.y = q.y + q.w * gy - q.x * gz + q.z * gx;
+    fusion->q.z = q.z + q.w * gz + q.x * gy - q.y * gx;
+
+    float recip = 1.0f / sqrtf(fusion->q.w * fusion->q.w + fusion->q.x * fusion->q.x + fusion->q.y * fusion->q.y + fusion->q.z * fusion->q.z);
+    fusion->q.w *= recip;
+    fusion->q.x *= recip;
+    fusion->q.y *= recip;
+    fusion->q.z *= recip;
+}
+
+void imu_fusion_get(const imu_fusion_t *fusion, imu_attitude_t *attitude) {
+    imu_quaternion_t q = fusion->q;
+    float sinp = -2.0f * (q.x * q.z - q.w * q.y);
+    sinp = (sinp > 1.0f) ? 1.0f : ((sinp < -1.0f) ? -1.0f : sinp);
+
+    attitude->q = q;
+    attitude->roll = atan2f(q.w * q.x + q.y * q.z, 0.5f - q.x * q.x - q.y * q.y) * IMU_FUSION_RAD_TO_DEG;
+    attitude->pitch = asinf(sinp) * IMU_FUSION_RAD_TO_DEG;
+    attitude->yaw = atan2f(q.x * q.y + q.w * q.z, 0.5f - q.y * q.y - q.z * q.z) * IMU_FUSION_RAD_TO_DEG;
+    for (int i = 0; i < 3; i++) {
+        attitude->gyro_bias[i] = -fusion->integral[i] * IMU_FUSION_RAD_TO_DEG;
+    }
+}
+
+static void imu_fusion_on_sample(const imu_sample_t *sample, void *arg) {
+    mpu6886_sample_t scaled;
+    MPU6886_ScaleSamples(&sample->raw, 1, &scaled);
+
+    float dt = (fusion_last_us == 0) ? 0.0f : (float)(sample->timestamp_us - fusion_last_us) * 1e-6f;
+    fusion_last_us = sample->timestamp_us;
+    if (dt < 0.0f || dt > IMU_FUSION_MAX_DT) {
+        dt = 0.0f;
+    }
+    imu_fusion_update(&fusion_state, scaled.accel, scaled.gyro, dt);
+    if (!fusion_state.initialized) {
+        return;
+    }
+
+    // The Euler angles are derived here, once per sample, so readers only copy
+    imu_attitude_t attitude;
+    imu_fusion_get(&fusion_state, &attitude);
+    attitude.timestamp_us = sample->timestamp_us;
+
+    portENTER_CRITICAL(&fusion_lock);
+    attitude.updates = fusion_attitude.updates + 1;
+    fusion_attitude = attitude;
+    portEXIT_CRITICAL(&fusion_lock);
+}
+
+esp_err_t imu_fusion_start(const imu_fusion_config_t *config) {
+    if (config == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (fusion_running) {
+        return ESP_OK;
+    }
+    if (!imu_sampler_running()) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    imu_fusion_init(&fusion_state, config);
+    esp_err_t err = imu_sampler_subscribe(imu_fusion_on_sample, NULL);
+    fusion_running = (err == ESP_OK);
+    return err;
+}
+
+uint8_t imu_fusion_running(void) {
+    return fusion_running;
+}
+
+void imu_fusion_reset_bias(void) {
+    memset(fusion_state.integral, 0, sizeof(fusion_state.integral));
+}
+
+esp_err_t imu_fusion_get_attitude(imu_attitude_t *attitude) {
+    portENTER_CRITICAL(&fusion_lock);
+    *attitude = fusion_attitude;
+    portEXIT_CRITICAL(&fusion_lock);
+    return (attitude->updates == 0) ? ESP_ERR_INVALID_STATE : ESP_OK;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+
+#include "mpu6886.h"
+
+/*
+    Orientation fusion, a Mahony complementary filter in single precision (the ESP32 FPU has no doubles).
+
+    The gyro is integrated into a quaternion; the proportional term pulls the attitude towards the gravity
+    direction measured by the accelerometer and the integral term converges on the gyro bias, which is reported.
+    Samples whose acceleration is not close to 1 g are integrated without correction, so shocks and linear
+    motion do not tilt the estimate. Without a magnetometer yaw is relative to the start and drifts slowly.
+
+    imu_fusion_start subscribes to the IMU sampler, so the filter runs on every sample at the sensor's rate.
+*/
+
+typedef struct {
+    float w, x, y, z;
+} imu_quaternion_t;
+
+typedef struct {
+    imu_quaternion_t q;         // sensor frame to world frame
+    float roll, pitch, yaw;     // degrees
+    float gyro_bias[3];         // dps
+    uint32_t updates;
+    int64_t timestamp_us;       // sample the attitude is valid for
+} imu_attitude_t;
+
+typedef struct {
+    float kp;                   // accelerometer correction gain, 1/s
+    float ki;                   // gyro bias tracking gain, 1/s^2, 0 disables tracking
+    float accel_gate_g;         // corrections are skipped when | |a| - 1 g | exceeds this
+} imu_fusion_config_t;
+
+// Filter state, for running the filter on recorded data; imu_fusion_start keeps its own
+typedef struct {
+    imu_fusion_config_t config;
+    imu_quaternion_t q;
+    float integral[3];          // rad/s, the negated gyro bias
+    uint8_t initialized;
+} imu_fusion_t;
+
+void imu_fusion_default_config(imu_fusion_config_t *config);
+
+void imu_fusion_init(imu_fusion_t *fusion, const imu_fusion_config_t *config);
+
+/*
+    One filter step; accel in g, gyro in dps, dt in seconds.
+    The first sample with a valid acceleration sets roll and pitch directly instead of converging on them.
+*/
+void imu_fusion_update(imu_fusion_t *fusion, const float *accel, const float *gyro, float dt);
+
+void imu_fusion_get(const imu_fusion_t *fusion, imu_attitude_t *attitude);
+
+// Run the filter on every sample of the IMU sampler
+esp_err_t imu_fusion_start(const imu_fusion_config_t *config);
+
+uint8_t imu_fusion_running(void);
+
+// Forget the tracked gyro bias, e.g. once a calibration removes it before the filter; call while the sampler is paused
+void imu_fusion_reset_bias(void);
+
+// Latest attitude; ESP_ERR_INVALID_STATE until the filter has seen a sample
+esp_err_t imu_fusion_get_attitude(imu_attitude_t *attitude);
+
+#ifdef __cplusplus
+}
+#endif
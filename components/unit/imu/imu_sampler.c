@@ -0,0 +1,382 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_err.h"
+#include "esp_timer.h"
+#include "driver/gpio.h"
+
+#include "mpu6886.h"
+#include "imu_sampler.h"
+
+#define TAG "IMU-SAMPLER"
+
+// The subscribers' callbacks run on this stack: fusion, event detection, capture and their logging
+#define IMU_SAMPLER_STACK_SIZE (4096)
+
+typedef struct {
+    imu_sampler_callback_t callback;
+    void *arg;
+} imu_sampler_subscriber_t;
+
+static TaskHandle_t sampler_task;
+static gpio_num_t sampler_gpio = GPIO_NUM_NC;
+static uint32_t sampler_period_us;
+static esp_timer_handle_t sampler_poll_timer;
+static int64_t sampler_polled_us;           // the poll that found the previous sample, 0 after a gap
+static volatile uint8_t sampler_poll_restart;
+static volatile int64_t sampler_edge_us;
+static volatile uint8_t sampler_paused;
+// Held by the task while it talks to the sensor, so imu_sampler_pause can wait for it to finish
+static SemaphoreHandle_t sampler_busy;
+static volatile uint8_t sampler_sleeping;
+static portMUX_TYPE sampler_sleep_lock = portMUX_INITIALIZER_UNLOCKED;
+static volatile uint8_t sampler_sleep_requested;
+static uint16_t sampler_sleep_threshold_mg;
+static uint16_t sampler_sleep_odr_hz;
+static uint32_t sampler_sequence;
+static imu_sampler_stats_t sampler_stats;
+
+static imu_sampler_subscriber_t sampler_subscribers[IMU_SAMPLER_MAX_SUBSCRIBERS];
+static volatile uint8_t sampler_subscriber_count;
+
+// Running sums for imu_sampler_get_average, shared with the caller's task
+static portMUX_TYPE sampler_average_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t sampler_accel_sum[3];
+static int64_t sampler_temp_sum;
+static int64_t sampler_gyro_sum[3];
+static uint32_t sampler_average_count;
+
+static void IRAM_ATTR imu_sampler_isr(void *arg) {
+    BaseType_t woken = pdFALSE;
+    sampler_edge_us = esp_timer_get_time();
+    vTaskNotifyGiveFromISR(sampler_task, &woken);
+    if (woken == pdTRUE) {
+        portYIELD_FROM_ISR();
+    }
+}
+
+// Polls without interrupt line come from a timer: tick based delays cannot poll faster than the tick rate
+static void imu_sampler_poll_timer(void *arg) {
+    if (!sampler_paused && !sampler_sleeping) {
+        xTaskNotifyGive(sampler_task);
+    }
+}
+
+static void imu_sampler_deliver(imu_sample_t *sample) {
+    sample->sequence = sampler_sequence++;
+    sampler_stats.samples++;
+
+    portENTER_CRITICAL(&sampler_average_lock);
+    for (int i = 0; i < 3; i++) {
+        sampler_accel_sum[i] += sample->raw.accel[i];
+        sampler_gyro_sum[i] += sample->raw.gyro[i];
+    }
+    sampler_temp_sum += sample->raw.temp;
+    sampler_average_count++;
+    portEXIT_CRITICAL(&sampler_average_lock);
+
+    uint8_t count = sampler_subscriber_count;
+    for (uint8_t i = 0; i < count; i++) {
+        sampler_subscribers[i].callback(sample, sampler_subscribers[i].arg);
+    }
+
+    // Entering wake on motion writes several registers, which the callbacks must not wait for
+    if (sampler_sleep_requested) {
+        sampler_sleep_requested = 0;
+        esp_err_t err = imu_sampler_sleep(sampler_sleep_threshold_mg, sampler_sleep_odr_hz);
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "Wake on motion failed (%s), sampling on", esp_err_to_name(err));
+            sampler_stats.errors++;
+        }
+    }
+}
+
+static void imu_sampler_read(int64_t timestamp_us) {
+    imu_sample_t sample;
+    esp_err_t err = MPU6886_ReadNewSample(&sample.raw);
+    if (err == ESP_OK) {
+        sample.timestamp_us = timestamp_us;
+        imu_sampler_deliver(&sample);
+    } else if (err != ESP_ERR_NOT_FOUND) {
+        sampler_stats.errors++;
+    }
+}
+
+// The latch keeps only the latest sample: periods since the previous one beyond the first were overwritten
+static void imu_sampler_poll(void) {
+    int64_t now = esp_timer_get_time();
+    imu_sample_t sample;
+    esp_err_t err = MPU6886_ReadNewSample(&sample.raw);
+    if (err != ESP_OK) {
+        sampler_stats.errors += (err != ESP_ERR_NOT_FOUND);
+        return;
+    }
+
+    if (sampler_poll_restart) {
+        // A pause or sleep is a gap, not lost samples
+        sampler_poll_restart = 0;
+        sampler_polled_us = 0;
+    }
+    if (sampler_polled_us != 0) {
+        uint32_t periods = (uint32_t)((now - sampler_polled_us + sampler_period_us / 2) / sampler_period_us);
+        sampler_stats.missed += (periods > 1) ? periods - 1 : 0;
+    }
+    sampler_polled_us = now;
+    sample.timestamp_us = now;
+    imu_sampler_deliver(&sample);
+}
+
+// One wait of the sleeping task; reading INT_STATUS also re-arms a latch whose edge was lost
+static void imu_sampler_wait_motion(void) {
+    TickType_t wait = pdMS_TO_TICKS(IMU_SAMPLER_SLEEP_POLL_MS);
+    ulTaskNotifyTake(pdTRUE, (sampler_gpio == GPIO_NUM_NC) ? wait : wait * IMU_SAMPLER_TIMEOUT_PERIODS);
+    xSemaphoreTake(sampler_busy, portMAX_DELAY);
+    if (sampler_sleeping && !sampler_paused && MPU6886_IsMotionDetected()) {
+        sampler_stats.wakeups++;
+        imu_sampler_wake();
+    }
+    xSemaphoreGive(sampler_busy);
+}
+
+static void imu_sampler_task(void *arg) {
+    TickType_t period = pdMS_TO_TICKS(sampler_period_us / 1000);
+    period = (period == 0) ? 1 : period;
+
+    for (;;) {
+        if (sampler_sleeping) {
+            imu_sampler_wait_motion();
+            continue;
+        }
+
+        uint32_t edges = ulTaskNotifyTake(pdTRUE, period * IMU_SAMPLER_TIMEOUT_PERIODS);
+        // paused is checked under the lock: once imu_sampler_pause got the lock, no read or sleep entry follows
+        xSemaphoreTake(sampler_busy, portMAX_DELAY);
+        if (sampler_paused) {
+            xSemaphoreGive(sampler_busy);
+            continue;
+        }
+        if (sampler_gpio == GPIO_NUM_NC) {
+            imu_sampler_poll();
+        } else if (edges == 0) {
+            // A latch that stayed high since a lost edge raises no new one until INT_STATUS is read
+            sampler_stats.timeouts++;
+            imu_sampler_read(esp_timer_get_time());
+        } else {
+            sampler_stats.missed += edges - 1;
+            imu_sampler_read(sampler_edge_us);
+        }
+        xSemaphoreGive(sampler_busy);
+    }
+}
+
+void imu_sampler_default_config(imu_sampler_config_t *config) {
+    config->int_gpio = IMU_SAMPLER_INT_GPIO;
+    config->odr_hz = 100;
+    config->priority = 7;
+}
+
+esp_err_t imu_sampler_start(const imu_sampler_config_t *config) {
+    if (config == NULL || config->odr_hz == 0 || config->odr_hz > 1000) {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (sampler_task != NULL) {
+        return ESP_OK;
+    }
+
+    uint16_t divider = (1000 + config->odr_hz / 2) / config->odr_hz - 1;
+    if (divider > 0xFF) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    MPU6886_SetSampleRateDivider((uint8_t)divider);
+    sampler_period_us = 1000 * (1 + divider);
+    sampler_gpio = config->int_gpio;
+
+    sampler_busy = xSemaphoreCreateMutex();
+    if (sampler_busy == NULL) {
+        return ESP_ERR_NO_MEM;
+    }
+    if (xTaskCreate(imu_sampler_task, "imu_sampler", IMU_SAMPLER_STACK_SIZE, NULL, config->priority, &sampler_task) != pdPASS) {
+        vSemaphoreDelete(sampler_busy);
+        sampler_busy = NULL;
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (sampler_gpio != GPIO_NUM_NC) {
+        // INT is push-pull and active high, see INT_PIN_CFG in MPU6886_Init
+        gpio_config_t io_conf;
+        io_conf.intr_type = GPIO_INTR_POSEDGE;
+        io_conf.mode = GPIO_MODE_INPUT;
+        io_conf.pin_bit_mask = 1ULL << sampler_gpio;
+        io_conf.pull_down_en = GPIO_PULLDOWN_DISABLE;
+        io_conf.pull_up_en = GPIO_PULLUP_DISABLE;
+        esp_err_t err = gpio_config(&io_conf);
+        if (err == ESP_OK) {
+            // Already installed by another driver is fine
+            err = gpio_install_isr_service(0);
+            err = (err == ESP_ERR_INVALID_STATE) ? ESP_OK : err;
+        }
+        if (err == ESP_OK) {
+            err = gpio_isr_handler_add(sampler_gpio, imu_sampler_isr, NULL);
+        }
+        if (err != ESP_OK) {
+            ESP_LOGW(TAG, "No interrupt on GPIO %d (%s), polling", sampler_gpio, esp_err_to_name(err));
+            sampler_gpio = GPIO_NUM_NC;
+        }
+        // Read the sample that may have latched INT before the edge could be seen
+        xTaskNotifyGive(sampler_task);
+    }
+    if (sampler_gpio == GPIO_NUM_NC) {
+        // Twice per sample period, so each sample is seen before the next one overwrites it
+        esp_timer_create_args_t timer_args = {
+            .callback = imu_sampler_poll_timer,
+            .arg = NULL,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name = "imu_poll",
+        };
+        esp_err_t err = esp_timer_create(&timer_args, &sampler_poll_timer);
+        if (err == ESP_OK) {
+            err = esp_timer_start_periodic(sampler_poll_timer, sampler_period_us / 2);
+        }
+        if (err != ESP_OK) {
+            // The task still polls once per IMU_SAMPLER_TIMEOUT_PERIODS, the stats count the lost samples
+            ESP_LOGW(TAG, "No poll timer (%s), samples will be lost", esp_err_to_name(err));
+        }
+    }
+
+    ESP_LOGI(TAG, "Sampling at %u Hz, %s", (unsigned)(1000000 / sampler_period_us), (sampler_gpio == GPIO_NUM_NC) ? "polled" : "interrupt driven");
+    return ESP_OK;
+}
+
+uint8_t imu_sampler_running(void) {
+    return sampler_task != NULL;
+}
+
+uint16_t imu_sampler_rate_hz(void) {
+    return (sampler_task == NULL) ? 0 : (uint16_t)(1000000 / sampler_period_us);
+}
+
+void imu_sampler_pause(void) {
+    sampler_paused = 1;
+    if (sampler_task != NULL) {
+        // Wait for the read or wake on motion entry the task may be in the middle of
+        xSemaphoreTake(sampler_busy, portMAX_DELAY);
+        xSemaphoreGive(sampler_busy);
+    }
+    // Whoever takes the sensor over expects it at full power
+    imu_sampler_wake();
+}
+
+void imu_sampler_resume(void) {
+    sampler_poll_restart = 1;
+    sampler_paused = 0;
+    if (sampler_task != NULL) {
+        // The latch is still high from the last sample seen while paused
+        xTaskNotifyGive(sampler_task);
+    }
+}
+
+esp_err_t imu_sampler_sleep(uint16_t threshold_mg, uint16_t odr_hz) {
+    if (sampler_task == NULL || sampler_paused) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sampler_sleeping) {
+        return ESP_OK;
+    }
+
+    // Set first, so the task does not count the data ready interrupts that stop as timeouts
+    sampler_sleeping = 1;
+    esp_err_t err = MPU6886_WakeOnMotionStart(threshold_mg, odr_hz);
+    if (err != ESP_OK) {
+        sampler_sleeping = 0;
+        return err;
+    }
+    // Start waiting with the new timeout
+    xTaskNotifyGive(sampler_task);
+    return ESP_OK;
+}
+
+esp_err_t imu_sampler_request_sleep(uint16_t threshold_mg, uint16_t odr_hz) {
+    if (sampler_task == NULL || sampler_paused) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    sampler_sleep_threshold_mg = threshold_mg;
+    sampler_sleep_odr_hz = odr_hz;
+    sampler_sleep_requested = 1;
+    return ESP_OK;
+}
+
+void imu_sampler_wake(void) {
+    sampler_sleep_requested = 0;
+
+    // Motion seen by the task and a caller on another task may both wake the sampler, only one restores the sensor
+    portENTER_CRITICAL(&sampler_sleep_lock);
+    uint8_t sleeping = sampler_sleeping;
+    sampler_sleeping = 0;
+    portEXIT_CRITICAL(&sampler_sleep_lock);
+    if (!sleeping) {
+        return;
+    }
+
+    if (MPU6886_WakeOnMotionStop() != ESP_OK) {
+        sampler_stats.errors++;
+    }
+    sampler_poll_restart = 1;
+    // Data ready is enabled again, read the first sample without waiting for its edge
+    xTaskNotifyGive(sampler_task);
+}
+
+uint8_t imu_sampler_sleeping(void) {
+    return sampler_sleeping;
+}
+
+esp_err_t imu_sampler_subscribe(imu_sampler_callback_t callback, void *arg) {
+    if (callback == NULL) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (sampler_subscriber_count == IMU_SAMPLER_MAX_SUBSCRIBERS) {
+        return ESP_ERR_NO_MEM;
+    }
+    sampler_subscribers[sampler_subscriber_count].callback = callback;
+    sampler_subscribers[sampler_subscriber_count].arg = arg;
+    // The task only looks at entries below the count
+    sampler_subscriber_count++;
+    return ESP_OK;
+}
+
+uint32_t imu_sampler_get_average(mpu6886_sample_t *mean) {
+    int64_t accel_sum[3], gyro_sum[3], temp_sum;
+    uint32_t count;
+
+    portENTER_CRITICAL(&sampler_average_lock);
+    for (int i = 0; i < 3; i++) {
+        accel_sum[i] = sampler_accel_sum[i];
+        gyro_sum[i] = sampler_gyro_sum[i];
+        sampler_accel_sum[i] = 0;
+        sampler_gyro_sum[i] = 0;
+    }
+    temp_sum = sampler_temp_sum;
+    sampler_temp_sum = 0;
+    count = sampler_average_count;
+    sampler_average_count = 0;
+    portEXIT_CRITICAL(&sampler_average_lock);
+
+    if (count == 0) {
+        return 0;
+    }
+
+    // Scale the mean like a raw sample; fractions of an LSB survive in the floats
+    float accel[3], gyro[3];
+    for (int i = 0; i < 3; i++) {
+        accel[i] = (float)accel_sum[i] / count;
+        gyro[i] = (float)gyro_sum[i] / count;
+    }
+    MPU6886_ScaleCounts(accel, (float)temp_sum / count, gyro, mean);
+    return count;
+}
+
+void imu_sampler_get_stats(imu_sampler_stats_t *stats) {
+    *stats = sampler_stats;
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "driver/gpio.h"
+#include "esp_err.h"
+
+#include "mpu6886.h"
+
+/*
+    Data ready driven IMU sampling.
+
+    MPU6886_Init latches the INT pin high for every new sample until INT_STATUS is read. A GPIO interrupt on that
+    line timestamps the edge and wakes the sampling task, which reads INT_STATUS and the sample in one 15 byte
+    burst and hands the sample to the subscribers, so each sample is read exactly once, when it is produced.
+
+    Without an interrupt line (int_gpio = GPIO_NUM_NC, e.g. on the simulated bus) an esp_timer wakes the task
+    twice per sample period, independent of the FreeRTOS tick rate, and it delivers a sample only when INT_STATUS
+    reports a new one. The timestamp is that of the poll, up to half a period late; samples that a newer one
+    overwrote before a poll came are counted as missed.
+
+    imu_sampler_sleep hands the sensor to its wake on motion mode: no samples are delivered, and the task only
+    waits for the motion interrupt, or polls INT_STATUS every IMU_SAMPLER_SLEEP_POLL_MS without interrupt line.
+    Motion, imu_sampler_wake or imu_sampler_pause bring the sensor back to full power sampling. Subscribers
+    use imu_sampler_request_sleep instead, the task goes to sleep once the callbacks of the sample returned.
+*/
+
+// GPIO wired to the MPU6886 INT pin, GPIO_NUM_NC if it is not routed to the ESP32
+#ifndef IMU_SAMPLER_INT_GPIO
+#define IMU_SAMPLER_INT_GPIO GPIO_NUM_NC
+#endif
+
+#define IMU_SAMPLER_MAX_SUBSCRIBERS 4
+
+// Sample periods without an interrupt before the task reads anyway, which also re-arms a latch whose edge was lost
+#define IMU_SAMPLER_TIMEOUT_PERIODS 10
+
+#define IMU_SAMPLER_SLEEP_POLL_MS 100
+
+typedef struct {
+    mpu6886_raw_sample_t raw;
+    int64_t timestamp_us;       // data ready edge, or the wake up that found the sample without interrupt line
+    uint32_t sequence;
+} imu_sample_t;
+
+// Runs on the sampling task and must not block, so no I2C transfers
+typedef void (*imu_sampler_callback_t)(const imu_sample_t *sample, void *arg);
+
+typedef struct {
+    gpio_num_t int_gpio;
+    uint16_t odr_hz;            // rounded to 1 kHz / (1 + SMPLRT_DIV)
+    UBaseType_t priority;
+} imu_sampler_config_t;
+
+typedef struct {
+    uint32_t samples;
+    uint32_t missed;            // samples overwritten before they were read: extra edges, or polled periods without a sample
+    uint32_t timeouts;
+    uint32_t errors;
+    uint32_t wakeups;           // sleeps ended by motion
+} imu_sampler_stats_t;
+
+void imu_sampler_default_config(imu_sampler_config_t *config);
+
+/*
+    Set the sample rate and start the sampling task; call after MPU6886_Init succeeded
+*/
+esp_err_t imu_sampler_start(const imu_sampler_config_t *config);
+
+uint8_t imu_sampler_running(void);
+
+// Sample rate after rounding, 0 while not running
+uint16_t imu_sampler_rate_hz(void);
+
+/*
+    Stop reading samples while someone else owns the sensor, e.g. a FIFO capture at a different rate.
+    Blocks until the task finished the read or wake on motion entry it is in, and leaves the sensor awake;
+    call from another task than the sampler's, not from a subscriber callback.
+*/
+void imu_sampler_pause(void);
+void imu_sampler_resume(void);
+
+/*
+    Stop sampling until an axis changes by more than threshold_mg, see MPU6886_WakeOnMotionStart;
+    ESP_ERR_INVALID_STATE if the sampler is not running
+*/
+esp_err_t imu_sampler_sleep(uint16_t threshold_mg, uint16_t odr_hz);
+
+/*
+    imu_sampler_sleep from a subscriber: the task enters the wake on motion mode after the callbacks of the current
+    sample returned. A failure is logged and counted in the stats errors, and samples keep coming;
+    imu_sampler_wake and imu_sampler_pause cancel a pending request.
+*/
+esp_err_t imu_sampler_request_sleep(uint16_t threshold_mg, uint16_t odr_hz);
+
+// Leave the wake on motion mode and sample again, a no-op when awake
+void imu_sampler_wake(void);
+
+uint8_t imu_sampler_sleeping(void);
+
+// ESP_ERR_NO_MEM once IMU_SAMPLER_MAX_SUBSCRIBERS are registered
+esp_err_t imu_sampler_subscribe(imu_sampler_callback_t callback, void *arg);
+
+/*
+    Mean of the samples since the previous call, for consumers far slower than the sample rate;
+    averaging instead of picking one sample keeps vibration from aliasing into the result.
+    return the number of samples averaged, 0 leaves mean untouched
+*/
+uint32_t imu_sampler_get_average(mpu6886_sample_t *mean);
+
+void imu_sampler_get_stats(imu_sampler_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,183 @@
+#include <math.h>
+#include <string.h>
+
+#if defined(__has_include)
+#if __has_include("dsps_fft2r.h")
+#include "dsps_fft2r.h"
+#define IMU_SPECTRUM_ESP_DSP 1
+#endif
+#endif
+
+#include "imu_spectrum.h"
+
+#define IMU_SPECTRUM_HALF (IMU_SPECTRUM_SIZE / 2)
+#define IMU_SPECTRUM_BAND_BINS (IMU_SPECTRUM_HALF / IMU_SPECTRUM_BANDS)
+#define IMU_SPECTRUM_PI 3.14159265f
+
+#if (IMU_SPECTRUM_SIZE & (IMU_SPECTRUM_SIZE - 1)) || IMU_SPECTRUM_HALF % IMU_SPECTRUM_BANDS
+#error "IMU_SPECTRUM_SIZE must be a power of two with IMU_SPECTRUM_BANDS dividing its half"
+#endif
+
+// cos and sin of 2 pi k / N, for the split of the half size FFT into the real one
+static float split_cos[IMU_SPECTRUM_HALF];
+static float split_sin[IMU_SPECTRUM_HALF];
+// Twiddles of the half size FFT, the stage with m point halves at [m, 2m), so the butterflies read them in order
+static float stage_cos[IMU_SPECTRUM_HALF];
+static float stage_sin[IMU_SPECTRUM_HALF];
+static uint16_t bit_reverse[IMU_SPECTRUM_HALF];
+static float window[IMU_SPECTRUM_SIZE];
+static float window_power;
+static float fft_re[IMU_SPECTRUM_HALF];
+static float fft_im[IMU_SPECTRUM_HALF];
+static uint8_t spectrum_ready;
+#ifdef IMU_SPECTRUM_ESP_DSP
+static float dsp_data[IMU_SPECTRUM_SIZE];
+static uint8_t dsp_ready;
+#endif
+
+void imu_spectrum_init(void) {
+    if (spectrum_ready) {
+        return;
+    }
+
+    for (int k = 0; k < IMU_SPECTRUM_HALF; k++) {
+        float angle = 2.0f * IMU_SPECTRUM_PI * k / IMU_SPECTRUM_SIZE;
+        split_cos[k] = cosf(angle);
+        split_sin[k] = sinf(angle);
+    }
+    for (int m = 1; m < IMU_SPECTRUM_HALF; m <<= 1) {
+        for (int k = 0; k < m; k++) {
+            // 2 pi k / 2m of the stage is 2 pi (k * N / 2m) / N of the split table
+            stage_cos[m + k] = split_cos[k * (IMU_SPECTRUM_HALF / m)];
+            stage_sin[m + k] = split_sin[k * (IMU_SPECTRUM_HALF / m)];
+        }
+    }
+
+    int bits = 0;
+    while ((1 << bits) < IMU_SPECTRUM_HALF) {
+        bits++;
+    }
+    for (int i = 0; i < IMU_SPECTRUM_HALF; i++) {
+        uint16_t reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        bit_reverse[i] = reversed;
+    }
+
+    // Periodic Hann window
+    window_power = 0.0f;
+    for (int n = 0; n < IMU_SPECTRUM_SIZE; n++) {
+        window[n] = 0.5f - 0.5f * cosf(2.0f * IMU_SPECTRUM_PI * n / IMU_SPECTRUM_SIZE);
+        window_power += window[n] * window[n];
+    }
+
+#ifdef IMU_SPECTRUM_ESP_DSP
+    dsp_ready = (dsps_fft2r_init_fc32(NULL, IMU_SPECTRUM_HALF) == ESP_OK);
+#endif
+    spectrum_ready = 1;
+}
+
+// In place radix 2 FFT of IMU_SPECTRUM_HALF points given in bit reversed order
+static void imu_spectrum_fft(float *restrict re, float *restrict im) {
+    for (int m = 1; m < IMU_SPECTRUM_HALF; m <<= 1) {
+        const float *wc = &stage_cos[m];
+        const float *ws = &stage_sin[m];
+        for (int start = 0; start < IMU_SPECTRUM_HALF; start += 2 * m) {
+            float *restrict ar = re + start;
+            float *restrict ai = im + start;
+            float *restrict br = re + start + m;
+            float *restrict bi = im + start + m;
+            for (int k = 0; k < m; k++) {
+                // b * e^(-i angle)
+                float tr = br[k] * wc[k] + bi[k] * ws[k];
+                float ti = bi[k] * wc[k] - br[k] * ws[k];
+                br[k] = ar[k] - tr;
+                bi[k] = ai[k] - ti;
+                ar[k] += tr;
+                ai[k] += ti;
+            }
+        }
+    }
+}
+
+void imu_spectrum_accumulate(const float *signal, float *power) {
+    float mean = 0.0f;
+    for (int n = 0; n < IMU_SPECTRUM_SIZE; n++) {
+        mean += signal[n];
+    }
+    mean /= IMU_SPECTRUM_SIZE;
+
+    // Even samples are the real parts and odd ones the imaginary parts of the half size FFT
+#ifdef IMU_SPECTRUM_ESP_DSP
+    if (dsp_ready) {
+        for (int n = 0; n < IMU_SPECTRUM_SIZE; n++) {
+            dsp_data[n] = (signal[n] - mean) * window[n];
+        }
+        dsps_fft2r_fc32(dsp_data, IMU_SPECTRUM_HALF);
+        dsps_bit_rev_fc32(dsp_data, IMU_SPECTRUM_HALF);
+        for (int n = 0; n < IMU_SPECTRUM_HALF; n++) {
+            fft_re[n] = dsp_data[2 * n];
+            fft_im[n] = dsp_data[2 * n + 1];
+        }
+    } else
+#endif
+    {
+        for (int n = 0; n < IMU_SPECTRUM_HALF; n++) {
+            uint16_t to = bit_reverse[n];
+            fft_re[to] = (signal[2 * n] - mean) * window[2 * n];
+            fft_im[to] = (signal[2 * n + 1] - mean) * window[2 * n + 1];
+        }
+        imu_spectrum_fft(fft_re, fft_im);
+    }
+
+    // X[k] = E[k] + e^(-2 pi i k / N) O[k], with E and O the spectra of the even and odd samples
+    power[0] += (fft_re[0] + fft_im[0]) * (fft_re[0] + fft_im[0]);
+    power[IMU_SPECTRUM_HALF] += (fft_re[0] - fft_im[0]) * (fft_re[0] - fft_im[0]);
+    for (int k = 1; k < IMU_SPECTRUM_HALF; k++) {
+        int j = IMU_SPECTRUM_HALF - k;
+        float er = 0.5f * (fft_re[k] + fft_re[j]);
+        float ei = 0.5f * (fft_im[k] - fft_im[j]);
+        float or_ = 0.5f * (fft_im[k] + fft_im[j]);
+        float oi = -0.5f * (fft_re[k] - fft_re[j]);
+        float xr = er + or_ * split_cos[k] + oi * split_sin[k];
+        float xi = ei + oi * split_cos[k] - or_ * split_sin[k];
+        power[k] += xr * xr + xi * xi;
+    }
+}
+
+void imu_spectrum_features(const float *power, float rate_hz, imu_spectrum_features_t *features) {
+    // Parseval, corrected for the window: mean square = sum of one sided power / (N * sum w^2)
+    float scale = 1.0f / (IMU_SPECTRUM_SIZE * window_power);
+    float total = 0.0f;
+    int peak = 1;
+
+    for (int b = 0; b < IMU_SPECTRUM_BANDS; b++) {
+        float energy = 0.0f;
+        for (int k = 1 + b * IMU_SPECTRUM_BAND_BINS; k <= (b + 1) * IMU_SPECTRUM_BAND_BINS; k++) {
+            // Bins below Nyquist stand for their negative frequency twin as well
+            energy += (k == IMU_SPECTRUM_HALF) ? power[k] : 2.0f * power[k];
+            peak = (power[k] > power[peak]) ? k : peak;
+        }
+        features->band_energy[b] = energy * scale;
+        total += features->band_energy[b];
+    }
+    features->rms = sqrtf(total);
+
+    float offset = 0.0f;
+    if (peak < IMU_SPECTRUM_HALF) {
+        float a = sqrtf(power[peak - 1]), b = sqrtf(power[peak]), c = sqrtf(power[peak + 1]);
+        float curvature = a - 2.0f * b + c;
+        offset = (curvature < 0.0f) ? 0.5f * (a - c) / curvature : 0.0f;
+    }
+    features->peak_hz = (peak + offset) * rate_hz / IMU_SPECTRUM_SIZE;
+}
+
+void imu_spectrum_analyze(const float *x, const float *y, const float *z, float rate_hz, imu_spectrum_features_t *features) {
+    float power[IMU_SPECTRUM_BINS];
+    memset(power, 0, sizeof(power));
+    imu_spectrum_accumulate(x, power);
+    imu_spectrum_accumulate(y, power);
+    imu_spectrum_accumulate(z, power);
+    imu_spectrum_features(power, rate_hz, features);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/*
+    Vibration spectrum of fixed size windows, single precision.
+
+    Each window has its mean removed (gravity and offsets), is Hann windowed and goes through a real FFT of
+    IMU_SPECTRUM_SIZE points, computed as a complex FFT of half the size. The power spectra of the axes are summed,
+    so the features do not depend on the direction of the vibration.
+
+    The FFT is portable C on split real and imaginary arrays with per stage twiddle tables, which compilers
+    vectorize on the host; when the esp-dsp headers are visible (add esp-dsp to the unit component's requirements)
+    its fc32 kernels run the complex FFT instead. The math has no FreeRTOS or IDF dependency, see
+    tools/imu_spectrum_bench.c for the host build.
+
+    The tables and work buffers are static: one caller at a time.
+*/
+
+#define IMU_SPECTRUM_SIZE 256
+#define IMU_SPECTRUM_BINS (IMU_SPECTRUM_SIZE / 2 + 1)
+// Equal width bands from the first bin to Nyquist
+#define IMU_SPECTRUM_BANDS 8
+
+typedef struct {
+    float rms;                              // g, of the signal without its mean
+    float peak_hz;                          // strongest bin, interpolated between its neighbours
+    float band_energy[IMU_SPECTRUM_BANDS];  // mean square, g^2; the bands sum to rms^2
+} imu_spectrum_features_t;
+
+// Build the tables, once before anything else
+void imu_spectrum_init(void);
+
+// Add the power spectrum of one window of IMU_SPECTRUM_SIZE samples to power[IMU_SPECTRUM_BINS]
+void imu_spectrum_accumulate(const float *signal, float *power);
+
+// Features of a power spectrum summed by imu_spectrum_accumulate
+void imu_spectrum_features(const float *power, float rate_hz, imu_spectrum_features_t *features);
+
+// Both steps for the three axes of one window
+void imu_spectrum_analyze(const float *x, const float *y, const float *z, float rate_hz, imu_spectrum_features_t *features);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,64 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_err.h"
+#include "esp_timer.h"
+
+#include "mpu6886.h"
+#include "imu_sampler.h"
+#include "imu_vibration.h"
+
+#define IMU_VIBRATION_FIFO_WATERMARK 32
+#define IMU_VIBRATION_READ_SAMPLES 32
+
+// Accelerometer axes of the window, converted to g as the frames are drained
+static float vibration_axes[3][IMU_SPECTRUM_SIZE];
+static imu_vibration_stats_t vibration_stats;
+
+esp_err_t imu_vibration_measure(imu_vibration_t *vibration) {
+    static uint8_t frames[IMU_VIBRATION_READ_SAMPLES * MPU6886_FIFO_FRAME_SIZE];
+    mpu6886_conversion_t conversion;
+    int64_t start = esp_timer_get_time();
+    int64_t deadline = start + (int64_t)IMU_SPECTRUM_SIZE * 2 * 1000000 / IMU_VIBRATION_RATE_HZ;
+    size_t count = 0;
+
+    imu_spectrum_init();
+    MPU6886_GetConversion(&conversion);
+
+    imu_sampler_pause();
+    esp_err_t err = MPU6886_FifoStart(IMU_VIBRATION_RATE_HZ, IMU_VIBRATION_FIFO_WATERMARK);
+    while (err == ESP_OK && count < IMU_SPECTRUM_SIZE && esp_timer_get_time() < deadline) {
+        size_t read = 0;
+        int64_t timestamp;
+        size_t left = IMU_SPECTRUM_SIZE - count;
+        (void)MPU6886_FifoReadFrames(frames, (left < IMU_VIBRATION_READ_SAMPLES) ? left : IMU_VIBRATION_READ_SAMPLES, &read, &timestamp);
+        // Only the accelerometer columns, straight into the window
+        float *const columns[MPU6886_BATCH_CHANNELS] = { &vibration_axes[0][count], &vibration_axes[1][count], &vibration_axes[2][count] };
+        MPU6886_BatchConvert(frames, read, &conversion, columns);
+        count += read;
+        if (read == 0) {
+            vTaskDelay(pdMS_TO_TICKS(IMU_VIBRATION_FIFO_WATERMARK * 1000 / IMU_VIBRATION_RATE_HZ));
+        }
+    }
+    MPU6886_FifoStop();
+    imu_sampler_resume();
+    vibration_stats.windows++;
+    vibration_stats.blind_us += (uint64_t)(esp_timer_get_time() - start);
+
+    if (err != ESP_OK) {
+        return err;
+    }
+    if (count < IMU_SPECTRUM_SIZE) {
+        return ESP_ERR_TIMEOUT;
+    }
+
+    int64_t captured = esp_timer_get_time();
+    imu_spectrum_analyze(vibration_axes[0], vibration_axes[1], vibration_axes[2], (float)IMU_VIBRATION_RATE_HZ, &vibration->features);
+    vibration->capture_us = (uint32_t)(captured - start);
+    vibration->analysis_us = (uint32_t)(esp_timer_get_time() - captured);
+    return ESP_OK;
+}
+
+void imu_vibration_get_stats(imu_vibration_stats_t *stats) {
+    *stats = vibration_stats;
+}
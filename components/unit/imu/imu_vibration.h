@@ -0,0 +1,43 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "esp_err.h"
+
+#include "imu_spectrum.h"
+
+/*
+    Vibration features of one window of accelerometer data, see imu_spectrum.h.
+
+    The window is streamed through the MPU6886 FIFO at IMU_VIBRATION_RATE_HZ, far above the sampler's rate, so
+    the spectrum reaches up to 500 Hz. The sampler is paused for the IMU_SPECTRUM_SIZE samples, about 0.26 s:
+    a blind window in which its subscribers get no samples, the event detector sees nothing, the fusion
+    integrates nothing and the capture's pre-trigger history ends. The stats count these windows.
+*/
+
+#define IMU_VIBRATION_RATE_HZ 1000
+
+typedef struct {
+    uint32_t windows;           // measurements, each a blind window of the sampler
+    uint64_t blind_us;          // total time the sampler was paused
+} imu_vibration_stats_t;
+
+typedef struct {
+    imu_spectrum_features_t features;
+    uint32_t capture_us;        // streaming the window
+    uint32_t analysis_us;       // FFT and features
+} imu_vibration_t;
+
+/*
+    Capture and analyze one window; call from a task that may block for the capture.
+    ESP_ERR_TIMEOUT if the FIFO did not deliver the window in twice its duration.
+*/
+esp_err_t imu_vibration_measure(imu_vibration_t *vibration);
+
+void imu_vibration_get_stats(imu_vibration_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
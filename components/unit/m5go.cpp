@@ -12,6 +12,8 @@
 #include "m5go.h"
 #include "driver/gpio.h"
 #include "i2c_device.h"
+#include "i2c_async.h"
+#include "imu_sampler.h"
 
 pixel_settings_t px;
 
@@ -93,3 +95,136 @@ void m5go_Mpu6886_Init(void){
     MPU6886_Init();
 }
 
+static const struct {
+    uint8_t sensor;
+    uint8_t address;
+} sensor_addresses[] = {
+    { M5GO_SENSOR_SHT30, 0x44 },
+    { M5GO_SENSOR_BMP280, 0x76 },
+    { M5GO_SENSOR_MPU6886, MPU6886_ADDRESS },
+};
+
+static uint8_t sensor_present;
+static TickType_t sensor_probe_tick;
+
+// An address ACK, without touching the sensor's registers
+static bool m5go_Sensor_Probe(uint8_t address){
+    I2CDevice_t device = i2c_bus_find_device(I2C_NUM_1, address);
+    if (device != NULL) {
+        return i2c_device_valid(device) == ESP_OK;
+    }
+    // Not registered by its driver yet, probe with a temporary device at the standard clock
+    device = i2c_malloc_device(I2C_NUM_1, 21, 22, 100000, address);
+    if (device == NULL) {
+        return false;
+    }
+    bool found = i2c_device_valid(device) == ESP_OK;
+    i2c_free_device(device);
+    return found;
+}
+
+static bool m5go_Sensor_Start(uint8_t sensor){
+    switch (sensor) {
+        case M5GO_SENSOR_SHT30:
+            return SHT30_Init() == 0;
+        case M5GO_SENSOR_BMP280:
+            if (bmp280_init() != 0) {
+                return false;
+            }
+            bmp280_set_work_mode(BMP280_FORCED_MODE);
+            return true;
+        case M5GO_SENSOR_MPU6886:
+            return MPU6886_Init() == 0;
+        default:
+            return false;
+    }
+}
+
+static void m5go_Sensor_ProbeMissing(void){
+    for (size_t i = 0; i < sizeof(sensor_addresses) / sizeof(sensor_addresses[0]); i++) {
+        uint8_t sensor = sensor_addresses[i].sensor;
+        if ((sensor_present & sensor) == 0 && m5go_Sensor_Probe(sensor_addresses[i].address) && m5go_Sensor_Start(sensor)) {
+            sensor_present |= sensor;
+        }
+    }
+    sensor_probe_tick = xTaskGetTickCount();
+}
+
+uint8_t m5go_Sensor_Init(void){
+    sensor_present = 0;
+    m5go_Sensor_ProbeMissing();
+    return sensor_present;
+}
+
+uint8_t m5go_Sensor_Present(void){
+    return sensor_present;
+}
+
+uint8_t m5go_Sensor_Update(void){
+    for (size_t i = 0; i < sizeof(sensor_addresses) / sizeof(sensor_addresses[0]); i++) {
+        uint8_t sensor = sensor_addresses[i].sensor;
+        if ((sensor_present & sensor) && i2c_device_quarantined(i2c_bus_find_device(I2C_NUM_1, sensor_addresses[i].address))) {
+            sensor_present &= ~sensor;
+        }
+    }
+    if (sensor_present != M5GO_SENSOR_ALL && (xTaskGetTickCount() - sensor_probe_tick) >= pdMS_TO_TICKS(M5GO_SENSOR_REPROBE_MS)) {
+        m5go_Sensor_ProbeMissing();
+    }
+    return sensor_present;
+}
+
+#define M5GO_SWEEP_MAX_OPS 8
+
+static i2c_op_t sweep_ops[M5GO_SWEEP_MAX_OPS];
+static i2c_transaction_t sweep_transaction;
+static uint8_t sweep_sensors;
+static i2c_async_request_t sweep_request;
+
+// A running IMU sampler already reads every MPU6886 sample, the sweep leaves it out
+static uint8_t m5go_Sensor_Swept(void){
+    return sensor_present & (imu_sampler_running() ? ~M5GO_SENSOR_MPU6886 : M5GO_SENSOR_ALL);
+}
+
+static i2c_transaction_t* m5go_Sensor_SweepTransaction(void){
+    // The sweep reads into the drivers' static sample buffers, so its links are built once
+    // and reused until the set of swept sensors changes; a sweep still queued keeps its links
+    uint8_t sensors = m5go_Sensor_Swept();
+    bool pending = sweep_request.transaction != NULL && !sweep_request.done;
+    if (sweep_transaction.ops != NULL && sweep_sensors != sensors && !pending) {
+        i2c_transaction_release(&sweep_transaction);
+        sweep_transaction.ops = NULL;
+    }
+    if (sweep_transaction.ops == NULL) {
+        i2c_transaction_init(&sweep_transaction, sweep_ops, M5GO_SWEEP_MAX_OPS);
+        sweep_sensors = sensors;
+        if (sweep_sensors & M5GO_SENSOR_SHT30) {
+            SHT30_add_sample_ops(&sweep_transaction);
+        }
+        if (sweep_sensors & M5GO_SENSOR_BMP280) {
+            bmp280_add_sample_ops(&sweep_transaction);
+        }
+        if (sweep_sensors & M5GO_SENSOR_MPU6886) {
+            MPU6886_AddSampleOps(&sweep_transaction);
+        }
+        i2c_transaction_prepare(&sweep_transaction);
+    }
+    return &sweep_transaction;
+}
+
+esp_err_t m5go_Sensor_Sweep(void){
+    if (m5go_Sensor_Swept() == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return i2c_transaction_execute(m5go_Sensor_SweepTransaction());
+}
+
+esp_err_t m5go_Sensor_SweepStart(void){
+    if (m5go_Sensor_Swept() == 0) {
+        return ESP_ERR_NOT_FOUND;
+    }
+    return i2c_async_submit(&sweep_request, m5go_Sensor_SweepTransaction(), NULL, NULL);
+}
+
+esp_err_t m5go_Sensor_SweepWait(TickType_t timeout){
+    return i2c_async_wait(&sweep_request, timeout);
+}
@@ -25,3 +25,36 @@ uint8_t m5go_Get_Angle(void);
 
 void m5go_Motion_Init(void);
 uint8_t m5go_Get_Motion(void);
+
+/*
+    Sensors on the shared I2C bus. m5go_Sensor_Init probes each address and initializes the sensors that answer;
+    the returned set decides what is swept, sent and shown. Missing sensors are probed again every
+    M5GO_SENSOR_REPROBE_MS from m5go_Sensor_Update and join the set once they answer, and a sensor
+    quarantined by the I2C layer leaves it until it answers a probe again.
+*/
+#define M5GO_SENSOR_SHT30   0x01
+#define M5GO_SENSOR_BMP280  0x02
+#define M5GO_SENSOR_MPU6886 0x04
+#define M5GO_SENSOR_ALL     (M5GO_SENSOR_SHT30 | M5GO_SENSOR_BMP280 | M5GO_SENSOR_MPU6886)
+
+#define M5GO_SENSOR_REPROBE_MS 10000
+
+uint8_t m5go_Sensor_Init(void);
+uint8_t m5go_Sensor_Present(void);
+
+// Call once per sampling cycle from the task that runs the sweep; returns the current set
+uint8_t m5go_Sensor_Update(void);
+
+/*
+    Read the present sensors in one I2C transaction, holding the bus once for the whole sweep.
+    The MPU6886 is left out while the IMU sampler runs. ESP_ERR_NOT_FOUND if there is nothing to read.
+    The results are fetched afterwards with SHT30_get_sample, bmp280_get_sample and MPU6886_GetSample*Data.
+*/
+esp_err_t m5go_Sensor_Sweep(void);
+
+/*
+    Queue the sweep on the I2C bus task and return; m5go_Sensor_SweepWait collects the result.
+    Both must be called from the same task.
+*/
+esp_err_t m5go_Sensor_SweepStart(void);
+esp_err_t m5go_Sensor_SweepWait(TickType_t timeout);
@@ -0,0 +1,528 @@
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+#include "i2c_device.h"
+#include "mpu6886.h"
+#include "mpu6886_regs.hpp"
+
+using namespace mpu6886;
+
+static I2CDevice_t mpu6886_device;
+static gyro_scale_t gyro_scale = MPU6886_GFS_2000DPS;
+static acc_scale_t acc_scale = MPU6886_AFS_8G;
+static float acc_res, gyro_res;
+static mpu6886_calibration_t calibration = { { 0.0f, 0.0f, 0.0f }, { 1.0f, 1.0f, 1.0f }, { 0.0f, 0.0f, 0.0f } };
+// Resolution and calibration combined, raw * gain - offset
+static float acc_gain[3], acc_offset[3];
+static uint8_t sample_rate_divider = 0x05;
+static AccelGyro::buffer_type sample_raw;
+
+// Frames per FIFO burst, keeps one read well inside the I2C timeout at 400 kHz
+#define MPU6886_FIFO_BURST_FRAMES 32
+
+static uint8_t fifo_running;
+static uint8_t fifo_watermark;
+static uint8_t fifo_saved_divider;
+static uint32_t fifo_period_us;
+static int64_t fifo_start_us;
+static uint32_t fifo_index;
+static uint8_t fifo_raw[MPU6886_FIFO_BURST_FRAMES * MPU6886_FIFO_FRAME_SIZE];
+static mpu6886_fifo_stats_t fifo_stats;
+
+static uint8_t wom_running;
+static uint8_t wom_saved_divider;
+
+static void MPU6886_UpdateGains(void) {
+    for (int axis = 0; axis < 3; axis++) {
+        acc_gain[axis] = acc_res * calibration.accel_scale[axis];
+        acc_offset[axis] = calibration.accel_offset[axis] * calibration.accel_scale[axis];
+    }
+}
+
+static void MPU6886_I2CInit() {
+    // MPU6886_Init runs again when the sensor is plugged back in, the device is kept
+    if (mpu6886_device == NULL) {
+        mpu6886_device = i2c_malloc_device(I2C_NUM_1, 21, 22, 400000, MPU6886_ADDRESS);
+    }
+}
+
+int MPU6886_Init(void) {
+    uint8_t whoami = 0;
+    MPU6886_I2CInit();
+
+    regmap::read<WHO_AM_I>(mpu6886_device, &whoami);
+    if (whoami != 0x19) {
+        return -1;
+    }
+    if (fifo_running) {
+        // The reset below stops the FIFO, start from the rate it was configured with
+        sample_rate_divider = fifo_saved_divider;
+        fifo_running = 0;
+    }
+    if (wom_running) {
+        sample_rate_divider = wom_saved_divider;
+        wom_running = 0;
+    }
+    vTaskDelay(1);
+
+    regmap::write<PWR_MGMT_1>(mpu6886_device, 0x00);
+    vTaskDelay(10);
+
+    regmap::write<PWR_MGMT_1>(mpu6886_device, DEVICE_RESET::insert(0, 1));
+    vTaskDelay(10);
+
+    regmap::write<PWR_MGMT_1>(mpu6886_device, CLKSEL::insert(0, 1));
+    vTaskDelay(10);
+
+    // Sample rate, DLPF and full scale ranges are shadowed: set here in one burst,
+    // and the setters below change them without reading the register first
+    i2c_shadow_enable(mpu6886_device, ConfigBlock::first, ConfigBlock::length, I2C_SHADOW_AUTO_INCREMENT);
+    i2c_shadow_defer(mpu6886_device);
+    regmap::write<SMPLRT_DIV>(mpu6886_device, sample_rate_divider);
+    regmap::write<CONFIG>(mpu6886_device, DLPF_CFG::insert(0, 1));
+    regmap::write<GYRO_CONFIG>(mpu6886_device, GYRO_FS_SEL::insert(0, gyro_scale));
+    regmap::write<ACCEL_CONFIG>(mpu6886_device, ACCEL_FS_SEL::insert(0, acc_scale));
+    regmap::write<ACCEL_CONFIG2>(mpu6886_device, 0x00);
+    i2c_shadow_flush(mpu6886_device);
+    vTaskDelay(1);
+
+    regmap::write<INT_ENABLE>(mpu6886_device, 0x00);
+    vTaskDelay(1);
+
+    regmap::write<USER_CTRL>(mpu6886_device, 0x00);
+    vTaskDelay(1);
+
+    regmap::write<FIFO_EN>(mpu6886_device, 0x00);
+    vTaskDelay(1);
+
+    regmap::write<INT_PIN_CFG>(mpu6886_device, 0x22);
+    vTaskDelay(1);
+
+    regmap::write<INT_ENABLE>(mpu6886_device, 0x01);
+    vTaskDelay(100);
+
+    gyro_res = MPU6886_GetGyroRes(gyro_scale);
+    acc_res = MPU6886_GetAccRes(acc_scale);
+    MPU6886_UpdateGains();
+    return 0;
+}
+
+void MPU6886_GetAccelAdc(int16_t *ax, int16_t *ay, int16_t *az) {
+    Accel::buffer_type buf;
+    regmap::read<Accel>(mpu6886_device, buf);
+
+    *ax = Accel::get<ACCEL_X>(buf);
+    *ay = Accel::get<ACCEL_Y>(buf);
+    *az = Accel::get<ACCEL_Z>(buf);
+}
+
+void MPU6886_GetGyroAdc(int16_t *gx, int16_t *gy, int16_t *gz) {
+    Gyro::buffer_type buf;
+    regmap::read<Gyro>(mpu6886_device, buf);
+
+    *gx = Gyro::get<GYRO_X>(buf);
+    *gy = Gyro::get<GYRO_Y>(buf);
+    *gz = Gyro::get<GYRO_Z>(buf);
+}
+
+void MPU6886_GetTempAdc(int16_t *t) {
+    regmap::read<TEMP>(mpu6886_device, t);
+}
+
+float MPU6886_GetGyroRes(gyro_scale_t scale) {
+    switch (scale) {
+        case MPU6886_GFS_250DPS:
+            return 250.0 / 32768.0;
+        case MPU6886_GFS_500DPS:
+            return 500.0 / 32768.0;
+        case MPU6886_GFS_1000DPS:
+            return 1000.0 / 32768.0;
+        case MPU6886_GFS_2000DPS:
+        default:
+            return 2000.0 / 32768.0;
+    }
+}
+
+float MPU6886_GetAccRes(acc_scale_t scale) {
+    switch (scale) {
+        // Possible accelerometer scales (and their register bit settings) are:
+        // 2 Gs (00), 4 Gs (01), 8 Gs (10), and 16 Gs  (11).
+        // Here's a bit of an algorith to calculate DPS/(ADC tick) based on that 2-bit value:
+        case MPU6886_AFS_2G:
+            return 2.0 / 32768.0;
+        case MPU6886_AFS_4G:
+            return 4.0 / 32768.0;
+        case MPU6886_AFS_8G:
+            return 8.0 / 32768.0;
+        case MPU6886_AFS_16G:
+        default:
+            return 16.0 / 32768.0;
+    }
+}
+
+void MPU6886_SetGyroFSR(gyro_scale_t scale) {
+    regmap::write<GYRO_FS_SEL>(mpu6886_device, scale);
+    gyro_scale = scale;
+    gyro_res = MPU6886_GetGyroRes(scale);
+}
+
+void MPU6886_SetAccelFSR(acc_scale_t scale) {
+    regmap::write<ACCEL_FS_SEL>(mpu6886_device, scale);
+    vTaskDelay(10);
+    acc_scale = scale;
+    acc_res = MPU6886_GetAccRes(scale);
+    MPU6886_UpdateGains();
+}
+
+void MPU6886_GetAccelData(float *ax, float *ay, float *az) {
+    int16_t accX = 0;
+    int16_t accY = 0;
+    int16_t accZ = 0;
+    MPU6886_GetAccelAdc(&accX, &accY, &accZ);
+
+    *ax = (float)accX * acc_gain[0] - acc_offset[0];
+    *ay = (float)accY * acc_gain[1] - acc_offset[1];
+    *az = (float)accZ * acc_gain[2] - acc_offset[2];
+}
+
+void MPU6886_GetGyroData(float *gx, float *gy, float *gz) {
+    int16_t gyroX = 0;
+    int16_t gyroY = 0;
+    int16_t gyroZ = 0;
+    MPU6886_GetGyroAdc(&gyroX, &gyroY, &gyroZ);
+
+    *gx = (float)gyroX * gyro_res - calibration.gyro_bias[0];
+    *gy = (float)gyroY * gyro_res - calibration.gyro_bias[1];
+    *gz = (float)gyroZ * gyro_res - calibration.gyro_bias[2];
+}
+
+void MPU6886_GetTempData(float *t) {
+
+    int16_t temp = 0;
+    MPU6886_GetTempAdc(&temp);
+    *t = (float)temp / 326.8 + 25.0;
+}
+
+acc_scale_t MPU6886_GetAccelFSR(void) {
+    return acc_scale;
+}
+
+gyro_scale_t MPU6886_GetGyroFSR(void) {
+    return gyro_scale;
+}
+
+void MPU6886_SetSampleRateDivider(uint8_t divider) {
+    regmap::write<SMPLRT_DIV>(mpu6886_device, divider);
+    sample_rate_divider = divider;
+}
+
+uint8_t MPU6886_GetSampleRateDivider(void) {
+    return sample_rate_divider;
+}
+
+uint8_t MPU6886_IsDataReady(void) {
+    uint8_t ready = 0;
+    regmap::read<DATA_RDY_INT>(mpu6886_device, &ready);
+    return ready;
+}
+
+void MPU6886_GetAccelGyroAdc(int16_t *accel, int16_t *gyro) {
+    AccelGyro::buffer_type buf;
+    regmap::read<AccelGyro>(mpu6886_device, buf);
+
+    accel[0] = AccelGyro::get<ACCEL_X>(buf);
+    accel[1] = AccelGyro::get<ACCEL_Y>(buf);
+    accel[2] = AccelGyro::get<ACCEL_Z>(buf);
+    gyro[0] = AccelGyro::get<GYRO_X>(buf);
+    gyro[1] = AccelGyro::get<GYRO_Y>(buf);
+    gyro[2] = AccelGyro::get<GYRO_Z>(buf);
+}
+
+void MPU6886_DecodeFrames(const uint8_t *frames, size_t count, mpu6886_raw_sample_t *raw) {
+    for (size_t i = 0; i < count; i++, frames += AccelGyro::length) {
+        raw[i].accel[0] = AccelGyro::get<ACCEL_X>(frames);
+        raw[i].accel[1] = AccelGyro::get<ACCEL_Y>(frames);
+        raw[i].accel[2] = AccelGyro::get<ACCEL_Z>(frames);
+        raw[i].temp = AccelGyro::get<TEMP>(frames);
+        raw[i].gyro[0] = AccelGyro::get<GYRO_X>(frames);
+        raw[i].gyro[1] = AccelGyro::get<GYRO_Y>(frames);
+        raw[i].gyro[2] = AccelGyro::get<GYRO_Z>(frames);
+    }
+}
+
+void MPU6886_ScaleSamples(const mpu6886_raw_sample_t *raw, size_t count, mpu6886_sample_t *samples) {
+    for (size_t i = 0; i < count; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            samples[i].accel[axis] = (float)raw[i].accel[axis] * acc_gain[axis] - acc_offset[axis];
+            samples[i].gyro[axis] = (float)raw[i].gyro[axis] * gyro_res - calibration.gyro_bias[axis];
+        }
+        samples[i].temp = (float)raw[i].temp / 326.8f + 25.0f;
+    }
+}
+
+void MPU6886_ScaleCounts(const float *accel, float temp, const float *gyro, mpu6886_sample_t *sample) {
+    for (int axis = 0; axis < 3; axis++) {
+        sample->accel[axis] = accel[axis] * acc_gain[axis] - acc_offset[axis];
+        sample->gyro[axis] = gyro[axis] * gyro_res - calibration.gyro_bias[axis];
+    }
+    sample->temp = temp / 326.8f + 25.0f;
+}
+
+void MPU6886_GetConversion(mpu6886_conversion_t *conversion) {
+    for (int axis = 0; axis < 3; axis++) {
+        conversion->gain[MPU6886_CHANNEL_ACCEL_X + axis] = acc_gain[axis];
+        conversion->offset[MPU6886_CHANNEL_ACCEL_X + axis] = acc_offset[axis];
+        conversion->gain[MPU6886_CHANNEL_GYRO_X + axis] = gyro_res;
+        conversion->offset[MPU6886_CHANNEL_GYRO_X + axis] = calibration.gyro_bias[axis];
+    }
+    conversion->gain[MPU6886_CHANNEL_TEMP] = 1.0f / 326.8f;
+    conversion->offset[MPU6886_CHANNEL_TEMP] = -25.0f;
+}
+
+void MPU6886_DefaultCalibration(mpu6886_calibration_t *value) {
+    for (int axis = 0; axis < 3; axis++) {
+        value->accel_offset[axis] = 0.0f;
+        value->accel_scale[axis] = 1.0f;
+        value->gyro_bias[axis] = 0.0f;
+    }
+}
+
+void MPU6886_SetCalibration(const mpu6886_calibration_t *value) {
+    calibration = *value;
+    MPU6886_UpdateGains();
+}
+
+void MPU6886_GetCalibration(mpu6886_calibration_t *value) {
+    *value = calibration;
+}
+
+esp_err_t MPU6886_ReadRawSample(mpu6886_raw_sample_t *raw) {
+    AccelGyro::buffer_type buf;
+    esp_err_t err = regmap::read<AccelGyro>(mpu6886_device, buf);
+    if (err == ESP_OK) {
+        MPU6886_DecodeFrames(buf.data(), 1, raw);
+    }
+    return err;
+}
+
+esp_err_t MPU6886_ReadSample(mpu6886_sample_t *sample) {
+    mpu6886_raw_sample_t raw;
+    esp_err_t err = MPU6886_ReadRawSample(&raw);
+    if (err == ESP_OK) {
+        MPU6886_ScaleSamples(&raw, 1, sample);
+    }
+    return err;
+}
+
+esp_err_t MPU6886_ReadNewSample(mpu6886_raw_sample_t *raw) {
+    StatusAccelGyro::buffer_type buf;
+    esp_err_t err = regmap::read<StatusAccelGyro>(mpu6886_device, buf);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    MPU6886_DecodeFrames(buf.data() + (AccelGyro::first - StatusAccelGyro::first), 1, raw);
+    return DATA_RDY_INT::extract(StatusAccelGyro::get<INT_STATUS>(buf)) ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t MPU6886_AddSampleOps(i2c_transaction_t *transaction) {
+    return regmap::add_read<AccelGyro>(transaction, mpu6886_device, sample_raw);
+}
+
+void MPU6886_GetSample(mpu6886_sample_t *sample) {
+    mpu6886_raw_sample_t raw;
+    MPU6886_DecodeFrames(sample_raw.data(), 1, &raw);
+    MPU6886_ScaleSamples(&raw, 1, sample);
+}
+
+// Clear the FIFO and start counting frames from now
+static esp_err_t MPU6886_FifoReset(void) {
+    esp_err_t err = regmap::write<USER_CTRL>(mpu6886_device, USER_FIFO_EN::insert(FIFO_RST::insert(0, 1), 1));
+    fifo_start_us = esp_timer_get_time();
+    fifo_index = 0;
+    return err;
+}
+
+esp_err_t MPU6886_FifoStart(uint16_t odr_hz, uint8_t watermark) {
+    if (odr_hz == 0 || odr_hz > 1000 || watermark > MPU6886_FIFO_MAX_WATERMARK) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint16_t divider = (1000 + odr_hz / 2) / odr_hz - 1;
+    if (divider > 0xFF) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    // The cycling accelerometer has no gyro and its own rate; MPU6886_WakeOnMotionStop first
+    if (wom_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!fifo_running) {
+        fifo_saved_divider = sample_rate_divider;
+    }
+    fifo_running = 0;
+    MPU6886_SetSampleRateDivider((uint8_t)divider);
+    fifo_period_us = 1000 * (1 + divider);
+    fifo_watermark = (watermark == 0) ? 1 : watermark;
+
+    esp_err_t err = regmap::write<FIFO_EN>(mpu6886_device, GYRO_FIFO_EN::insert(ACCEL_FIFO_EN::insert(0, 1), 1));
+    if (err == ESP_OK) {
+        err = MPU6886_FifoReset();
+    }
+    fifo_running = (err == ESP_OK);
+    return err;
+}
+
+void MPU6886_FifoStop(void) {
+    if (!fifo_running) {
+        return ;
+    }
+    fifo_running = 0;
+    regmap::write<USER_CTRL>(mpu6886_device, 0x00);
+    regmap::write<FIFO_EN>(mpu6886_device, 0x00);
+    MPU6886_SetSampleRateDivider(fifo_saved_divider);
+}
+
+uint8_t MPU6886_FifoRunning(void) {
+    return fifo_running;
+}
+
+uint32_t MPU6886_FifoPeriodUs(void) {
+    return fifo_period_us;
+}
+
+// Drain into out when given, else decode into samples
+static esp_err_t MPU6886_FifoDrain(uint8_t *out, mpu6886_raw_sample_t *samples, size_t max_samples, size_t *count, int64_t *timestamp_us) {
+    *count = 0;
+    *timestamp_us = fifo_start_us + (int64_t)(fifo_index + 1) * fifo_period_us;
+    if (!fifo_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint16_t queued = 0;
+    esp_err_t err = regmap::read<FIFO_COUNT>(mpu6886_device, &queued);
+    if (err != ESP_OK) {
+        return err;
+    }
+
+    // Once the FIFO cannot take another frame it overwrites the oldest bytes and the frame boundaries are lost;
+    // the count alone tells, without an INT_STATUS read that would also clear the data ready latch
+    if (queued > MPU6886_FIFO_SIZE - MPU6886_FIFO_FRAME_SIZE) {
+        fifo_stats.overflows++;
+        return MPU6886_FifoReset();
+    }
+
+    size_t frames = queued / MPU6886_FIFO_FRAME_SIZE;
+    if (frames < fifo_watermark) {
+        return ESP_OK;
+    }
+    frames = (frames < max_samples) ? frames : max_samples;
+
+    while (*count < frames) {
+        size_t burst = frames - *count;
+        burst = (burst < MPU6886_FIFO_BURST_FRAMES) ? burst : MPU6886_FIFO_BURST_FRAMES;
+        // FIFO_R_W does not auto increment, the whole burst comes out of the FIFO
+        uint8_t *raw = (out != NULL) ? out + *count * MPU6886_FIFO_FRAME_SIZE : fifo_raw;
+        err = i2c_read_bytes(mpu6886_device, FIFO_R_W::addr, raw, burst * MPU6886_FIFO_FRAME_SIZE);
+        if (err != ESP_OK) {
+            // Part of a frame may have been read, the FIFO is out of step
+            MPU6886_FifoReset();
+            break;
+        }
+
+        if (out == NULL) {
+            MPU6886_DecodeFrames(fifo_raw, burst, &samples[*count]);
+        }
+        fifo_index += burst;
+        *count += burst;
+    }
+
+    if (*count > 0) {
+        fifo_stats.frames += *count;
+        fifo_stats.drains++;
+    }
+    return err;
+}
+
+esp_err_t MPU6886_FifoRead(mpu6886_raw_sample_t *samples, size_t max_samples, size_t *count, int64_t *timestamp_us) {
+    return MPU6886_FifoDrain(NULL, samples, max_samples, count, timestamp_us);
+}
+
+esp_err_t MPU6886_FifoReadFrames(uint8_t *frames, size_t max_frames, size_t *count, int64_t *timestamp_us) {
+    return MPU6886_FifoDrain(frames, NULL, max_frames, count, timestamp_us);
+}
+
+void MPU6886_FifoGetStats(mpu6886_fifo_stats_t *stats) {
+    *stats = fifo_stats;
+}
+
+esp_err_t MPU6886_WakeOnMotionStart(uint16_t threshold_mg, uint16_t odr_hz) {
+    if (odr_hz == 0 || odr_hz > 1000 || threshold_mg > 0xFF * 4) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    uint16_t divider = (1000 + odr_hz / 2) / odr_hz - 1;
+    if (divider > 0xFF) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (fifo_running) {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    if (!wom_running) {
+        wom_saved_divider = sample_rate_divider;
+    }
+    WomThreshold::buffer_type threshold;
+    uint8_t lsb = (uint8_t)((threshold_mg + 2) / 4);
+    WomThreshold::set<ACCEL_WOM_X_THR>(threshold, lsb);
+    WomThreshold::set<ACCEL_WOM_Y_THR>(threshold, lsb);
+    WomThreshold::set<ACCEL_WOM_Z_THR>(threshold, lsb);
+
+    // The order of the datasheet: gyro off, thresholds, motion interrupt only, compare mode, then cycling
+    esp_err_t err = regmap::write<PWR_MGMT_2>(mpu6886_device, STBY_G::insert(0, 0x07));
+    if (err == ESP_OK) {
+        err = regmap::write<WomThreshold>(mpu6886_device, threshold);
+    }
+    if (err == ESP_OK) {
+        err = regmap::write<INT_ENABLE>(mpu6886_device, WOM_INT_EN::insert(0, 0x07));
+    }
+    if (err == ESP_OK) {
+        err = regmap::write<ACCEL_INTEL_CTRL>(mpu6886_device, ACCEL_INTEL_EN::insert(ACCEL_INTEL_MODE::insert(OUTPUT_LIMIT::insert(0, 1), 1), 1));
+    }
+    if (err == ESP_OK) {
+        MPU6886_SetSampleRateDivider((uint8_t)divider);
+        err = regmap::write<PWR_MGMT_1>(mpu6886_device, CYCLE::insert(CLKSEL::insert(0, 1), 1));
+    }
+    wom_running = 1;
+    if (err != ESP_OK) {
+        // Half configured, go back to full power
+        MPU6886_WakeOnMotionStop();
+    }
+    return err;
+}
+
+esp_err_t MPU6886_WakeOnMotionStop(void) {
+    if (!wom_running) {
+        return ESP_OK;
+    }
+    wom_running = 0;
+    esp_err_t err = regmap::write<PWR_MGMT_1>(mpu6886_device, CLKSEL::insert(0, 1));
+    if (err == ESP_OK) {
+        err = regmap::write<ACCEL_INTEL_CTRL>(mpu6886_device, 0x00);
+    }
+    if (err == ESP_OK) {
+        err = regmap::write<PWR_MGMT_2>(mpu6886_device, 0x00);
+    }
+    if (err == ESP_OK) {
+        err = regmap::write<INT_ENABLE>(mpu6886_device, DATA_RDY_INT_EN::insert(0, 1));
+    }
+    MPU6886_SetSampleRateDivider(wom_saved_divider);
+    return err;
+}
+
+uint8_t MPU6886_WakeOnMotionRunning(void) {
+    return wom_running;
+}
+
+uint8_t MPU6886_IsMotionDetected(void) {
+    uint8_t axes = 0;
+    regmap::read<WOM_INT>(mpu6886_device, &axes);
+    return axes != 0;
+}
@@ -6,13 +6,19 @@ extern "C" {
 #endif
 
 #include "stdint.h"
+#include "i2c_device.h"
+#include "mpu6886_batch.h"
 
 #define MPU6886_ADDRESS           0x68 
 #define MPU6886_WHOAMI            0x75
 #define MPU6886_ACCEL_INTEL_CTRL  0x69
 #define MPU6886_SMPLRT_DIV        0x19
+#define MPU6886_ACCEL_WOM_X_THR   0x20
+#define MPU6886_ACCEL_WOM_Y_THR   0x21
+#define MPU6886_ACCEL_WOM_Z_THR   0x22
 #define MPU6886_INT_PIN_CFG       0x37
 #define MPU6886_INT_ENABLE        0x38
+#define MPU6886_INT_STATUS        0x3A
 #define MPU6886_ACCEL_XOUT_H      0x3B
 #define MPU6886_ACCEL_XOUT_L      0x3C
 #define MPU6886_ACCEL_YOUT_H      0x3D
@@ -38,6 +44,15 @@ extern "C" {
 #define MPU6886_ACCEL_CONFIG      0x1C
 #define MPU6886_ACCEL_CONFIG2     0x1D
 #define MPU6886_FIFO_EN           0x23
+#define MPU6886_FIFO_COUNTH       0x72
+#define MPU6886_FIFO_COUNTL       0x73
+#define MPU6886_FIFO_R_W          0x74
+
+#define MPU6886_FIFO_SIZE         1024
+// accel, temperature and gyro, in the order of the output registers
+#define MPU6886_FIFO_FRAME_SIZE   14
+// A FIFO within a frame of full counts as overflowed, a larger watermark would never be reached
+#define MPU6886_FIFO_MAX_WATERMARK ((MPU6886_FIFO_SIZE - MPU6886_FIFO_FRAME_SIZE) / MPU6886_FIFO_FRAME_SIZE)
 
 typedef enum {
     MPU6886_AFS_2G = 0,
@@ -53,6 +68,32 @@ typedef enum {
     MPU6886_GFS_2000DPS
 } gyro_scale_t;
 
+// One sample in output register order: accel, temperature and gyro of the same instant
+typedef struct {
+    int16_t accel[3];
+    int16_t temp;
+    int16_t gyro[3];
+} mpu6886_raw_sample_t;
+
+// A sample scaled to g, Celsius and dps
+typedef struct {
+    float accel[3];
+    float temp;
+    float gyro[3];
+} mpu6886_sample_t;
+
+/*
+    Per axis corrections, in g and dps so they hold for every full scale range:
+    accel = (raw * resolution - accel_offset) * accel_scale, gyro = raw * resolution - gyro_bias.
+    They are folded into the factors every conversion to g and dps already applies, so a calibrated
+    sample costs no extra transfer and no extra arithmetic. Raw values (*Adc, raw samples, the FIFO) stay uncorrected.
+*/
+typedef struct {
+    float accel_offset[3];
+    float accel_scale[3];
+    float gyro_bias[3];
+} mpu6886_calibration_t;
+
 int MPU6886_Init(void);
 
 void MPU6886_GetAccelAdc(int16_t *ax, int16_t *ay, int16_t *az);
@@ -75,6 +116,127 @@ void MPU6886_GetGyroData(float *gx, float *gy, float *gz);
 
 void MPU6886_GetTempData(float *t);
 
+acc_scale_t MPU6886_GetAccelFSR(void);
+
+gyro_scale_t MPU6886_GetGyroFSR(void);
+
+/*
+    Output data rate = 1 kHz / (1 + divider) with the DLPF configured by MPU6886_Init
+*/
+void MPU6886_SetSampleRateDivider(uint8_t divider);
+
+uint8_t MPU6886_GetSampleRateDivider(void);
+
+/*
+    Reads INT_STATUS, which also clears the latched interrupt.
+    return 1 when a new sample is ready
+*/
+uint8_t MPU6886_IsDataReady(void);
+
+/*
+    Reads accel and gyro of the same sample in one 14 byte burst from ACCEL_XOUT_H
+*/
+void MPU6886_GetAccelGyroAdc(int16_t *accel, int16_t *gyro);
+
+/*
+    Reads accel, temperature and gyro of the same sample in one 14 byte burst from ACCEL_XOUT_H
+*/
+esp_err_t MPU6886_ReadRawSample(mpu6886_raw_sample_t *raw);
+
+esp_err_t MPU6886_ReadSample(mpu6886_sample_t *sample);
+
+/*
+    Reads INT_STATUS and the sample in one 15 byte burst, which also clears the latched data ready interrupt.
+    return ESP_ERR_NOT_FOUND if no new sample was ready; raw is filled either way
+*/
+esp_err_t MPU6886_ReadNewSample(mpu6886_raw_sample_t *raw);
+
+// Decode count 14 byte frames in output register order, as read from ACCEL_XOUT_H or drained from the FIFO
+void MPU6886_DecodeFrames(const uint8_t *frames, size_t count, mpu6886_raw_sample_t *raw);
+
+// Scale count samples with the current full scale ranges and calibration
+void MPU6886_ScaleSamples(const mpu6886_raw_sample_t *raw, size_t count, mpu6886_sample_t *samples);
+
+// Scale values in raw counts, e.g. the mean of several samples, whose fractions of an LSB are kept
+void MPU6886_ScaleCounts(const float *accel, float temp, const float *gyro, mpu6886_sample_t *sample);
+
+// The current full scale ranges and calibration as per channel gains and offsets for MPU6886_BatchConvert
+void MPU6886_GetConversion(mpu6886_conversion_t *conversion);
+
+// No correction: zero offsets and bias, unit scales
+void MPU6886_DefaultCalibration(mpu6886_calibration_t *calibration);
+
+void MPU6886_SetCalibration(const mpu6886_calibration_t *calibration);
+
+void MPU6886_GetCalibration(mpu6886_calibration_t *calibration);
+
+/*
+    Queue the 14 byte accel/temp/gyro read on transaction;
+    after it ran, MPU6886_GetSample returns the scaled sample
+*/
+esp_err_t MPU6886_AddSampleOps(i2c_transaction_t *transaction);
+
+void MPU6886_GetSample(mpu6886_sample_t *sample);
+
+/*
+    FIFO streaming. The sensor queues one frame per sample in its 1 KB FIFO and MPU6886_FifoRead drains
+    whole frames in bursts, so 200 Hz - 1 kHz data costs one transfer per drain instead of one per sample.
+
+    odr_hz is rounded to 1 kHz / (1 + SMPLRT_DIV), 4 Hz - 1 kHz. MPU6886_FifoRead reads the frame count
+    only and returns no samples until watermark frames are queued, at most MPU6886_FIFO_MAX_WATERMARK.
+    MPU6886_FifoStart returns ESP_ERR_INVALID_STATE while the wake on motion mode runs.
+    Samples are timestamped from the start of the FIFO and the sample period. A FIFO that filled up has lost
+    frames and is out of step with the frame boundaries: it is reset, counted as an overflow, and the
+    timestamps after it restart from the reset, leaving a gap.
+*/
+
+typedef struct {
+    uint32_t frames;
+    uint32_t drains;                // FifoRead calls that read frames
+    uint32_t overflows;
+} mpu6886_fifo_stats_t;
+
+esp_err_t MPU6886_FifoStart(uint16_t odr_hz, uint8_t watermark);
+
+// Stops queueing frames and restores the sample rate divider used before MPU6886_FifoStart
+void MPU6886_FifoStop(void);
+
+uint8_t MPU6886_FifoRunning(void);
+
+uint32_t MPU6886_FifoPeriodUs(void);
+
+/*
+    Read up to max_samples queued frames; *count is set to the number read.
+    Sample i was taken at *timestamp_us + i * MPU6886_FifoPeriodUs().
+    ESP_ERR_INVALID_STATE if the FIFO is not running.
+*/
+esp_err_t MPU6886_FifoRead(mpu6886_raw_sample_t *samples, size_t max_samples, size_t *count, int64_t *timestamp_us);
+
+// MPU6886_FifoRead without decoding: the frames as drained, MPU6886_FIFO_FRAME_SIZE bytes each, for MPU6886_BatchConvert
+esp_err_t MPU6886_FifoReadFrames(uint8_t *frames, size_t max_frames, size_t *count, int64_t *timestamp_us);
+
+void MPU6886_FifoGetStats(mpu6886_fifo_stats_t *stats);
+
+/*
+    Wake on motion. The gyro goes to standby and the accelerometer cycles in low power mode at odr_hz, compares
+    each sample with the previous one and latches INT, in place of data ready, when an axis changed by more than
+    threshold_mg (4 mg steps, up to 1020 mg).
+    MPU6886_WakeOnMotionStop returns to full power sampling at the rate used before; the gyro needs about
+    35 ms before its outputs are valid again.
+    ESP_ERR_INVALID_STATE while the FIFO is running.
+*/
+esp_err_t MPU6886_WakeOnMotionStart(uint16_t threshold_mg, uint16_t odr_hz);
+
+esp_err_t MPU6886_WakeOnMotionStop(void);
+
+uint8_t MPU6886_WakeOnMotionRunning(void);
+
+/*
+    Reads INT_STATUS, which also clears the latched interrupt.
+    return 1 when an axis exceeded the wake on motion threshold
+*/
+uint8_t MPU6886_IsMotionDetected(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,41 @@
+#include "mpu6886_batch.h"
+
+void MPU6886_BatchUnpack(const uint8_t *frames, size_t count, int16_t *const columns[MPU6886_BATCH_CHANNELS]) {
+    for (int channel = 0; channel < MPU6886_BATCH_CHANNELS; channel++) {
+        int16_t *__restrict out = columns[channel];
+        if (out == NULL) {
+            continue;
+        }
+        const uint8_t *__restrict in = frames + 2 * channel;
+        for (size_t i = 0; i < count; i++, in += MPU6886_BATCH_FRAME_SIZE) {
+            out[i] = (int16_t)(((uint16_t)in[0] << 8) | in[1]);
+        }
+    }
+}
+
+void MPU6886_BatchScale(const int16_t *raw, size_t count, float gain, float offset, float *out) {
+    const int16_t *__restrict in = raw;
+    float *__restrict result = out;
+#pragma GCC unroll 4
+    for (size_t i = 0; i < count; i++) {
+        result[i] = (float)in[i] * gain - offset;
+    }
+}
+
+void MPU6886_BatchConvert(const uint8_t *frames, size_t count, const mpu6886_conversion_t *conversion, float *const columns[MPU6886_BATCH_CHANNELS]) {
+    int16_t tile[MPU6886_BATCH_CHANNELS][MPU6886_BATCH_TILE];
+    int16_t *unpacked[MPU6886_BATCH_CHANNELS];
+
+    for (int channel = 0; channel < MPU6886_BATCH_CHANNELS; channel++) {
+        unpacked[channel] = (columns[channel] != NULL) ? tile[channel] : NULL;
+    }
+    for (size_t done = 0; done < count; done += MPU6886_BATCH_TILE) {
+        size_t n = (count - done < MPU6886_BATCH_TILE) ? count - done : MPU6886_BATCH_TILE;
+        MPU6886_BatchUnpack(frames + done * MPU6886_BATCH_FRAME_SIZE, n, unpacked);
+        for (int channel = 0; channel < MPU6886_BATCH_CHANNELS; channel++) {
+            if (columns[channel] != NULL) {
+                MPU6886_BatchScale(tile[channel], n, conversion->gain[channel], conversion->offset[channel], columns[channel] + done);
+            }
+        }
+    }
+}
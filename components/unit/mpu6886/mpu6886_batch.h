@@ -0,0 +1,54 @@
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Batch conversion of raw MPU6886 frames, structure of arrays.
+
+    A frame is 14 big endian bytes in output register order (accel X/Y/Z, temperature, gyro X/Y/Z), as read
+    from ACCEL_XOUT_H or drained from the FIFO. MPU6886_BatchUnpack byte swaps frames into one int16 column per
+    channel, MPU6886_BatchScale turns a column into physical units with one multiply and one subtract per value,
+    and MPU6886_BatchConvert runs both tile by tile. Each inner loop walks one channel, so the compiler
+    vectorizes it on the host and unrolls it on the Xtensa, instead of one vector per call with its own scales.
+
+    No FreeRTOS or IDF dependency; tools/mpu6886_batch_bench.c builds the kernels on the host.
+*/
+
+#define MPU6886_BATCH_FRAME_SIZE 14
+#define MPU6886_BATCH_CHANNELS 7
+
+// Frames per tile of MPU6886_BatchConvert, the int16 columns of a tile stay on the stack
+#define MPU6886_BATCH_TILE 32
+
+typedef enum {
+    MPU6886_CHANNEL_ACCEL_X = 0,
+    MPU6886_CHANNEL_ACCEL_Y,
+    MPU6886_CHANNEL_ACCEL_Z,
+    MPU6886_CHANNEL_TEMP,
+    MPU6886_CHANNEL_GYRO_X,
+    MPU6886_CHANNEL_GYRO_Y,
+    MPU6886_CHANNEL_GYRO_Z,
+} mpu6886_channel_t;
+
+// Per channel value = raw * gain - offset: g, Celsius and dps with the resolution and calibration folded in
+typedef struct {
+    float gain[MPU6886_BATCH_CHANNELS];
+    float offset[MPU6886_BATCH_CHANNELS];
+} mpu6886_conversion_t;
+
+// Byte swap count frames into columns, indexed by mpu6886_channel_t; NULL columns are skipped
+void MPU6886_BatchUnpack(const uint8_t *frames, size_t count, int16_t *const columns[MPU6886_BATCH_CHANNELS]);
+
+void MPU6886_BatchScale(const int16_t *raw, size_t count, float gain, float offset, float *out);
+
+// Frames straight to physical units, NULL columns are skipped
+void MPU6886_BatchConvert(const uint8_t *frames, size_t count, const mpu6886_conversion_t *conversion, float *const columns[MPU6886_BATCH_CHANNELS]);
+
+#ifdef __cplusplus
+}
+#endif
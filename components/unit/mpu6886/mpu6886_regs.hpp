@@ -0,0 +1,84 @@
+#pragma once
+
+#include "regmap.hpp"
+#include "mpu6886.h"
+
+/*
+    MPU6886 register map, see regmap.hpp
+*/
+namespace mpu6886
+{
+
+using regmap::Burst;
+using regmap::Field;
+using regmap::Register;
+
+using WHO_AM_I = Register<MPU6886_WHOAMI>;
+using SMPLRT_DIV = Register<MPU6886_SMPLRT_DIV>;
+using ACCEL_WOM_X_THR = Register<MPU6886_ACCEL_WOM_X_THR>;
+using ACCEL_WOM_Y_THR = Register<MPU6886_ACCEL_WOM_Y_THR>;
+using ACCEL_WOM_Z_THR = Register<MPU6886_ACCEL_WOM_Z_THR>;
+using CONFIG = Register<MPU6886_CONFIG>;
+using GYRO_CONFIG = Register<MPU6886_GYRO_CONFIG>;
+using ACCEL_CONFIG = Register<MPU6886_ACCEL_CONFIG>;
+using ACCEL_CONFIG2 = Register<MPU6886_ACCEL_CONFIG2>;
+using FIFO_EN = Register<MPU6886_FIFO_EN>;
+using INT_PIN_CFG = Register<MPU6886_INT_PIN_CFG>;
+using INT_ENABLE = Register<MPU6886_INT_ENABLE>;
+using INT_STATUS = Register<MPU6886_INT_STATUS>;
+using USER_CTRL = Register<MPU6886_USER_CTRL>;
+using ACCEL_INTEL_CTRL = Register<MPU6886_ACCEL_INTEL_CTRL>;
+using PWR_MGMT_1 = Register<MPU6886_PWR_MGMT_1>;
+using PWR_MGMT_2 = Register<MPU6886_PWR_MGMT_2>;
+using FIFO_COUNT = Register<MPU6886_FIFO_COUNTH, 2>;
+using FIFO_R_W = Register<MPU6886_FIFO_R_W>;
+
+using ACCEL_X = Register<MPU6886_ACCEL_XOUT_H, 2, true>;
+using ACCEL_Y = Register<MPU6886_ACCEL_YOUT_H, 2, true>;
+using ACCEL_Z = Register<MPU6886_ACCEL_ZOUT_H, 2, true>;
+using TEMP = Register<MPU6886_TEMP_OUT_H, 2, true>;
+using GYRO_X = Register<MPU6886_GYRO_XOUT_H, 2, true>;
+using GYRO_Y = Register<MPU6886_GYRO_YOUT_H, 2, true>;
+using GYRO_Z = Register<MPU6886_GYRO_ZOUT_H, 2, true>;
+
+using DLPF_CFG = Field<CONFIG, 0, 3>;
+using GYRO_FS_SEL = Field<GYRO_CONFIG, 3, 2>;
+using ACCEL_FS_SEL = Field<ACCEL_CONFIG, 3, 2>;
+using DATA_RDY_INT = Field<INT_STATUS, 0, 1>;
+using WOM_INT = Field<INT_STATUS, 5, 3>;
+using DATA_RDY_INT_EN = Field<INT_ENABLE, 0, 1>;
+using WOM_INT_EN = Field<INT_ENABLE, 5, 3>;
+using GYRO_FIFO_EN = Field<FIFO_EN, 4, 1>;
+using ACCEL_FIFO_EN = Field<FIFO_EN, 3, 1>;
+using USER_FIFO_EN = Field<USER_CTRL, 6, 1>;
+using FIFO_RST = Field<USER_CTRL, 2, 1>;
+using DEVICE_RESET = Field<PWR_MGMT_1, 7, 1>;
+using CYCLE = Field<PWR_MGMT_1, 5, 1>;
+using CLKSEL = Field<PWR_MGMT_1, 0, 3>;
+using STBY_G = Field<PWR_MGMT_2, 0, 3>;
+using ACCEL_INTEL_EN = Field<ACCEL_INTEL_CTRL, 7, 1>;
+// 1 compares each sample with the previous one, 0 with the first sample after enabling
+using ACCEL_INTEL_MODE = Field<ACCEL_INTEL_CTRL, 6, 1>;
+using OUTPUT_LIMIT = Field<ACCEL_INTEL_CTRL, 1, 1>;
+
+// Sample rate, DLPF and full scale ranges, kept in the i2c_device shadow
+using ConfigBlock = Burst<SMPLRT_DIV, CONFIG, GYRO_CONFIG, ACCEL_CONFIG, ACCEL_CONFIG2>;
+
+// One threshold per axis, in 4 mg steps
+using WomThreshold = Burst<ACCEL_WOM_X_THR, ACCEL_WOM_Y_THR, ACCEL_WOM_Z_THR>;
+
+using Accel = Burst<ACCEL_X, ACCEL_Y, ACCEL_Z>;
+using Gyro = Burst<GYRO_X, GYRO_Y, GYRO_Z>;
+// Accel, temperature and gyro of one instant; one burst is cheaper than a transfer per vector
+using AccelGyro = Burst<ACCEL_X, ACCEL_Y, ACCEL_Z, TEMP, GYRO_X, GYRO_Y, GYRO_Z>;
+// INT_STATUS sits right before the outputs: the read that clears data ready also returns the sample
+using StatusAccelGyro = Burst<INT_STATUS, ACCEL_X, ACCEL_Y, ACCEL_Z, TEMP, GYRO_X, GYRO_Y, GYRO_Z>;
+
+static_assert(ConfigBlock::length == 5, "configuration registers are not contiguous");
+static_assert(AccelGyro::length == 14, "accel, temperature and gyro outputs are one block");
+static_assert(StatusAccelGyro::first == INT_STATUS::addr && StatusAccelGyro::length == 15, "INT_STATUS does not precede the outputs");
+// With accel and gyro queued, a FIFO frame has the layout of AccelGyro
+static_assert(AccelGyro::length == MPU6886_FIFO_FRAME_SIZE, "FIFO frame does not match the output registers");
+static_assert(MPU6886_BATCH_FRAME_SIZE == MPU6886_FIFO_FRAME_SIZE, "batch kernels take FIFO frames");
+
+} // namespace mpu6886
@@ -0,0 +1,261 @@
+#pragma once
+
+#include <stdint.h>
+#include <array>
+#include <type_traits>
+
+#include "i2c_device.h"
+
+/*
+    Compile-time register maps for I2C sensor drivers.
+
+    Register<Addr, Width, Signed, Order>  a value of Width bytes starting at register Addr
+    Field<Reg, Pos, Len>                  bits [Pos, Pos + Len) of a register
+    Burst<Items...>                       the smallest contiguous range covering a set of registers and fields
+
+    A Burst knows its first register, length and the offset of every item, so a driver reads the range
+    in one transfer and unpacks each item with shifts and masks fixed at build time.
+    Fields that do not fit their register, registers past 0xFF and items of a burst that overlap
+    are rejected by static_assert.
+
+        using ACCEL_Z = regmap::Register<0x3F, 2, true>;
+        using GYRO_X = regmap::Register<0x43, 2, true>;
+        using Sample = regmap::Burst<ACCEL_Z, GYRO_X>;      // 0x3F, 6 bytes
+
+        Sample::buffer_type raw;
+        regmap::read<Sample>(device, raw);
+        int16_t gx = Sample::get<GYRO_X>(raw);
+*/
+
+namespace regmap
+{
+
+enum class Order
+{
+    MsbFirst,   // big endian, the usual layout of sensor output registers
+    LsbFirst,   // little endian, e.g. the BMP280 calibration words
+};
+
+namespace detail
+{
+
+template <uint8_t Width, bool Signed> struct value_of;
+template <> struct value_of<1, false> { typedef uint8_t type; };
+template <> struct value_of<1, true> { typedef int8_t type; };
+template <> struct value_of<2, false> { typedef uint16_t type; };
+template <> struct value_of<2, true> { typedef int16_t type; };
+template <> struct value_of<3, false> { typedef uint32_t type; };
+template <> struct value_of<3, true> { typedef int32_t type; };
+template <> struct value_of<4, false> { typedef uint32_t type; };
+template <> struct value_of<4, true> { typedef int32_t type; };
+
+// Byte order is a template parameter, so load and store unroll into straight shifts
+template <uint8_t N, Order O> struct codec;
+
+struct codec_end
+{
+    static uint32_t load(const uint8_t *) { return 0; }
+    static void store(uint8_t *, uint32_t) {}
+};
+
+template <> struct codec<0, Order::MsbFirst> : codec_end {};
+template <> struct codec<0, Order::LsbFirst> : codec_end {};
+
+template <uint8_t N> struct codec<N, Order::MsbFirst>
+{
+    static uint32_t load(const uint8_t *p) { return (codec<N - 1, Order::MsbFirst>::load(p) << 8) | p[N - 1]; }
+    static void store(uint8_t *p, uint32_t v)
+    {
+        p[N - 1] = (uint8_t)v;
+        codec<N - 1, Order::MsbFirst>::store(p, v >> 8);
+    }
+};
+
+template <uint8_t N> struct codec<N, Order::LsbFirst>
+{
+    static uint32_t load(const uint8_t *p) { return (codec<N - 1, Order::LsbFirst>::load(p + 1) << 8) | p[0]; }
+    static void store(uint8_t *p, uint32_t v)
+    {
+        p[0] = (uint8_t)v;
+        codec<N - 1, Order::LsbFirst>::store(p + 1, v >> 8);
+    }
+};
+
+constexpr uint32_t mask_of(uint8_t pos, uint8_t len)
+{
+    return (len >= 32) ? 0xFFFFFFFFu : (((1u << len) - 1) << pos);
+}
+
+constexpr uint8_t min_of(uint8_t a) { return a; }
+template <typename... T> constexpr uint8_t min_of(uint8_t a, uint8_t b, T... rest)
+{
+    return min_of((a < b) ? a : b, rest...);
+}
+
+constexpr uint16_t max_of(uint16_t a) { return a; }
+template <typename... T> constexpr uint16_t max_of(uint16_t a, uint16_t b, T... rest)
+{
+    return max_of((a > b) ? a : b, rest...);
+}
+
+// Two items collide if they share bytes, except fields of one register that use different bits
+template <typename A, typename B> struct overlap
+{
+    static constexpr bool same_register = A::addr == B::addr && A::width == B::width;
+    static constexpr bool value = same_register ? ((A::mask & B::mask) != 0)
+                                                : (A::addr < B::addr + B::width && B::addr < A::addr + A::width);
+};
+
+template <typename H, typename... T> struct none_overlap;
+template <typename H> struct none_overlap<H> : std::true_type {};
+template <typename H, typename N, typename... T> struct none_overlap<H, N, T...>
+    : std::integral_constant<bool, !overlap<H, N>::value && none_overlap<H, T...>::value> {};
+
+template <typename... T> struct disjoint;
+template <> struct disjoint<> : std::true_type {};
+template <typename H, typename... T> struct disjoint<H, T...>
+    : std::integral_constant<bool, none_overlap<H, T...>::value && disjoint<T...>::value> {};
+
+template <typename T, typename... L> struct contains;
+template <typename T> struct contains<T> : std::false_type {};
+template <typename T, typename H, typename... L> struct contains<T, H, L...>
+    : std::integral_constant<bool, std::is_same<T, H>::value || contains<T, L...>::value> {};
+
+} // namespace detail
+
+template <uint8_t Addr, uint8_t Width = 1, bool Signed = false, Order O = Order::MsbFirst>
+struct Register
+{
+    static_assert(Width >= 1 && Width <= 4, "register width must be 1 to 4 bytes");
+    static_assert(Addr + Width <= 0x100, "register runs past address 0xFF");
+
+    typedef Register reg;
+    typedef typename detail::value_of<Width, Signed>::type value_type;
+    typedef typename detail::value_of<Width, false>::type raw_type;
+
+    static constexpr uint8_t addr = Addr;
+    static constexpr uint8_t width = Width;
+    static constexpr uint8_t pos = 0;
+    static constexpr uint8_t len = 8 * Width;
+    static constexpr uint32_t mask = detail::mask_of(0, 8 * Width);
+
+    static raw_type load(const uint8_t *p) { return (raw_type)detail::codec<Width, O>::load(p); }
+    static void store(uint8_t *p, raw_type raw) { detail::codec<Width, O>::store(p, raw); }
+
+    // Signed values narrower than their type are sign extended from the top bit of the register
+    static value_type get(const uint8_t *p)
+    {
+        return Signed ? (value_type)((int32_t)((uint32_t)load(p) << (32 - len)) >> (32 - len)) : (value_type)load(p);
+    }
+    static void set(uint8_t *p, value_type value) { store(p, (raw_type)value); }
+};
+
+template <typename Reg, uint8_t Pos, uint8_t Len>
+struct Field
+{
+    static_assert(Len >= 1, "empty field");
+    static_assert(Pos + Len <= Reg::len, "field does not fit its register");
+
+    typedef Reg reg;
+    typedef typename Reg::raw_type value_type;
+
+    static constexpr uint8_t addr = Reg::addr;
+    static constexpr uint8_t width = Reg::width;
+    static constexpr uint8_t pos = Pos;
+    static constexpr uint8_t len = Len;
+    static constexpr uint32_t mask = detail::mask_of(Pos, Len);
+
+    static constexpr value_type extract(value_type raw) { return (value_type)((raw & mask) >> Pos); }
+    static constexpr value_type insert(value_type raw, value_type value)
+    {
+        return (value_type)((raw & ~mask) | (((uint32_t)value << Pos) & mask));
+    }
+
+    static value_type get(const uint8_t *p) { return extract(Reg::load(p)); }
+    static void set(uint8_t *p, value_type value) { Reg::store(p, insert(Reg::load(p), value)); }
+};
+
+template <typename... Items>
+struct Burst
+{
+    static_assert(sizeof...(Items) > 0, "empty burst");
+    static_assert(detail::disjoint<Items...>::value, "registers or fields of a burst overlap");
+
+    static constexpr uint8_t first = detail::min_of(Items::addr...);
+    static constexpr uint16_t length = detail::max_of((uint16_t)(Items::addr + Items::width)...) - first;
+
+    typedef std::array<uint8_t, length> buffer_type;
+
+    template <typename T> static typename T::value_type get(const buffer_type &buffer)
+    {
+        static_assert(detail::contains<T, Items...>::value, "item is not part of this burst");
+        return T::get(buffer.data() + (T::addr - first));
+    }
+
+    template <typename T> static void set(buffer_type &buffer, typename T::value_type value)
+    {
+        static_assert(detail::contains<T, Items...>::value, "item is not part of this burst");
+        T::set(buffer.data() + (T::addr - first), value);
+    }
+
+    // Data with the layout of the burst that was not read from its registers, e.g. a FIFO frame
+    template <typename T> static typename T::value_type get(const uint8_t *data)
+    {
+        static_assert(detail::contains<T, Items...>::value, "item is not part of this burst");
+        return T::get(data + (T::addr - first));
+    }
+};
+
+/*
+    Bus access
+*/
+
+template <typename B> esp_err_t read(I2CDevice_t device, typename B::buffer_type &buffer)
+{
+    return i2c_read_bytes(device, B::first, buffer.data(), B::length);
+}
+
+template <typename B> esp_err_t add_read(i2c_transaction_t *transaction, I2CDevice_t device, typename B::buffer_type &buffer)
+{
+    return i2c_transaction_add_read_reg(transaction, device, B::first, buffer.data(), B::length);
+}
+
+template <typename B> esp_err_t write(I2CDevice_t device, typename B::buffer_type &buffer)
+{
+    return i2c_write_bytes(device, B::first, buffer.data(), B::length);
+}
+
+namespace detail
+{
+
+template <typename T> esp_err_t write_one(I2CDevice_t device, uint8_t value, std::true_type)
+{
+    return i2c_write_byte(device, T::addr, value);
+}
+
+template <typename T> esp_err_t write_one(I2CDevice_t device, uint8_t value, std::false_type)
+{
+    return i2c_write_bits(device, T::addr, value, T::pos, T::len);
+}
+
+} // namespace detail
+
+// Write a one byte register or a field of one; a whole byte is written without reading it first
+template <typename T> esp_err_t write(I2CDevice_t device, uint8_t value)
+{
+    static_assert(T::width == 1, "single writes go to one byte registers");
+    return detail::write_one<T>(device, value, std::integral_constant<bool, T::len == 8>());
+}
+
+template <typename T> esp_err_t read(I2CDevice_t device, typename T::value_type *value)
+{
+    uint8_t raw[T::width];
+    esp_err_t err = i2c_read_bytes(device, T::addr, raw, T::width);
+    if (err == ESP_OK)
+    {
+        *value = T::get(raw);
+    }
+    return err;
+}
+
+} // namespace regmap
@@ -22,6 +22,16 @@
 #include "nvs_flash.h"
 #include "pnp_m5stack.h"
 #include "m5go.h"
+#include "i2c_async.h"
+#include "imu_sampler.h"
+#include "imu_fusion.h"
+#include "imu_activity.h"
+#include "imu_calibration.h"
+#include "imu_events.h"
+#include "imu_capture.h"
+#ifdef I2C_DEVICE_SIMULATION
+#include "i2c_sim.h"
+#endif
 #include "netconf.h"
 #define LGFX_M5STACK
 #include <LovyanGFX.hpp>
@@ -190,14 +200,66 @@ extern "C" void app_main()
             lcd.printf("Initialize wifi...\r\n");
             initialise_wifi();
             lcd.printf("Initialize sensor...\r\n");
+#ifdef I2C_DEVICE_SIMULATION
+            i2c_sim_config_t simConfig;
+            i2c_sim_default_config(&simConfig);
+            i2c_sim_install(&simConfig);
+            lcd.printf("Using simulated I2C sensors\r\n");
+#endif
 
             m5go_Sk6812_Init();
             m5go_Angle_Init();
-            MPU6886_Init();
             m5go_Motion_Init();
-            bmp280_init();
-            bmp280_set_work_mode(BMP280_FORCED_MODE);
-            SHT30_Init();
+            uint8_t sensors = m5go_Sensor_Init();
+            if (sensors != M5GO_SENSOR_ALL)
+            {
+                lcd.printf("Not connected :%s%s%s\r\n", (sensors & M5GO_SENSOR_SHT30) ? "" : " SHT30", (sensors & M5GO_SENSOR_BMP280) ? "" : " BMP280",
+                           (sensors & M5GO_SENSOR_MPU6886) ? "" : " MPU6886");
+            }
+            if (i2c_async_start(I2C_NUM_1, 6, 4) != ESP_OK)
+            {
+                printf("start i2c bus task failed, sensors are read synchronously\r\n");
+            }
+            if (sensors & M5GO_SENSOR_MPU6886)
+            {
+                imu_sampler_config_t samplerConfig;
+                imu_sampler_default_config(&samplerConfig);
+                imu_fusion_config_t fusionConfig;
+                imu_fusion_default_config(&fusionConfig);
+                imu_activity_config_t activityConfig;
+                imu_activity_default_config(&activityConfig);
+                imu_detect_config_t detectConfig;
+                imu_detect_default_config(&detectConfig);
+                imu_capture_config_t captureConfig;
+                imu_capture_default_config(&captureConfig);
+                if (imu_calibration_load() != ESP_OK)
+                {
+                    printf("no imu calibration stored, run the imu calibrate command\r\n");
+                }
+                if (imu_sampler_start(&samplerConfig) != ESP_OK)
+                {
+                    printf("start imu sampler failed, the IMU is read with the other sensors\r\n");
+                }
+                else
+                {
+                    if (imu_fusion_start(&fusionConfig) != ESP_OK)
+                    {
+                        printf("start imu fusion failed, raw accel and gyro are sent\r\n");
+                    }
+                    if (imu_activity_start(&activityConfig) != ESP_OK)
+                    {
+                        printf("start imu activity failed, the IMU stays at full power\r\n");
+                    }
+                    if (imu_events_start(&detectConfig) != ESP_OK)
+                    {
+                        printf("start imu events failed, no taps, shocks or steps are detected\r\n");
+                    }
+                    if (imu_capture_start(&captureConfig) != ESP_OK)
+                    {
+                        printf("start imu capture failed, no waveforms are sent around shocks\r\n");
+                    }
+                }
+            }
             lcd.printf("Initialize sensor successfully!\r\n");
             vTaskDelay(100 / portTICK_PERIOD_MS);
 
@@ -13,11 +13,17 @@
 #include "azure_c_shared_utility/threadapi.h"
 #include "azure_c_shared_utility/xlogging.h"
 #include "m5go.h"
+#include "imu_activity.h"
+#include "imu_capture.h"
 // PnP utilities.
 #include "pnp_device_client_ll.h"
 #include "pnp_protocol.h"
-#include "pnp_protocol.h"
+#include "pnp_arena.h"
+#include "pnp_components.h"
 #include "pnp_deviceinfo_component.h"
+#include "pnp_lights_component.h"
+#include "pnp_imu_component.h"
+#include "pnp_throttle.h"
 #include "pnp_telemetries_component.h"
 
 #include "sdkconfig.h"
@@ -67,74 +73,173 @@ static const char g_dps_DefaultGlobalProvUri[] = "global.azure-devices-provision
 static unsigned int g_sleepBetweenPollsMs = 100;
 
 // Every time the main loop wakes up, on the g_sendTelemetryPollInterval(th) pass will send a telemetry message.
-// So we will send telemetry every (g_sendTelemetryPollInterval * g_sleepBetweenPollsMs) milliseconds; 60 seconds as currently configured.
+// So we will send telemetry every (g_sendTelemetryPollInterval * g_sleepBetweenPollsMs) milliseconds; 30 seconds as currently configured.
 static const int g_sendTelemetryPollInterval = 300;
 
+// While the IMU reports the device idle (nothing moved for a while) telemetry slows down to every 5 minutes.
+// Motion sends telemetry right away and returns to g_sendTelemetryPollInterval.
+static const int g_sendTelemetryIdlePollInterval = 3000;
+
 // Whether tracing at the IoTHub client is enabled or not.
 static bool g_hubClientTraceEnabled = true;
 
 // DTMI indicating this device's ModelId.
-static const char g_temperatureControllerModelId[] = "dtmi:M5Stack:m5go;1";
+static const char g_temperatureControllerModelId[] = PNP_MODEL_ID;
 
+//
+// PNP_COMPONENT_PROPERTY_ROUTE maps a component in the model to the function that applies its writable properties.
+//
+typedef void (*PnP_ComponentPropertyHandler)(const char *componentName, const char *propertyName, JSON_Value *propertyValue, int version, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClient);
 
+typedef struct PNP_COMPONENT_PROPERTY_ROUTE_TAG
+{
+    PNP_COMPONENT component;
+    PnP_ComponentPropertyHandler propertyHandler;
+} PNP_COMPONENT_PROPERTY_ROUTE;
 
-static const char g_deviceInfoComponentName[] = "deviceInformation";
+static const PNP_COMPONENT_PROPERTY_ROUTE g_componentPropertyRoutes[] = {
+    { PNP_COMPONENT_LIGHTS, PnP_LightsComponent_ProcessPropertyUpdate },
+};
 
+//
+// PNP_COMPONENT_COMMAND_ROUTE maps a component in the model to the function that executes its commands.
+//
+typedef int (*PnP_ComponentCommandHandler)(const char *componentName, const char *commandName, JSON_Value *commandValue, unsigned char **response, size_t *responseSize);
+
+typedef struct PNP_COMPONENT_COMMAND_ROUTE_TAG
+{
+    PNP_COMPONENT component;
+    PnP_ComponentCommandHandler commandHandler;
+} PNP_COMPONENT_COMMAND_ROUTE;
 
-void sendResponse(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClient, const char *propertyName, int val, int version)
+static const PNP_COMPONENT_COMMAND_ROUTE g_componentCommandRoutes[] = {
+    { PNP_COMPONENT_IMU, PnP_ImuComponent_ProcessCommand },
+};
+
+// Response returned for commands that cannot be routed.
+static const char g_commandNotFoundResponse[] = "{}";
+
+// Size of the arena that twin, command and reported property processing allocate from.  A full twin of this model fits with room
+// to spare; anything larger falls back to the heap.
+#define PNP_ARENA_SIZE (6 * 1024)
+
+static unsigned char g_pnpArenaBuffer[PNP_ARENA_SIZE];
+static PNP_ARENA g_pnpArena;
+
+//
+// PnP_TempControlComponent_ApplicationPropertyCallback is the callback function is invoked when PnP_ProcessTwinData() visits each property.
+//
+static void PnP_TempControlComponent_ApplicationPropertyCallback(const char *componentName, const char *propertyName, JSON_Value *propertyValue, int version, void *userContextCallback)
 {
-    char valString[32];
-    IOTHUB_CLIENT_RESULT iothubClientResult;
-    STRING_HANDLE jsonToSend = NULL;
+    // This sample uses the pnp_device_client.h/.c to create the IOTHUB_DEVICE_CLIENT_LL_HANDLE as well as initialize callbacks.
+    // The convention used is that IOTHUB_DEVICE_CLIENT_LL_HANDLE is passed as the userContextCallback on the initial twin callback.
+    // The pnp_protocol.h/.c pass this userContextCallback down to this visitor function.
+    IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClient = (IOTHUB_DEVICE_CLIENT_LL_HANDLE)userContextCallback;
+
+    PNP_COMPONENT component;
 
-    if (snprintf(valString, sizeof(valString), "%d", val) < 0)
+    if (componentName == NULL)
     {
-        LogError("Unable to create target temperature string for reporting result");
+        // Every writable property of this model lives on a component; anything on the root is not ours to apply.
+        LogError("Property=%s arrived for the root component, which has no writable properties", propertyName);
+        return;
     }
-    else if ((jsonToSend = PnP_CreateReportedPropertyWithStatus(NULL, propertyName, valString,
-                                                                PNP_STATUS_SUCCESS, "success", version)) == NULL)
+    else if (PnP_Components_Find(componentName, strlen(componentName), &component) == false)
     {
-        LogError("Unable to build reported property response");
+        LogError("Component=%s is not in the model", componentName);
+        return;
     }
-    else
-    {
-        const char *jsonToSendStr = STRING_c_str(jsonToSend);
-        size_t jsonToSendStrLen = strlen(jsonToSendStr);
 
-        if ((iothubClientResult = IoTHubDeviceClient_LL_SendReportedState(deviceClient, (const unsigned char *)jsonToSendStr, jsonToSendStrLen, NULL, NULL)) != IOTHUB_CLIENT_OK)
-        {
-            LogError("Unable to send reported state, error=%d", iothubClientResult);
-        }
-        else
+    for (size_t i = 0; i < sizeof(g_componentPropertyRoutes) / sizeof(g_componentPropertyRoutes[0]); i++)
+    {
+        if (g_componentPropertyRoutes[i].component == component)
         {
-            LogInfo("Sending acknowledgement of property to IoTHub");
+            g_componentPropertyRoutes[i].propertyHandler(componentName, propertyName, propertyValue, version, deviceClient);
+            return;
         }
     }
 
-    STRING_delete(jsonToSend);
+    LogError("Component=%s has no writable properties, ignoring property=%s", componentName, propertyName);
 }
+
 //
-// PnP_TempControlComponent_ApplicationPropertyCallback is the callback function is invoked when PnP_ProcessTwinData() visits each property.
+// PnP_TempControlComponent_DeviceMethodCallback is invoked by IoT SDK when a device method arrives.  Commands on a component arrive
+// as "<component>*<command>"; the component is looked up in the model and the command is handed to that component's handler.
 //
-static void PnP_TempControlComponent_ApplicationPropertyCallback(const char *componentName, const char *propertyName, JSON_Value *propertyValue, int version, void *userContextCallback)
+static int PnP_TempControlComponent_DeviceMethodCallback(const char *methodName, const unsigned char *payload, size_t size, unsigned char **response, size_t *responseSize, void *userContextCallback)
 {
-    // This sample uses the pnp_device_client.h/.c to create the IOTHUB_DEVICE_CLIENT_LL_HANDLE as well as initialize callbacks.
-    // The convention used is that IOTHUB_DEVICE_CLIENT_LL_HANDLE is passed as the userContextCallback on the initial twin callback.
-    // The pnp_protocol.h/.c pass this userContextCallback down to this visitor function.
-    IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClient = (IOTHUB_DEVICE_CLIENT_LL_HANDLE)userContextCallback;
+    (void)userContextCallback;
+
+    const unsigned char *componentName;
+    size_t componentNameSize;
+    const char *commandName;
+    char componentNameString[PNP_MAXIMUM_COMPONENT_LENGTH + 1];
+    PNP_COMPONENT component;
+    char *jsonStr = NULL;
+    JSON_Value *commandValue = NULL;
+    int result = PNP_STATUS_NOT_FOUND;
+
+    *response = NULL;
+    *responseSize = 0;
+
+    // The SDK sends a response whatever the callback returns; without budget the command is refused unprocessed, with a short body.
+    if (PnP_Throttle_TryAcquire(PNP_THROTTLE_METHOD_RESPONSE) == false)
+    {
+        LogError("Command=%s refused, the method response budget is used up", methodName);
+        return (PnP_CreateCommandResponse(response, responseSize, g_commandNotFoundResponse) == true) ? PNP_STATUS_TOO_MANY_REQUESTS : PNP_STATUS_INTERNAL_ERROR;
+    }
+
+    // Without a scope of its own the callback allocates from the active one, or the heap, and leaves it to its owner to end.
+    bool scoped = PnP_Arena_BeginScope(&g_pnpArena);
+    PnP_ParseCommandName(methodName, &componentName, &componentNameSize, &commandName);
+
+    if ((componentName == NULL) || (componentNameSize > PNP_MAXIMUM_COMPONENT_LENGTH))
+    {
+        LogError("Command=%s does not target a component of the model", methodName);
+    }
+    else if (PnP_Components_Find((const char *)componentName, componentNameSize, &component) == false)
+    {
+        LogError("Component=%.*s is not in the model", (int)componentNameSize, componentName);
+    }
+    else if ((jsonStr = PnP_CopyPayloadToString(payload, size)) == NULL)
+    {
+        LogError("Unable to allocate command payload buffer");
+        result = PNP_STATUS_INTERNAL_ERROR;
+    }
+    else if ((commandValue = json_parse_string(jsonStr)) == NULL)
+    {
+        LogError("Unable to parse command payload JSON");
+        result = PNP_STATUS_BAD_FORMAT;
+    }
+    else
+    {
+        memcpy(componentNameString, componentName, componentNameSize);
+        componentNameString[componentNameSize] = '\0';
+
+        for (size_t i = 0; i < sizeof(g_componentCommandRoutes) / sizeof(g_componentCommandRoutes[0]); i++)
+        {
+            if (g_componentCommandRoutes[i].component == component)
+            {
+                result = g_componentCommandRoutes[i].commandHandler(componentNameString, commandName, commandValue, response, responseSize);
+                break;
+            }
+        }
+    }
 
-    if (strcmp(propertyName, "LightLeft") == 0)
+    // The SDK requires a JSON body with every response, and frees it once the response is sent.
+    if ((*response == NULL) && (PnP_CreateCommandResponse(response, responseSize, g_commandNotFoundResponse) == false))
     {
-        m5go_Sk6812_SetSideColor(0, (int)json_number(propertyValue));
-        m5go_Sk6812_Show();
-        sendResponse(deviceClient, propertyName, (int)json_number(propertyValue), version);
+        result = PNP_STATUS_INTERNAL_ERROR;
     }
-    if (strcmp(propertyName, "LightRight") == 0)
+
+    json_value_free(commandValue);
+    PnP_Arena_ScopedFree(jsonStr);
+    if (scoped)
     {
-        m5go_Sk6812_SetSideColor(1, (int)json_number(propertyValue));
-        m5go_Sk6812_Show();
-        sendResponse(deviceClient, propertyName, (int)json_number(propertyValue), version);
+        PnP_Arena_EndScope();
     }
+
+    return result;
 }
 
 //
@@ -144,12 +249,18 @@ static void PnP_TempControlComponent_DeviceTwinCallback(DEVICE_TWIN_UPDATE_STATE
 {
     // Invoke PnP_ProcessTwinData to actualy process the data.  PnP_ProcessTwinData uses a visitor pattern to parse
     // the JSON and then visit each property, invoking PnP_TempControlComponent_ApplicationPropertyCallback on each element.
-    if (PnP_ProcessTwinData(updateState, payload, size, NULL, 0, PnP_TempControlComponent_ApplicationPropertyCallback, userContextCallback) == false)
+    // Everything allocated while processing, including the acknowledgements, comes from the arena and is released in one step.
+    bool scoped = PnP_Arena_BeginScope(&g_pnpArena);
+    if (PnP_ProcessTwinData(updateState, payload, size, g_pnpComponentNames, PNP_COMPONENT_COUNT, PnP_TempControlComponent_ApplicationPropertyCallback, userContextCallback) == false)
     {
         // If we're unable to parse the JSON for any reason (typically because the JSON is malformed or we ran out of memory)
         // there is no action we can take beyond logging.
         LogError("Unable to process twin json.  Ignoring any desired property update requests");
     }
+    if (scoped)
+    {
+        PnP_Arena_EndScope();
+    }
 }
 
 //
@@ -258,7 +369,7 @@ static IOTHUB_DEVICE_CLIENT_LL_HANDLE CreateDeviceClientAndAllocateComponents(vo
     IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClient = NULL;
     bool result;
 
-    g_pnpDeviceConfiguration.deviceMethodCallback = NULL;
+    g_pnpDeviceConfiguration.deviceMethodCallback = PnP_TempControlComponent_DeviceMethodCallback;
     g_pnpDeviceConfiguration.deviceTwinCallback = PnP_TempControlComponent_DeviceTwinCallback;
     g_pnpDeviceConfiguration.enableTracing = g_hubClientTraceEnabled;
     g_pnpDeviceConfiguration.modelId = g_temperatureControllerModelId;
@@ -301,6 +412,8 @@ int pnp_temperature_controller(void)
 
     IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClient = NULL;
 
+    PnP_Arena_Init(&g_pnpArena, g_pnpArenaBuffer, sizeof(g_pnpArenaBuffer));
+
     if ((deviceClient = CreateDeviceClientAndAllocateComponents()) == NULL)
     {
         LogError("Failure creating IotHub device client");
@@ -311,16 +424,32 @@ int pnp_temperature_controller(void)
         LogInfo("Successfully created device client.  Hit Control-C to exit program\n");
 
         int numberOfIterations = 0;
+        uint32_t activityTransitions = imu_activity_transitions();
+        uint8_t pir = m5go_Get_Motion();
 
         // During startup, send the non-"writeable" properties.
-        PnP_DeviceInfoComponent_Report_All_Properties(g_deviceInfoComponentName, deviceClient);
+        bool scoped = PnP_Arena_BeginScope(&g_pnpArena);
+        PnP_DeviceInfoComponent_Report_All_Properties(g_pnpComponentNames[PNP_COMPONENT_DEVICE_INFORMATION], deviceClient);
+        PnP_LightsComponent_Report_All_Properties(g_pnpComponentNames[PNP_COMPONENT_LIGHTS], deviceClient);
+        if (scoped)
+        {
+            PnP_Arena_EndScope();
+        }
         lcd.printf("Device message sent successfully!\r\n");
         lcd.printf("running!\r\n");
         while (true)
         {
             // Wake up periodically to poll.  Even if we do not plan on sending telemetry, we still need to poll periodically in order to process
             // incoming requests from the server and to do connection keep alives.
-            if ((numberOfIterations % g_sendTelemetryPollInterval) == 0)
+            imu_activity_state_t activity = imu_activity_get_state();
+            if (imu_activity_transitions() != activityTransitions)
+            {
+                // Motion is reported without waiting for the interval, going idle starts the long one from now
+                activityTransitions = imu_activity_transitions();
+                numberOfIterations = (activity == IMU_ACTIVITY_ACTIVE) ? 0 : 1;
+            }
+            int pollInterval = (activity == IMU_ACTIVITY_IDLE) ? g_sendTelemetryIdlePollInterval : g_sendTelemetryPollInterval;
+            if ((numberOfIterations % pollInterval) == 0)
             {
                 if (PnP_SendTelemetry(deviceClient))
                 {
@@ -328,6 +457,20 @@ int pnp_temperature_controller(void)
                     lcd.printf("Failure send telemetry\r\n");
                 }
             }
+            // Events go out on the pass they are detected on, not with the periodic telemetry
+            PnP_SendEvents(deviceClient);
+
+            // Someone walking up is worth the IMU waveform around it; the ring reaches back past the poll interval, unless the
+            // IMU slept, then the trigger wakes it and the window starts there
+            uint8_t pirNow = m5go_Get_Motion();
+            if (pirNow && !pir)
+            {
+                (void)imu_capture_trigger(IMU_CAPTURE_TRIGGER_PIR);
+            }
+            pir = pirNow;
+            PnP_ImuComponent_RunPending();
+            PnP_ImuComponent_SendCapture(deviceClient);
+            PnP_Throttle_Flush(deviceClient);
 
             IoTHubDeviceClient_LL_DoWork(deviceClient);
             ThreadAPI_Sleep(g_sleepBetweenPollsMs);
@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <string.h>
+
+#include "pnp_components.h"
+
+const char* g_pnpComponentNames[PNP_COMPONENT_COUNT] = PNP_COMPONENT_NAMES_INITIALIZER;
+
+const char* PnP_Components_GetName(PNP_COMPONENT component)
+{
+    if ((unsigned)component >= PNP_COMPONENT_COUNT)
+    {
+        return NULL;
+    }
+
+    return g_pnpComponentNames[component];
+}
+
+bool PnP_Components_Find(const char* componentName, size_t componentNameLength, PNP_COMPONENT* component)
+{
+    if (componentName == NULL)
+    {
+        return false;
+    }
+
+    for (int i = 0; i < PNP_COMPONENT_COUNT; i++)
+    {
+        if ((strncmp(g_pnpComponentNames[i], componentName, componentNameLength) == 0) && (g_pnpComponentNames[i][componentNameLength] == '\0'))
+        {
+            *component = (PNP_COMPONENT)i;
+            return true;
+        }
+    }
+
+    return false;
+}
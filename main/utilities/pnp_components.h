@@ -0,0 +1,33 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// This header describes the components that make up the dtmi:M5Stack:m5go;2 model, as generated from models/m5go-2.json.  The same table is handed to
+// PnP_ProcessTwinData so desired properties are routed to the right component, and is used to tag outgoing telemetry
+// with the "$.sub" message property so IoT Hub message routing can filter on the component without parsing bodies.
+
+#ifndef PNP_COMPONENTS_H
+#define PNP_COMPONENTS_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+// PNP_COMPONENT and the component names are generated from models/m5go-2.json.
+#include "pnp_m5go_model.h"
+
+//
+// g_pnpComponentNames lists the component names in the model, indexed by PNP_COMPONENT.
+//
+extern const char* g_pnpComponentNames[PNP_COMPONENT_COUNT];
+
+//
+// PnP_Components_GetName returns the name of the component in the model, or NULL if component is out of range.
+//
+const char* PnP_Components_GetName(PNP_COMPONENT component);
+
+//
+// PnP_Components_Find looks up a component by name.  The name does not need to be NULL terminated, which lets callers pass
+// the componentName returned by PnP_ParseCommandName directly.
+//
+bool PnP_Components_Find(const char* componentName, size_t componentNameLength, PNP_COMPONENT* component);
+
+#endif /* PNP_COMPONENTS_H */
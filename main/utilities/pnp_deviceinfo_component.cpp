@@ -6,6 +6,9 @@
 // PnP routines
 #include "pnp_deviceinfo_component.h"
 #include "pnp_protocol.h"
+#include "pnp_arena.h"
+#include "pnp_throttle.h"
+#include "pnp_m5go_model.h"
 
 // Core IoT SDK utilities
 #include "azure_c_shared_utility/xlogging.h"
@@ -15,24 +18,18 @@
 // The property names in this sample do not hard-code the extra quotes because the underlying PnP sample adds this to names automatically.
 #define PNP_ENCODE_STRING_FOR_JSON(str) #str
 
-static const char PnPDeviceInfo_ManufacturerPropertyName[] = "manufacturer";
+static const char PnPDeviceInfo_ManufacturerPropertyName[] = PNP_DEVICE_INFORMATION_PROPERTY_MANUFACTURER;
 static const char PnPDeviceInfo_ManufacturerPropertyValue[] = PNP_ENCODE_STRING_FOR_JSON("M5Stack");
 
-static const char PnPDeviceInfo_ProcessorArchitecturePropertyName[] = "processorArchitecture";
+static const char PnPDeviceInfo_ProcessorArchitecturePropertyName[] = PNP_DEVICE_INFORMATION_PROPERTY_PROCESSOR_ARCHITECTURE;
 static const char PnPDeviceInfo_ProcessorArchitecturePropertyValue[] = PNP_ENCODE_STRING_FOR_JSON("32-bit");
 
-static const char PnPDeviceInfo_TotalStoragePropertyName[] = "totalStorage";
+static const char PnPDeviceInfo_TotalStoragePropertyName[] = PNP_DEVICE_INFORMATION_PROPERTY_TOTAL_STORAGE;
 static const char PnPDeviceInfo_TotalStoragePropertyValue[] = "16384";
 
-static const char PnPDeviceInfo_TotalMemoryPropertyName[] = "totalMemory";
+static const char PnPDeviceInfo_TotalMemoryPropertyName[] = PNP_DEVICE_INFORMATION_PROPERTY_TOTAL_MEMORY;
 static const char PnPDeviceInfo_TotalMemoryPropertyValue[] = "520";
 
-static const char PnPDeviceInfo_LightLeftPropertyName[] = "LightLeft";
-static const char PnPDeviceInfo_LightLeftPropertyValue[] = "0";
-
-static const char PnPDeviceInfo_LightRightPropertyName[] = "LightRight";
-static const char PnPDeviceInfo_LightRightPropertyValue[] = "0";
-
 
 //
 // SendReportedPropertyForDeviceInformation sends a property as part of DeviceInfo component.
@@ -40,18 +37,18 @@ static const char PnPDeviceInfo_LightRightPropertyValue[] = "0";
 static void SendReportedPropertyForDeviceInformation(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL, const char *componentName, const char *propertyName, const char *propertyValue)
 {
     IOTHUB_CLIENT_RESULT iothubClientResult;
-    STRING_HANDLE jsonToSend = NULL;
+    char *jsonToSend = NULL;
 
-    if ((jsonToSend = PnP_CreateReportedProperty(componentName, propertyName, propertyValue)) == NULL)
+    if ((jsonToSend = PnP_FormatReportedProperty(componentName, propertyName, propertyValue)) == NULL)
     {
         LogError("Unable to build reported property response for propertyName=%s, propertyValue=%s", propertyName, propertyValue);
     }
     else
     {
-        const char *jsonToSendStr = STRING_c_str(jsonToSend);
+        const char *jsonToSendStr = jsonToSend;
         size_t jsonToSendStrLen = strlen(jsonToSendStr);
 
-        if ((iothubClientResult = IoTHubDeviceClient_LL_SendReportedState(deviceClientLL, (const unsigned char *)jsonToSendStr, jsonToSendStrLen, NULL, NULL)) != IOTHUB_CLIENT_OK)
+        if ((iothubClientResult = PnP_Throttle_SendReportedState(deviceClientLL, componentName, propertyName, (const unsigned char *)jsonToSendStr, jsonToSendStrLen, NULL, NULL)) != IOTHUB_CLIENT_OK)
         {
             LogError("Unable to send reported state for property=%s, error=%d", propertyName, iothubClientResult);
         }
@@ -61,7 +58,7 @@ static void SendReportedPropertyForDeviceInformation(IOTHUB_DEVICE_CLIENT_LL_HAN
         }
     }
 
-    STRING_delete(jsonToSend);
+    PnP_Arena_ScopedFree(jsonToSend);
 }
 
 void PnP_DeviceInfoComponent_Report_All_Properties(const char *componentName, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
@@ -70,7 +67,4 @@ void PnP_DeviceInfoComponent_Report_All_Properties(const char *componentName, IO
     SendReportedPropertyForDeviceInformation(deviceClientLL, componentName, PnPDeviceInfo_ProcessorArchitecturePropertyName, PnPDeviceInfo_ProcessorArchitecturePropertyValue);
     SendReportedPropertyForDeviceInformation(deviceClientLL, componentName, PnPDeviceInfo_TotalStoragePropertyName, PnPDeviceInfo_TotalStoragePropertyValue);
     SendReportedPropertyForDeviceInformation(deviceClientLL, componentName, PnPDeviceInfo_TotalMemoryPropertyName, PnPDeviceInfo_TotalMemoryPropertyValue);
-    SendReportedPropertyForDeviceInformation(deviceClientLL, NULL, PnPDeviceInfo_LightLeftPropertyName, PnPDeviceInfo_LightLeftPropertyValue);
-    SendReportedPropertyForDeviceInformation(deviceClientLL, NULL, PnPDeviceInfo_LightRightPropertyName, PnPDeviceInfo_LightRightPropertyValue);
-
 }
@@ -0,0 +1,459 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Standard C header files
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+#include "m5go.h"
+#include "imu_sampler.h"
+#include "imu_calibration.h"
+#include "imu_capture.h"
+// PnP routines
+#include "pnp_protocol.h"
+#include "pnp_components.h"
+#include "pnp_imu_component.h"
+#include "pnp_telemetries_component.h"
+#include "pnp_throttle.h"
+#include "pnp_m5go_model.h"
+
+// Core IoT SDK utilities
+#include "azure_c_shared_utility/xlogging.h"
+
+// Output data rate of the MPU6886 with SMPLRT_DIV = 0 and the DLPF configured by MPU6886_Init.
+#define IMU_BURST_SAMPLE_RATE_HZ 1000
+// Frames the FIFO collects before a capture drains it, 20 ms at the maximum rate.
+#define IMU_BURST_FIFO_WATERMARK 20
+// Samples taken from the FIFO per read.
+#define IMU_BURST_FIFO_READ_SAMPLES 32
+// Size of the preallocated capture buffer; at the maximum rate this holds a little over two seconds.
+#define IMU_BURST_MAX_SAMPLES 2048
+// Number of samples returned by each getBurstChunk call.
+#define IMU_BURST_CHUNK_SAMPLES 256
+// Each sample holds accel X/Y/Z then gyro X/Y/Z as raw little-endian int16.
+#define IMU_BURST_AXES 6
+// Telemetry tokens a capture leaves to the regular messages; it waits until the bucket holds more.
+#define IMU_CAPTURE_SPARE_TOKENS 2
+
+static const char g_captureBurstResponseFormat[] = "{\"samples\":%u,\"rateHz\":%d,\"chunks\":%u,\"chunkSamples\":%d,\"accelResolution\":%.9f,\"gyroResolution\":%.9f}";
+static const char g_burstChunkResponseHeaderFormat[] = "{\"index\":%u,\"samples\":%u,\"data\":\"";
+static const char g_burstChunkResponseTrailer[] = "\"}";
+static const char g_calibrateResponseFormat[] = "{\"gyroBias\":[%.4f,%.4f,%.4f],\"accelOffset\":[%.4f,%.4f,%.4f],\"accelScale\":[%.5f,%.5f,%.5f],\"accelPositions\":%d,\"step\":\"%s\",\"result\":\"%s\"}";
+static const char g_emptyCommandResponse[] = "{}";
+static const char g_captureTelemetryHeaderFormat[] = "{\"" PNP_IMU_TELEMETRY_CAPTURE "\":{\"trigger\":\"%s\",\"ageMs\":%u,\"rateHz\":%u,\"preSamples\":%u,\"samples\":%u,\"accelResolution\":%.9f,\"gyroResolution\":%.9f,\"data\":\"";
+static const char g_captureTelemetryTrailer[] = "\"}}";
+
+static const char g_base64Alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// Captures and calibrations stream the FIFO for seconds; the command queues them and the main loop runs them, one at a time.
+typedef enum IMU_JOB_TAG
+{
+    IMU_JOB_NONE = 0,
+    IMU_JOB_BURST,
+    IMU_JOB_CALIBRATE_GYRO,
+    IMU_JOB_CALIBRATE_ACCEL
+} IMU_JOB;
+
+static IMU_JOB g_imuJob;
+
+static int16_t g_burstSamples[IMU_BURST_MAX_SAMPLES][IMU_BURST_AXES];
+static size_t g_burstSampleCount;
+static size_t g_burstRequestedSamples;
+
+// Last calibrate step and its outcome, for calibrate status
+static const char *g_calibrateStep = "none";
+static const char *g_calibrateResult = "none";
+static uint8_t g_calibratePositions;
+
+//
+// Base64Encode writes the base64 encoding of data into out, which must hold ((length + 2) / 3) * 4 characters.
+//
+static size_t Base64Encode(const uint8_t *data, size_t length, char *out)
+{
+    char *start = out;
+    size_t i;
+
+    for (i = 0; i + 2 < length; i += 3)
+    {
+        uint32_t triple = ((uint32_t)data[i] << 16) | ((uint32_t)data[i + 1] << 8) | data[i + 2];
+        *out++ = g_base64Alphabet[(triple >> 18) & 0x3F];
+        *out++ = g_base64Alphabet[(triple >> 12) & 0x3F];
+        *out++ = g_base64Alphabet[(triple >> 6) & 0x3F];
+        *out++ = g_base64Alphabet[triple & 0x3F];
+    }
+
+    if (i < length)
+    {
+        uint32_t triple = (uint32_t)data[i] << 16;
+        if (i + 1 < length)
+        {
+            triple |= (uint32_t)data[i + 1] << 8;
+        }
+        *out++ = g_base64Alphabet[(triple >> 18) & 0x3F];
+        *out++ = g_base64Alphabet[(triple >> 12) & 0x3F];
+        *out++ = (i + 1 < length) ? g_base64Alphabet[(triple >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+
+    return out - start;
+}
+
+//
+// CaptureBurst streams the MPU6886 FIFO at its maximum output data rate and drains it in bursts until requestedSamples are captured.
+// The task sleeps while the FIFO fills instead of polling the sensor for every sample.
+//
+static size_t CaptureBurst(size_t requestedSamples)
+{
+    static mpu6886_raw_sample_t fifoSamples[IMU_BURST_FIFO_READ_SAMPLES];
+    // Allow twice the nominal capture time before giving up, so a stalled sensor cannot hold the command forever.
+    int64_t deadline = esp_timer_get_time() + (int64_t)requestedSamples * 2 * 1000000 / IMU_BURST_SAMPLE_RATE_HZ;
+    size_t count = 0;
+    mpu6886_fifo_stats_t before, after;
+
+    // The capture changes the sample rate, the sampler waits until it is restored
+    imu_sampler_pause();
+    if (MPU6886_FifoStart(IMU_BURST_SAMPLE_RATE_HZ, IMU_BURST_FIFO_WATERMARK) != ESP_OK)
+    {
+        LogError("Unable to start the MPU6886 FIFO");
+        imu_sampler_resume();
+        return 0;
+    }
+    MPU6886_FifoGetStats(&before);
+
+    while ((count < requestedSamples) && (esp_timer_get_time() < deadline))
+    {
+        size_t wanted = requestedSamples - count;
+        size_t read = 0;
+        int64_t timestamp;
+        (void)MPU6886_FifoRead(fifoSamples, (wanted < IMU_BURST_FIFO_READ_SAMPLES) ? wanted : IMU_BURST_FIFO_READ_SAMPLES, &read, &timestamp);
+        for (size_t i = 0; i < read; i++, count++)
+        {
+            memcpy(&g_burstSamples[count][0], fifoSamples[i].accel, sizeof(fifoSamples[i].accel));
+            memcpy(&g_burstSamples[count][3], fifoSamples[i].gyro, sizeof(fifoSamples[i].gyro));
+        }
+        if (read == 0)
+        {
+            vTaskDelay(pdMS_TO_TICKS(IMU_BURST_FIFO_WATERMARK * 1000 / IMU_BURST_SAMPLE_RATE_HZ));
+        }
+    }
+
+    MPU6886_FifoGetStats(&after);
+    MPU6886_FifoStop();
+    imu_sampler_resume();
+    if (after.overflows != before.overflows)
+    {
+        LogError("MPU6886 FIFO overflowed during the capture, samples are missing");
+    }
+    return count;
+}
+
+static int ProcessCaptureBurstCommand(JSON_Value *commandValue, unsigned char **response, size_t *responseSize)
+{
+    if ((m5go_Sensor_Present() & M5GO_SENSOR_MPU6886) == 0)
+    {
+        LogError("captureBurst needs the MPU6886, which is not connected");
+        return PNP_STATUS_NOT_FOUND;
+    }
+
+    if (json_value_get_type(commandValue) != JSONNumber)
+    {
+        LogError("captureBurst requires the number of seconds to capture");
+        return PNP_STATUS_BAD_FORMAT;
+    }
+
+    double seconds = json_value_get_number(commandValue);
+    if (!((seconds > 0) && (seconds * IMU_BURST_SAMPLE_RATE_HZ <= IMU_BURST_MAX_SAMPLES)))
+    {
+        LogError("captureBurst duration=%g s is not between 0 and the %g s the buffer holds", seconds, (double)IMU_BURST_MAX_SAMPLES / IMU_BURST_SAMPLE_RATE_HZ);
+        return PNP_STATUS_BAD_FORMAT;
+    }
+
+    if (g_imuJob != IMU_JOB_NONE)
+    {
+        LogError("captureBurst has to wait for the running %s", (g_imuJob == IMU_JOB_BURST) ? "capture" : "calibration");
+        return PNP_STATUS_CONFLICT;
+    }
+
+    size_t requestedSamples = (size_t)(seconds * IMU_BURST_SAMPLE_RATE_HZ);
+    if (requestedSamples == 0)
+    {
+        requestedSamples = 1;
+    }
+
+    // The capture runs from the main loop, getBurstChunk answers PNP_STATUS_SERVICE_UNAVAILABLE until it is done
+    g_burstSampleCount = 0;
+    g_burstRequestedSamples = requestedSamples;
+    g_imuJob = IMU_JOB_BURST;
+
+    unsigned chunks = (unsigned)((requestedSamples + IMU_BURST_CHUNK_SAMPLES - 1) / IMU_BURST_CHUNK_SAMPLES);
+    if (PnP_CreateCommandResponse(response, responseSize, g_captureBurstResponseFormat, (unsigned)requestedSamples, IMU_BURST_SAMPLE_RATE_HZ,
+                                  chunks, IMU_BURST_CHUNK_SAMPLES, MPU6886_GetAccRes(MPU6886_GetAccelFSR()), MPU6886_GetGyroRes(MPU6886_GetGyroFSR())) == false)
+    {
+        g_imuJob = IMU_JOB_NONE;
+        return PNP_STATUS_INTERNAL_ERROR;
+    }
+
+    return PNP_STATUS_SUCCESS;
+}
+
+//
+// CreateCalibrateResponse reports the calibration in use and how the last calibrate step went.
+//
+static bool CreateCalibrateResponse(unsigned char **response, size_t *responseSize)
+{
+    mpu6886_calibration_t calibration;
+    MPU6886_GetCalibration(&calibration);
+    return PnP_CreateCommandResponse(response, responseSize, g_calibrateResponseFormat, calibration.gyro_bias[0], calibration.gyro_bias[1], calibration.gyro_bias[2],
+                                     calibration.accel_offset[0], calibration.accel_offset[1], calibration.accel_offset[2], calibration.accel_scale[0],
+                                     calibration.accel_scale[1], calibration.accel_scale[2], __builtin_popcount(g_calibratePositions), g_calibrateStep,
+                                     g_calibrateResult);
+}
+
+static int ProcessCalibrateCommand(JSON_Value *commandValue, unsigned char **response, size_t *responseSize)
+{
+    if ((m5go_Sensor_Present() & M5GO_SENSOR_MPU6886) == 0)
+    {
+        LogError("calibrate needs the MPU6886, which is not connected");
+        return PNP_STATUS_NOT_FOUND;
+    }
+
+    const char *step = json_value_get_string(commandValue);
+    IMU_JOB job;
+    if (step == NULL)
+    {
+        LogError("calibrate requires the step to run");
+        return PNP_STATUS_BAD_FORMAT;
+    }
+    else if (strcmp(step, "status") == 0)
+    {
+        return CreateCalibrateResponse(response, responseSize) ? PNP_STATUS_SUCCESS : PNP_STATUS_INTERNAL_ERROR;
+    }
+    else if (strcmp(step, "gyro") == 0)
+    {
+        job = IMU_JOB_CALIBRATE_GYRO;
+    }
+    else if (strcmp(step, "accel") == 0)
+    {
+        job = IMU_JOB_CALIBRATE_ACCEL;
+    }
+    else if (strcmp(step, "reset") == 0)
+    {
+        job = IMU_JOB_NONE;
+    }
+    else
+    {
+        LogError("calibrate step=%s is not one of gyro, accel, reset or status", step);
+        return PNP_STATUS_BAD_FORMAT;
+    }
+
+    if (g_imuJob != IMU_JOB_NONE)
+    {
+        LogError("calibrate step=%s has to wait for the running %s", step, (g_imuJob == IMU_JOB_BURST) ? "capture" : "calibration");
+        return PNP_STATUS_CONFLICT;
+    }
+
+    int result = PNP_STATUS_ACCEPTED;
+    if (job == IMU_JOB_NONE)
+    {
+        // Reset only erases NVS, quick enough to answer with
+        esp_err_t err = imu_calibration_reset();
+        g_calibrateStep = "reset";
+        g_calibrateResult = (err == ESP_OK) ? "done" : "failed";
+        g_calibratePositions = 0;
+        result = (err == ESP_OK) ? PNP_STATUS_SUCCESS : PNP_STATUS_INTERNAL_ERROR;
+    }
+    else
+    {
+        // A measurement streams the FIFO for seconds, the main loop runs it; calibrate status reports the outcome
+        g_calibrateStep = (job == IMU_JOB_CALIBRATE_GYRO) ? "gyro" : "accel";
+        g_calibrateResult = "running";
+        g_imuJob = job;
+    }
+
+    if (CreateCalibrateResponse(response, responseSize) == false)
+    {
+        return PNP_STATUS_INTERNAL_ERROR;
+    }
+
+    return result;
+}
+
+static int ProcessGetBurstChunkCommand(JSON_Value *commandValue, unsigned char **response, size_t *responseSize)
+{
+    if (json_value_get_type(commandValue) != JSONNumber)
+    {
+        LogError("getBurstChunk requires the chunk index");
+        return PNP_STATUS_BAD_FORMAT;
+    }
+
+    // Range checked as a double, converting a negative, huge or NaN index is undefined; NaN fails both comparisons
+    if (g_imuJob == IMU_JOB_BURST)
+    {
+        LogError("The capture is still running, getBurstChunk can be retried shortly");
+        return PNP_STATUS_SERVICE_UNAVAILABLE;
+    }
+
+    double index = json_value_get_number(commandValue);
+    size_t chunks = (g_burstSampleCount + IMU_BURST_CHUNK_SAMPLES - 1) / IMU_BURST_CHUNK_SAMPLES;
+    if (!((index >= 0) && (index < (double)chunks)) || (floor(index) != index))
+    {
+        LogError("Chunk index=%g is not one of the %u chunks captured", index, (unsigned)chunks);
+        return PNP_STATUS_NOT_FOUND;
+    }
+    size_t firstSample = (size_t)index * IMU_BURST_CHUNK_SAMPLES;
+
+    size_t samples = g_burstSampleCount - firstSample;
+    if (samples > IMU_BURST_CHUNK_SAMPLES)
+    {
+        samples = IMU_BURST_CHUNK_SAMPLES;
+    }
+
+    // Build the response in place: header, base64 body and trailer go straight into the buffer the SDK will free.
+    char header[64];
+    int headerLength = snprintf(header, sizeof(header), g_burstChunkResponseHeaderFormat, (unsigned)index, (unsigned)samples);
+    size_t dataLength = samples * sizeof(g_burstSamples[0]);
+    size_t encodedLength = ((dataLength + 2) / 3) * 4;
+    size_t totalLength = headerLength + encodedLength + sizeof(g_burstChunkResponseTrailer) - 1;
+    char *body;
+
+    if ((headerLength < 0) || ((body = (char *)malloc(totalLength + 1)) == NULL))
+    {
+        LogError("Unable to allocate %u size chunk response", (unsigned)totalLength);
+        return PNP_STATUS_INTERNAL_ERROR;
+    }
+
+    memcpy(body, header, headerLength);
+    Base64Encode((const uint8_t *)g_burstSamples[firstSample], dataLength, body + headerLength);
+    memcpy(body + headerLength + encodedLength, g_burstChunkResponseTrailer, sizeof(g_burstChunkResponseTrailer));
+
+    *response = (unsigned char *)body;
+    *responseSize = totalLength;
+    return PNP_STATUS_SUCCESS;
+}
+
+static int ProcessTriggerCaptureCommand(unsigned char **response, size_t *responseSize)
+{
+    esp_err_t err = imu_capture_trigger(IMU_CAPTURE_TRIGGER_COMMAND);
+    if (err != ESP_OK)
+    {
+        LogError("triggerCapture needs the capture running and no capture waiting to be sent");
+        // Busy with an earlier trigger's window is a conflict to retry later, not a malformed request
+        return imu_capture_running() ? PNP_STATUS_CONFLICT : PNP_STATUS_NOT_FOUND;
+    }
+
+    if (PnP_CreateCommandResponse(response, responseSize, g_emptyCommandResponse) == false)
+    {
+        return PNP_STATUS_INTERNAL_ERROR;
+    }
+
+    return PNP_STATUS_SUCCESS;
+}
+
+int PnP_ImuComponent_ProcessCommand(const char *componentName, const char *commandName, JSON_Value *commandValue, unsigned char **response, size_t *responseSize)
+{
+    PNP_COMMAND command;
+    int result;
+
+    if (PnP_Model_FindCommand(PNP_COMPONENT_IMU, commandName, &command) == false)
+    {
+        LogError("Command=%s is not supported on component=%s", commandName, componentName);
+        result = PNP_STATUS_NOT_FOUND;
+    }
+    else if (command == PNP_COMMAND_IMU_CAPTURE_BURST)
+    {
+        result = ProcessCaptureBurstCommand(commandValue, response, responseSize);
+    }
+    else if (command == PNP_COMMAND_IMU_CALIBRATE)
+    {
+        result = ProcessCalibrateCommand(commandValue, response, responseSize);
+    }
+    else if (command == PNP_COMMAND_IMU_TRIGGER_CAPTURE)
+    {
+        result = ProcessTriggerCaptureCommand(response, responseSize);
+    }
+    else
+    {
+        result = ProcessGetBurstChunkCommand(commandValue, response, responseSize);
+    }
+
+    if ((result != PNP_STATUS_SUCCESS) && (result != PNP_STATUS_ACCEPTED) && (PnP_CreateCommandResponse(response, responseSize, g_emptyCommandResponse) == false))
+    {
+        result = PNP_STATUS_INTERNAL_ERROR;
+    }
+
+    return result;
+}
+
+void PnP_ImuComponent_RunPending(void)
+{
+    IMU_JOB job = g_imuJob;
+    if (job == IMU_JOB_BURST)
+    {
+        g_burstSampleCount = CaptureBurst(g_burstRequestedSamples);
+        LogInfo("Captured %u IMU samples at %d Hz", (unsigned)g_burstSampleCount, IMU_BURST_SAMPLE_RATE_HZ);
+    }
+    else if (job != IMU_JOB_NONE)
+    {
+        uint8_t positions = g_calibratePositions;
+        esp_err_t err = (job == IMU_JOB_CALIBRATE_GYRO) ? imu_calibration_measure_gyro() : imu_calibration_measure_accel(&positions);
+        // A measurement that completed a calibration is kept across reboots, the six accelerometer positions only once all are in
+        if ((err == ESP_OK) && ((job == IMU_JOB_CALIBRATE_GYRO) || (positions == IMU_CALIBRATION_ALL_POSITIONS)))
+        {
+            err = imu_calibration_save();
+        }
+        g_calibratePositions = positions;
+        g_calibrateResult = (err == ESP_OK) ? "done" : (err == ESP_ERR_INVALID_STATE) ? "notAtRest" : (err == ESP_ERR_INVALID_ARG) ? "notAxisAligned" : "failed";
+        if (err != ESP_OK)
+        {
+            LogError("calibrate step=%s failed: %s", g_calibrateStep, esp_err_to_name(err));
+        }
+    }
+    g_imuJob = IMU_JOB_NONE;
+}
+
+void PnP_ImuComponent_SendCapture(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
+{
+    imu_capture_window_t window;
+    if ((imu_capture_get(&window) != ESP_OK) || (PnP_Throttle_Available(PNP_THROTTLE_TELEMETRY) <= IMU_CAPTURE_SPARE_TOKENS))
+    {
+        return;
+    }
+
+    // Compress into a scratch buffer, then base64 encode it straight into the message body
+    uint8_t *encoded = (uint8_t *)malloc(IMU_CAPTURE_ENCODED_MAX(window.samples));
+    if (encoded == NULL)
+    {
+        LogError("Unable to allocate the capture encoding, trying again on the next pass");
+        return;
+    }
+    size_t encodedLength = imu_capture_encode(window.data, window.samples, encoded);
+
+    char header[320];
+    unsigned ageMs = (unsigned)((esp_timer_get_time() - window.trigger_us) / 1000);
+    int headerLength = snprintf(header, sizeof(header), g_captureTelemetryHeaderFormat, imu_capture_trigger_name(window.trigger), ageMs, (unsigned)window.rate_hz,
+                                (unsigned)window.pre_samples, (unsigned)window.samples, MPU6886_GetAccRes(MPU6886_GetAccelFSR()), MPU6886_GetGyroRes(MPU6886_GetGyroFSR()));
+    size_t base64Length = ((encodedLength + 2) / 3) * 4;
+    size_t totalLength = headerLength + base64Length + sizeof(g_captureTelemetryTrailer) - 1;
+    char *body;
+    if ((headerLength < 0) || ((size_t)headerLength >= sizeof(header)) || ((body = (char *)malloc(totalLength + 1)) == NULL))
+    {
+        LogError("Unable to allocate %u size capture message", (unsigned)totalLength);
+        free(encoded);
+        return;
+    }
+
+    memcpy(body, header, headerLength);
+    Base64Encode(encoded, encodedLength, body + headerLength);
+    memcpy(body + headerLength + base64Length, g_captureTelemetryTrailer, sizeof(g_captureTelemetryTrailer));
+    free(encoded);
+
+    LogInfo("Sending %s capture, %u samples in %u bytes instead of %u", imu_capture_trigger_name(window.trigger), (unsigned)window.samples, (unsigned)encodedLength,
+            (unsigned)(window.samples * sizeof(window.data[0])));
+    PnP_TelemetriesComponent_SendTelemetry(g_pnpComponentNames[PNP_COMPONENT_IMU], body, deviceClientLL);
+    free(body);
+    // The window is sent, or lost with a failed send; either way the ring records again
+    imu_capture_release();
+}
@@ -0,0 +1,37 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// This header implements the commands of the "imu" component of dtmi:M5Stack:m5go;2.
+//
+// captureBurst samples the MPU6886 at its maximum output data rate for the requested number of seconds into a preallocated buffer.
+// The capture is then read back with getBurstChunk, one chunk of base64 encoded samples per call, so a remote operator can debug
+// vibration issues without raising the steady-state telemetry rate.  Captures and calibrate steps take seconds, so the command
+// only queues them and PnP_ImuComponent_RunPending runs them outside of the SDK's DoWork.
+//
+// triggerCapture and the device's own triggers (a shock, a PIR edge) freeze the pre-trigger capture ring around the event;
+// PnP_ImuComponent_SendCapture then sends the window as one compressed Capture telemetry message when the telemetry budget allows.
+
+#ifndef PNP_IMU_COMPONENT_H
+#define PNP_IMU_COMPONENT_H
+
+#include "parson.h"
+#include "iothub_device_client_ll.h"
+
+//
+// PnP_ImuComponent_ProcessCommand runs commandName and builds its response.  Returns a PNP_STATUS_* code.
+//
+int PnP_ImuComponent_ProcessCommand(const char* componentName, const char* commandName, JSON_Value* commandValue, unsigned char** response, size_t* responseSize);
+
+//
+// PnP_ImuComponent_RunPending runs a queued captureBurst or calibrate measurement, blocking for its duration; call it on every
+// pass of the main loop.
+//
+void PnP_ImuComponent_RunPending(void);
+
+//
+// PnP_ImuComponent_SendCapture sends a frozen capture window, unless regular telemetry would have to wait for it; call it on every
+// pass of the main loop.
+//
+void PnP_ImuComponent_SendCapture(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL);
+
+#endif /* PNP_IMU_COMPONENT_H */
@@ -0,0 +1,106 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Standard C header files
+#include <stdio.h>
+#include <string.h>
+
+#include "m5go.h"
+// PnP routines
+#include "pnp_protocol.h"
+#include "pnp_arena.h"
+#include "pnp_throttle.h"
+#include "pnp_lights_component.h"
+#include "pnp_m5go_model.h"
+
+// Core IoT SDK utilities
+#include "azure_c_shared_utility/xlogging.h"
+
+static const char PnPLights_LightLeftPropertyName[] = PNP_LIGHTS_PROPERTY_LIGHT_LEFT;
+static const char PnPLights_LightRightPropertyName[] = PNP_LIGHTS_PROPERTY_LIGHT_RIGHT;
+static const char PnPLights_InitialPropertyValue[] = "0";
+
+//
+// SendReportedPropertyForLights acknowledges a writable property of the lights component.
+//
+static void SendReportedPropertyForLights(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL, const char *componentName, const char *propertyName, int val, int version)
+{
+    char valString[32];
+    IOTHUB_CLIENT_RESULT iothubClientResult;
+    char *jsonToSend = NULL;
+
+    if (snprintf(valString, sizeof(valString), "%d", val) < 0)
+    {
+        LogError("Unable to create %s string for reporting result", propertyName);
+    }
+    else if ((jsonToSend = PnP_FormatReportedPropertyWithStatus(componentName, propertyName, valString,
+                                                                PNP_STATUS_SUCCESS, "success", version)) == NULL)
+    {
+        LogError("Unable to build reported property response");
+    }
+    else
+    {
+        const char *jsonToSendStr = jsonToSend;
+        size_t jsonToSendStrLen = strlen(jsonToSendStr);
+
+        if ((iothubClientResult = PnP_Throttle_SendReportedState(deviceClientLL, componentName, propertyName, (const unsigned char *)jsonToSendStr, jsonToSendStrLen, NULL, NULL)) != IOTHUB_CLIENT_OK)
+        {
+            LogError("Unable to send reported state, error=%d", iothubClientResult);
+        }
+        else
+        {
+            LogInfo("Sending acknowledgement of property to IoTHub");
+        }
+    }
+
+    PnP_Arena_ScopedFree(jsonToSend);
+}
+
+void PnP_LightsComponent_ProcessPropertyUpdate(const char *componentName, const char *propertyName, JSON_Value *propertyValue, int version, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
+{
+    PNP_PROPERTY property;
+
+    if (PnP_Model_FindWritableProperty(PNP_COMPONENT_LIGHTS, propertyName, &property) == false)
+    {
+        LogError("Property=%s is not supported on component=%s", propertyName, componentName);
+        return;
+    }
+
+    uint8_t side = (property == PNP_PROPERTY_LIGHTS_LIGHT_LEFT) ? SK6812_SIDE_LEFT : SK6812_SIDE_RIGHT;
+
+    if (json_value_get_type(propertyValue) != JSONNumber)
+    {
+        LogError("Value of property=%s on component=%s is not a number", propertyName, componentName);
+        return;
+    }
+
+    int color = (int)json_value_get_number(propertyValue);
+    m5go_Sk6812_SetSideColor(side, color);
+    m5go_Sk6812_Show();
+    SendReportedPropertyForLights(deviceClientLL, componentName, propertyName, color, version);
+}
+
+void PnP_LightsComponent_Report_All_Properties(const char *componentName, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
+{
+    const char *propertyNames[] = { PnPLights_LightLeftPropertyName, PnPLights_LightRightPropertyName };
+
+    for (size_t i = 0; i < sizeof(propertyNames) / sizeof(propertyNames[0]); i++)
+    {
+        char *jsonToSend;
+        IOTHUB_CLIENT_RESULT iothubClientResult;
+
+        if ((jsonToSend = PnP_FormatReportedProperty(componentName, propertyNames[i], PnPLights_InitialPropertyValue)) == NULL)
+        {
+            LogError("Unable to build reported property for propertyName=%s", propertyNames[i]);
+            continue;
+        }
+
+        const char *jsonToSendStr = jsonToSend;
+        if ((iothubClientResult = PnP_Throttle_SendReportedState(deviceClientLL, componentName, propertyNames[i], (const unsigned char *)jsonToSendStr, strlen(jsonToSendStr), NULL, NULL)) != IOTHUB_CLIENT_OK)
+        {
+            LogError("Unable to send reported state for property=%s, error=%d", propertyNames[i], iothubClientResult);
+        }
+
+        PnP_Arena_ScopedFree(jsonToSend);
+    }
+}
@@ -0,0 +1,23 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// This header implements the "lights" component of dtmi:M5Stack:m5go;2.  The component owns the two writable properties
+// LightLeft and LightRight, which set the color of the left and right SK6812 bars.
+
+#ifndef PNP_LIGHTS_COMPONENT_H
+#define PNP_LIGHTS_COMPONENT_H
+
+#include "parson.h"
+#include "iothub_device_client_ll.h"
+
+//
+// PnP_LightsComponent_ProcessPropertyUpdate applies a desired property targeting the lights component and acknowledges it.
+//
+void PnP_LightsComponent_ProcessPropertyUpdate(const char* componentName, const char* propertyName, JSON_Value* propertyValue, int version, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL);
+
+//
+// PnP_LightsComponent_Report_All_Properties reports the initial values of the lights.
+//
+void PnP_LightsComponent_Report_All_Properties(const char* componentName, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL);
+
+#endif /* PNP_LIGHTS_COMPONENT_H */
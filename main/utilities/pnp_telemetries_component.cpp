@@ -6,10 +6,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "esp_timer.h"
 #include "m5go.h"
+#include "imu_sampler.h"
+#include "imu_fusion.h"
+#include "imu_activity.h"
+#include "imu_vibration.h"
+#include "imu_capture.h"
+#include "imu_events.h"
 // PnP routines
 #include "pnp_protocol.h"
 #include "pnp_telemetries_component.h"
+#include "pnp_components.h"
+#include "pnp_m5go_model.h"
+#include "pnp_throttle.h"
 
 // Core IoT SDK utilities
 #include "azure_c_shared_utility/xlogging.h"
@@ -19,33 +29,74 @@
 
 extern LGFX lcd;
 
+// Measuring vibration blinds the IMU sampler for a quarter second, so it is not done on every telemetry pass
+#define PNP_VIBRATION_INTERVAL_US (300 * 1000000LL)
 
-void PnP_TelemetriesComponent_SendTelemetry(const char *MessageBuffer, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
+bool PnP_TelemetriesComponent_SendTelemetry(const char *componentName, const char *MessageBuffer, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
 {
     IOTHUB_MESSAGE_HANDLE messageHandle = NULL;
-    IOTHUB_CLIENT_RESULT iothubResult;
+    IOTHUB_CLIENT_RESULT iothubResult = IOTHUB_CLIENT_ERROR;
 
     if (MessageBuffer == NULL)
     {
-        LogError("snprintf of current temperature telemetry failed");
+        LogError("snprintf of telemetry for component=%s failed", componentName);
     }
-    else if ((messageHandle = PnP_CreateTelemetryMessageHandle(NULL, MessageBuffer)) == NULL)
+    else if ((messageHandle = PnP_CreateTelemetryMessageHandle(componentName, MessageBuffer)) == NULL)
     {
         LogError("Unable to create telemetry message");
     }
-    else if ((iothubResult = IoTHubDeviceClient_LL_SendEventAsync(deviceClientLL, messageHandle, NULL, NULL)) != IOTHUB_CLIENT_OK)
+    else if ((iothubResult = PnP_Throttle_SendEventAsync(deviceClientLL, messageHandle, NULL, NULL)) != IOTHUB_CLIENT_OK)
     {
         LogError("Unable to send telemetry message, error=%d", iothubResult);
     }
 
     IoTHubMessage_Destroy(messageHandle);
+    return iothubResult == IOTHUB_CLIENT_OK;
+}
+
+//
+// Failed transfers per sensor and the slowest transfer on the shared sensor bus, to spot bad cables and slow parts.
+// A sensor taken off the bus after repeated failures is marked with '!'.
+//
+static void PnP_PrintI2CHealth(void)
+{
+    static const struct
+    {
+        char tag;
+        uint8_t address;
+    } sensors[] = { { 'S', 0x44 }, { 'B', 0x76 }, { 'M', MPU6886_ADDRESS } };
+
+    lcd.printf("I2C : %u %% busy, fail", i2c_bus_utilization(I2C_NUM_1));
+    uint32_t maxLatencyUs = 0;
+    for (size_t i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++)
+    {
+        I2CDevice_t device = i2c_bus_find_device(I2C_NUM_1, sensors[i].address);
+        i2c_device_stats_t stats;
+        if (i2c_device_get_stats(device, &stats) != ESP_OK)
+        {
+            lcd.printf(" %c-", sensors[i].tag);
+            continue;
+        }
+        lcd.printf(" %c%lu%s", sensors[i].tag, (unsigned long)(stats.nacks + stats.timeouts + stats.errors), i2c_device_quarantined(device) ? "!" : "");
+        maxLatencyUs = (stats.max_latency_us > maxLatencyUs) ? stats.max_latency_us : maxLatencyUs;
+    }
+    lcd.printf(", max %lu us\r\n", (unsigned long)maxLatencyUs);
 }
 
 uint8_t PnP_SendTelemetry(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
 {
     static int sendMun;
-    char StringBuffer[32];
-    int ret = -1;
+    // Each component's serializer has a compile-time bound, so one buffer sized for the largest covers all of them.
+    char StringBuffer[PNP_IMU_TELEMETRY_MAX_LENGTH + 1];
+    static_assert(PNP_ENVIRONMENT_TELEMETRY_MAX_LENGTH <= PNP_IMU_TELEMETRY_MAX_LENGTH, "environment telemetry does not fit");
+    static_assert(PNP_MOTION_TELEMETRY_MAX_LENGTH <= PNP_IMU_TELEMETRY_MAX_LENGTH, "motion telemetry does not fit");
+    static_assert(PNP_EVENTS_TELEMETRY_MAX_LENGTH <= PNP_IMU_TELEMETRY_MAX_LENGTH, "events telemetry does not fit");
+
+    // Sensors that are not connected are neither read nor sent
+    uint8_t sensors = m5go_Sensor_Update();
+
+    // The bus task reads the sensors while the screen is prepared
+    esp_err_t sweepResult = m5go_Sensor_SweepStart();
 
     time_t now;
     time(&now);
@@ -60,98 +111,212 @@ uint8_t PnP_SendTelemetry(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
     lcd.printf("/** %s **/\r\n", strftime_buf);
     lcd.setCursor(0, 50, lgfx::fontdata[2]);
 
-    double temp, humidity;
-    SHT30_get(&temp, &humidity);
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"Humidity\":%.02f}", humidity);
-    if (ret < 0)
+    if (sweepResult == ESP_OK)
+    {
+        sweepResult = m5go_Sensor_SweepWait(pdMS_TO_TICKS(1000));
+    }
+    if (sweepResult != ESP_OK && sweepResult != ESP_ERR_NOT_FOUND)
     {
-        return 1;
+        LogError("Sensor sweep incomplete, some values are stale");
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
 
-    double temperature, pressure;
-    bmp280_get_temperature_and_pressure(&temperature, &pressure);
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"Temperature\":%.02f}", temperature);
-    if (ret < 0)
+    // The SHT30 measures temperature and humidity, the BMP280 temperature and pressure; its temperature is preferred
+    PNP_ENVIRONMENT_TELEMETRY environment = { 0, 0, 0 };
+    uint32_t environmentFields = 0;
+    if (sensors & M5GO_SENSOR_SHT30)
     {
-        return 1;
+        SHT30_get_sample(&environment.Temperature, &environment.Humidity);
+        environmentFields |= PNP_ENVIRONMENT_TELEMETRY_FIELD_TEMPERATURE | PNP_ENVIRONMENT_TELEMETRY_FIELD_HUMIDITY;
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"Pressure\":%.02f}", pressure);
-    if (ret < 0)
+    if (sensors & M5GO_SENSOR_BMP280)
     {
-        return 1;
+        bmp280_get_sample(&environment.Temperature, &environment.Pressure);
+        environmentFields |= PNP_ENVIRONMENT_TELEMETRY_FIELD_TEMPERATURE | PNP_ENVIRONMENT_TELEMETRY_FIELD_PRESSURE;
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
-    lcd.printf("Temperature : %.02f Celsius\r\nHumidity : %.02f %% \r\nPressure : %.02f Pa \r\n", temperature, humidity, pressure);
-
-    float ax, ay, az;
-    MPU6886_GetAccelData(&ax, &ay, &az);
-    lcd.printf("Accel : (%.02f ,%.02f ,%.02f)\r\n", ax, ay, az);
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"AccelX\":%.02f}", ax);
-    if (ret < 0)
+    if (environmentFields != 0)
     {
-        return 1;
+        PnP_Environment_SerializeTelemetryFields(&environment, environmentFields, StringBuffer);
+        PnP_TelemetriesComponent_SendTelemetry(g_pnpComponentNames[PNP_COMPONENT_ENVIRONMENT], StringBuffer, deviceClientLL);
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
-
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"AccelY\":%.02f}", ay);
-    if (ret < 0)
+    if (environmentFields & PNP_ENVIRONMENT_TELEMETRY_FIELD_TEMPERATURE)
     {
-        return 1;
+        lcd.printf("Temperature : %.02f Celsius\r\n", environment.Temperature);
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
-
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"AccelZ\":%.02f}", az);
-    if (ret < 0)
+    if (environmentFields & PNP_ENVIRONMENT_TELEMETRY_FIELD_HUMIDITY)
+    {
+        lcd.printf("Humidity : %.02f %% \r\n", environment.Humidity);
+    }
+    if (environmentFields & PNP_ENVIRONMENT_TELEMETRY_FIELD_PRESSURE)
     {
-        return 1;
+        lcd.printf("Pressure : %.02f Pa \r\n", environment.Pressure);
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
 
-    float gx, gy, gz;
-    MPU6886_GetGyroData(&gx, &gy, &gz);
-    lcd.printf("Gyro : (%.02f ,%.02f ,%.02f)    \r\n", gx, gy, gz);
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"GyroX\":%.02f}", gx);
-    if (ret < 0)
+    // One sample, so accel and gyro are of the same instant; with the sampler running, the mean of every
+    // sample since the last send instead of the swept snapshot
+    mpu6886_sample_t sample;
+    bool imuValid = (sensors & M5GO_SENSOR_MPU6886) != 0;
+    bool sampleValid = imuValid;
+    if (imuValid && !imu_sampler_running())
+    {
+        MPU6886_GetSample(&sample);
+    }
+    else if (imuValid && imu_sampler_get_average(&sample) == 0)
+    {
+        // Nothing is sampled while asleep in wake on motion; the device is at rest, so the last attitude still holds
+        sampleValid = false;
+        imuValid = imu_sampler_sleeping() && imu_fusion_running();
+    }
+    // While the fusion runs only the attitude is uploaded; raw vectors this far apart say little about orientation
+    imu_attitude_t attitude;
+    PNP_IMU_TELEMETRY imu = {};
+    uint32_t imuFields = 0;
+    if (imuValid && imu_fusion_running() && imu_fusion_get_attitude(&attitude) == ESP_OK)
     {
-        return 1;
+        imu.QuatW = attitude.q.w;
+        imu.QuatX = attitude.q.x;
+        imu.QuatY = attitude.q.y;
+        imu.QuatZ = attitude.q.z;
+        imu.Roll = attitude.roll;
+        imu.Pitch = attitude.pitch;
+        imu.Yaw = attitude.yaw;
+        imuFields = PNP_IMU_TELEMETRY_FIELD_QUAT_W | PNP_IMU_TELEMETRY_FIELD_QUAT_X | PNP_IMU_TELEMETRY_FIELD_QUAT_Y | PNP_IMU_TELEMETRY_FIELD_QUAT_Z |
+                    PNP_IMU_TELEMETRY_FIELD_ROLL | PNP_IMU_TELEMETRY_FIELD_PITCH | PNP_IMU_TELEMETRY_FIELD_YAW;
+        lcd.printf("Attitude : (%.01f ,%.01f ,%.01f) deg\r\n", attitude.roll, attitude.pitch, attitude.yaw);
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"GyroY\":%.02f}", gy);
-    if (ret < 0)
+    else if (sampleValid)
     {
-        return 1;
+        imu.AccelX = sample.accel[0];
+        imu.AccelY = sample.accel[1];
+        imu.AccelZ = sample.accel[2];
+        imu.GyroX = sample.gyro[0];
+        imu.GyroY = sample.gyro[1];
+        imu.GyroZ = sample.gyro[2];
+        imuFields = PNP_IMU_TELEMETRY_FIELD_ACCEL_X | PNP_IMU_TELEMETRY_FIELD_ACCEL_Y | PNP_IMU_TELEMETRY_FIELD_ACCEL_Z | PNP_IMU_TELEMETRY_FIELD_GYRO_X |
+                    PNP_IMU_TELEMETRY_FIELD_GYRO_Y | PNP_IMU_TELEMETRY_FIELD_GYRO_Z;
+        lcd.printf("Accel : (%.02f ,%.02f ,%.02f)\r\n", sample.accel[0], sample.accel[1], sample.accel[2]);
+        lcd.printf("Gyro : (%.02f ,%.02f ,%.02f)    \r\n", sample.gyro[0], sample.gyro[1], sample.gyro[2]);
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"GyroZ\":%.02f}", gz);
-    if (ret < 0)
+
+    // The vibration window needs the sensor awake; asleep in wake on motion nothing vibrates above its threshold anyway.
+    // It waits for its interval, and while the capture is armed also for a held window or a gap, so no trigger loses its
+    // pre-trigger samples to it.
+    static int64_t vibrationUs;
+    bool vibrationDue = (vibrationUs == 0) || (esp_timer_get_time() - vibrationUs >= PNP_VIBRATION_INTERVAL_US);
+    imu_vibration_t vibration;
+    if ((sensors & M5GO_SENSOR_MPU6886) && vibrationDue && !imu_sampler_sleeping() && !imu_capture_has_history() &&
+        imu_vibration_measure(&vibration) == ESP_OK)
     {
-        return 1;
+        vibrationUs = esp_timer_get_time();
+        // Telemetry doubles carry two decimals, mg and mg^2 keep small vibrations from rounding to zero
+        imu.VibrationRms = vibration.features.rms * 1e3;
+        imu.VibrationPeak = vibration.features.peak_hz;
+        imu.VibrationBand0 = vibration.features.band_energy[0] * 1e6;
+        imu.VibrationBand1 = vibration.features.band_energy[1] * 1e6;
+        imu.VibrationBand2 = vibration.features.band_energy[2] * 1e6;
+        imu.VibrationBand3 = vibration.features.band_energy[3] * 1e6;
+        imu.VibrationBand4 = vibration.features.band_energy[4] * 1e6;
+        imu.VibrationBand5 = vibration.features.band_energy[5] * 1e6;
+        imu.VibrationBand6 = vibration.features.band_energy[6] * 1e6;
+        imu.VibrationBand7 = vibration.features.band_energy[7] * 1e6;
+        imuFields |= PNP_IMU_TELEMETRY_FIELD_VIBRATION_RMS | PNP_IMU_TELEMETRY_FIELD_VIBRATION_PEAK | PNP_IMU_TELEMETRY_FIELD_VIBRATION_BAND0 |
+                     PNP_IMU_TELEMETRY_FIELD_VIBRATION_BAND1 | PNP_IMU_TELEMETRY_FIELD_VIBRATION_BAND2 | PNP_IMU_TELEMETRY_FIELD_VIBRATION_BAND3 |
+                     PNP_IMU_TELEMETRY_FIELD_VIBRATION_BAND4 | PNP_IMU_TELEMETRY_FIELD_VIBRATION_BAND5 | PNP_IMU_TELEMETRY_FIELD_VIBRATION_BAND6 |
+                     PNP_IMU_TELEMETRY_FIELD_VIBRATION_BAND7;
+        lcd.printf("Vibration : %.03f g, peak %.0f Hz\r\n", vibration.features.rms, vibration.features.peak_hz);
+        imu_vibration_stats_t vibrationStats;
+        imu_vibration_get_stats(&vibrationStats);
+        LogInfo("Vibration window captured in %u us, analyzed in %u us; IMU blind %lu times, %lu ms in all", (unsigned)vibration.capture_us,
+                (unsigned)vibration.analysis_us, (unsigned long)vibrationStats.windows, (unsigned long)(vibrationStats.blind_us / 1000));
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
+    static_assert(IMU_SPECTRUM_BANDS == 8, "one VibrationBand telemetry per spectrum band");
 
-    uint8_t angle = m5go_Get_Angle();
-    ret = snprintf(StringBuffer, sizeof(StringBuffer), "{\"angle\":%d}", angle);
-    if (ret < 0)
+    if (imuFields != 0)
     {
-        return 1;
+        PnP_Imu_SerializeTelemetryFields(&imu, imuFields, StringBuffer);
+        PnP_TelemetriesComponent_SendTelemetry(g_pnpComponentNames[PNP_COMPONENT_IMU], StringBuffer, deviceClientLL);
     }
-    PnP_TelemetriesComponent_SendTelemetry(StringBuffer, deviceClientLL);
-    lcd.printf("Angle : %d / 100\r\n", angle);
 
-    if (m5go_Get_Motion())
+    if (sensors != M5GO_SENSOR_ALL)
+    {
+        lcd.printf("Not connected :%s%s%s\r\n", (sensors & M5GO_SENSOR_SHT30) ? "" : " SHT30", (sensors & M5GO_SENSOR_BMP280) ? "" : " BMP280",
+                   (sensors & M5GO_SENSOR_MPU6886) ? "" : " MPU6886");
+    }
+    if (imu_activity_running())
     {
-        PnP_TelemetriesComponent_SendTelemetry("{\"pir\":\"true}\"", deviceClientLL);
-        lcd.printf("PIR : true\r\n");
+        lcd.printf("Activity : %s\r\n", (imu_activity_get_state() == IMU_ACTIVITY_IDLE) ? "idle" : "active");
     }
-    else
+    if (imu_events_running())
     {
-        PnP_TelemetriesComponent_SendTelemetry("{\"pir\":\"false\"}", deviceClientLL);
-        lcd.printf("PIR : False\r\n");
+        // Steps come too often for a message each, the count goes with the periodic telemetry when it moved
+        static uint32_t sentSteps;
+        PNP_EVENTS_TELEMETRY events = {};
+        events.Steps = (int32_t)imu_events_steps();
+        if ((uint32_t)events.Steps != sentSteps)
+        {
+            // A dropped count goes out with the next telemetry
+            PnP_Events_SerializeTelemetryFields(&events, PNP_EVENTS_TELEMETRY_FIELD_STEPS, StringBuffer);
+            if (PnP_TelemetriesComponent_SendTelemetry(g_pnpComponentNames[PNP_COMPONENT_EVENTS], StringBuffer, deviceClientLL))
+            {
+                sentSteps = (uint32_t)events.Steps;
+            }
+        }
+        imu_events_stats_t stats;
+        imu_events_get_stats(&stats);
+        lcd.printf("Events : %lu, steps %ld, %.01f us / sample\r\n", (unsigned long)stats.events, (long)events.Steps,
+                   stats.samples ? (double)stats.cpu_us_total / stats.samples : 0.0);
     }
 
+    PNP_MOTION_TELEMETRY motion;
+    motion.angle = m5go_Get_Angle();
+    motion.pir = m5go_Get_Motion() != 0;
+    PnP_Motion_SerializeTelemetry(&motion, StringBuffer);
+    PnP_TelemetriesComponent_SendTelemetry(g_pnpComponentNames[PNP_COMPONENT_MOTION], StringBuffer, deviceClientLL);
+    lcd.printf("Angle : %d / 100\r\n", (int)motion.angle);
+    lcd.printf("PIR : %s\r\n", motion.pir ? "true" : "False");
+
+    PNP_THROTTLE_METRICS throttleMetrics;
+    PnP_Throttle_GetMetrics(PNP_THROTTLE_TELEMETRY, &throttleMetrics);
     lcd.printf("Telemetry number of sends : %d\r\n", ++sendMun);
+    lcd.printf("Throttled : %lu, deferred %lu of %lu sends\r\n", (unsigned long)throttleMetrics.throttledOperations,
+               (unsigned long)throttleMetrics.deferredOperations, (unsigned long)throttleMetrics.operations);
+    PnP_Throttle_GetMetrics(PNP_THROTTLE_REPORTED_STATE, &throttleMetrics);
+    lcd.printf("Reported : %lu deferred, max wait %lu ms\r\n", (unsigned long)throttleMetrics.deferredOperations, (unsigned long)throttleMetrics.maxWaitMs);
+    PnP_PrintI2CHealth();
 
     return 0;
 }
+
+void PnP_SendEvents(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
+{
+    char StringBuffer[PNP_EVENTS_TELEMETRY_MAX_LENGTH + 1];
+    imu_event_t event;
+
+    // Events wait in their queue for the telemetry budget to refill instead of being dropped
+    while ((PnP_Throttle_Available(PNP_THROTTLE_TELEMETRY) > 0) && (imu_events_receive(&event) == ESP_OK))
+    {
+        PNP_EVENTS_TELEMETRY events = {};
+        uint32_t fields = PNP_EVENTS_TELEMETRY_FIELD_LATENCY;
+        events.Latency = (int32_t)((event.detected_us - event.timestamp_us) / 1000);
+        switch (event.type)
+        {
+        case IMU_EVENT_TAP:
+        case IMU_EVENT_DOUBLE_TAP:
+            events.Tap = (event.type == IMU_EVENT_DOUBLE_TAP) ? 2 : 1;
+            fields |= PNP_EVENTS_TELEMETRY_FIELD_TAP;
+            break;
+        case IMU_EVENT_SHOCK:
+            events.Shock = event.value;
+            fields |= PNP_EVENTS_TELEMETRY_FIELD_SHOCK;
+            break;
+        case IMU_EVENT_FREE_FALL:
+            events.FreeFall = event.value;
+            fields |= PNP_EVENTS_TELEMETRY_FIELD_FREE_FALL;
+            break;
+        default:
+            continue;
+        }
+        LogInfo("IMU event %s, %.2f", imu_detect_event_name(event.type), event.value);
+        PnP_Events_SerializeTelemetryFields(&events, fields, StringBuffer);
+        PnP_TelemetriesComponent_SendTelemetry(g_pnpComponentNames[PNP_COMPONENT_EVENTS], StringBuffer, deviceClientLL);
+    }
+}
@@ -17,6 +17,17 @@
 #include "parson.h"
 #include "iothub_device_client_ll.h"
 
+//
+// PnP_TelemetriesComponent_SendTelemetry sends MessageBuffer as a telemetry message.  When componentName is not NULL the message
+// is tagged with the "$.sub" property so the hub attributes it to that component.  Returns false if the message was not sent,
+// including when the telemetry budget is used up.
+//
+bool PnP_TelemetriesComponent_SendTelemetry(const char* componentName, const char* MessageBuffer, IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL);
 
 uint8_t PnP_SendTelemetry(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL);
+
+//
+// PnP_SendEvents sends one message per IMU event detected since the previous call; call it on every pass of the main loop.
+//
+void PnP_SendEvents(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL);
 #endif /* PNP_TELEMETRIES_CONTROLLER_H */
@@ -0,0 +1,312 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_timer.h"
+
+#include "pnp_protocol.h"
+#include "pnp_throttle.h"
+
+// Core IoT SDK utilities
+#include "azure_c_shared_utility/xlogging.h"
+
+// Tokens are kept in millionths so that slow refill rates still accumulate between short polls.
+#define PNP_THROTTLE_TOKEN_SCALE 1000000LL
+#define PNP_THROTTLE_US_PER_MINUTE 60000000LL
+// Reported state waiting for a token; the model has six reported properties.
+#define PNP_THROTTLE_REPORTED_STATE_QUEUE_LENGTH 8
+#define PNP_THROTTLE_PROPERTY_KEY_LENGTH (2 * PNP_MAXIMUM_COMPONENT_LENGTH + 2)
+// Smoothed telemetry waiting for a token; one telemetry pass sends about this many messages.
+#define PNP_THROTTLE_TELEMETRY_QUEUE_LENGTH 8
+
+typedef struct PNP_THROTTLE_BUCKET_TAG
+{
+    PNP_THROTTLE_BUDGET budget;
+    int64_t tokens;
+    int64_t lastRefillUs;
+    PNP_THROTTLE_METRICS metrics;
+} PNP_THROTTLE_BUCKET;
+
+typedef struct PNP_THROTTLE_QUEUED_REPORT_TAG
+{
+    // "component/property", empty for a report that is never replaced.
+    char key[PNP_THROTTLE_PROPERTY_KEY_LENGTH];
+    unsigned char *reportedState;
+    size_t size;
+    IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback;
+    void *userContextCallback;
+    // When the property was first deferred; a replacing report keeps it, the property has waited since.
+    int64_t queuedUs;
+} PNP_THROTTLE_QUEUED_REPORT;
+
+typedef struct PNP_THROTTLE_QUEUED_EVENT_TAG
+{
+    IOTHUB_MESSAGE_HANDLE messageHandle;
+    IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback;
+    void *userContextCallback;
+    int64_t queuedUs;
+} PNP_THROTTLE_QUEUED_EVENT;
+
+static PNP_THROTTLE_QUEUED_REPORT g_reportedStateQueue[PNP_THROTTLE_REPORTED_STATE_QUEUE_LENGTH];
+static size_t g_reportedStateCount;
+static PNP_THROTTLE_QUEUED_EVENT g_telemetryQueue[PNP_THROTTLE_TELEMETRY_QUEUE_LENGTH];
+static size_t g_telemetryCount;
+
+// Default budgets stay well inside the per-device share of an S1 hub unit, and leave headroom for the SDK's own twin traffic.
+// Reported state is smoothed: it is always deferred, so a burst of twin updates costs nothing but a short delay.
+static PNP_THROTTLE_BUCKET g_throttleBuckets[PNP_THROTTLE_CLASS_COUNT] = {
+    { { 60, 10, false }, 10 * PNP_THROTTLE_TOKEN_SCALE, 0, { 0, 0, 0, 0, 0 } },
+    { { 30, 10, true }, 1 * PNP_THROTTLE_TOKEN_SCALE, 0, { 0, 0, 0, 0, 0 } },
+    { { 60, 5, false }, 5 * PNP_THROTTLE_TOKEN_SCALE, 0, { 0, 0, 0, 0, 0 } },
+};
+
+static int64_t GetCapacity(const PNP_THROTTLE_BUCKET *bucket)
+{
+    uint32_t burst = (bucket->budget.smoothing || (bucket->budget.burst == 0)) ? 1 : bucket->budget.burst;
+    return (int64_t)burst * PNP_THROTTLE_TOKEN_SCALE;
+}
+
+static void Refill(PNP_THROTTLE_BUCKET *bucket, int64_t nowUs)
+{
+    if (bucket->lastRefillUs == 0)
+    {
+        bucket->lastRefillUs = nowUs;
+        return;
+    }
+
+    int64_t elapsedUs = nowUs - bucket->lastRefillUs;
+    bucket->lastRefillUs = nowUs;
+    // PNP_THROTTLE_TOKEN_SCALE / PNP_THROTTLE_US_PER_MINUTE reduces to 1 / 60, which keeps the product far from overflow.
+    bucket->tokens += elapsedUs * bucket->budget.ratePerMinute / 60;
+
+    int64_t capacity = GetCapacity(bucket);
+    if (bucket->tokens > capacity)
+    {
+        bucket->tokens = capacity;
+    }
+}
+
+// Takes a token without counting an operation; deferred operations were counted when they were queued.
+static bool Acquire(PNP_THROTTLE_BUCKET *bucket)
+{
+    // A zero rate disables throttling for the class.
+    if (bucket->budget.ratePerMinute == 0)
+    {
+        return true;
+    }
+
+    Refill(bucket, esp_timer_get_time());
+    if (bucket->tokens < PNP_THROTTLE_TOKEN_SCALE)
+    {
+        return false;
+    }
+
+    bucket->tokens -= PNP_THROTTLE_TOKEN_SCALE;
+    return true;
+}
+
+static void RecordWait(PNP_THROTTLE_BUCKET *bucket, int64_t queuedUs)
+{
+    uint32_t waitMs = (uint32_t)((esp_timer_get_time() - queuedUs) / 1000);
+    bucket->metrics.totalWaitMs += waitMs;
+    if (waitMs > bucket->metrics.maxWaitMs)
+    {
+        bucket->metrics.maxWaitMs = waitMs;
+    }
+}
+
+void PnP_Throttle_Configure(PNP_THROTTLE_CLASS throttleClass, const PNP_THROTTLE_BUDGET *budget)
+{
+    if (((unsigned)throttleClass >= PNP_THROTTLE_CLASS_COUNT) || (budget == NULL))
+    {
+        return;
+    }
+
+    PNP_THROTTLE_BUCKET *bucket = &g_throttleBuckets[throttleClass];
+    bucket->budget = *budget;
+    bucket->tokens = GetCapacity(bucket);
+    bucket->lastRefillUs = 0;
+}
+
+bool PnP_Throttle_TryAcquire(PNP_THROTTLE_CLASS throttleClass)
+{
+    if ((unsigned)throttleClass >= PNP_THROTTLE_CLASS_COUNT)
+    {
+        return true;
+    }
+
+    PNP_THROTTLE_BUCKET *bucket = &g_throttleBuckets[throttleClass];
+    bucket->metrics.operations++;
+    if (Acquire(bucket) == false)
+    {
+        bucket->metrics.throttledOperations++;
+        return false;
+    }
+    return true;
+}
+
+uint32_t PnP_Throttle_Available(PNP_THROTTLE_CLASS throttleClass)
+{
+    if ((unsigned)throttleClass >= PNP_THROTTLE_CLASS_COUNT)
+    {
+        return 0;
+    }
+
+    PNP_THROTTLE_BUCKET *bucket = &g_throttleBuckets[throttleClass];
+    if (bucket->budget.ratePerMinute == 0)
+    {
+        return UINT32_MAX;
+    }
+    Refill(bucket, esp_timer_get_time());
+    return (uint32_t)(bucket->tokens / PNP_THROTTLE_TOKEN_SCALE);
+}
+
+void PnP_Throttle_GetMetrics(PNP_THROTTLE_CLASS throttleClass, PNP_THROTTLE_METRICS *metrics)
+{
+    if ((unsigned)throttleClass >= PNP_THROTTLE_CLASS_COUNT)
+    {
+        return;
+    }
+
+    *metrics = g_throttleBuckets[throttleClass].metrics;
+}
+
+IOTHUB_CLIENT_RESULT PnP_Throttle_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL, IOTHUB_MESSAGE_HANDLE messageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void *userContextCallback)
+{
+    PNP_THROTTLE_BUCKET *bucket = &g_throttleBuckets[PNP_THROTTLE_TELEMETRY];
+    bucket->metrics.operations++;
+
+    // Deferred telemetry goes first, a smoothed burst keeps its order
+    if ((g_telemetryCount == 0) && (Acquire(bucket) == true))
+    {
+        return IoTHubDeviceClient_LL_SendEventAsync(deviceClientLL, messageHandle, eventConfirmationCallback, userContextCallback);
+    }
+    if ((bucket->budget.smoothing == false) || (g_telemetryCount == PNP_THROTTLE_TELEMETRY_QUEUE_LENGTH))
+    {
+        bucket->metrics.throttledOperations++;
+        LogError("Telemetry dropped, the telemetry budget is used up");
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    // The SDK clones the message it sends as well, the caller destroys its own either way
+    IOTHUB_MESSAGE_HANDLE clone = IoTHubMessage_Clone(messageHandle);
+    if (clone == NULL)
+    {
+        bucket->metrics.throttledOperations++;
+        LogError("Unable to clone telemetry to defer it");
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    PNP_THROTTLE_QUEUED_EVENT *entry = &g_telemetryQueue[g_telemetryCount++];
+    entry->messageHandle = clone;
+    entry->eventConfirmationCallback = eventConfirmationCallback;
+    entry->userContextCallback = userContextCallback;
+    entry->queuedUs = esp_timer_get_time();
+    bucket->metrics.deferredOperations++;
+    return IOTHUB_CLIENT_OK;
+}
+
+IOTHUB_CLIENT_RESULT PnP_Throttle_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL, const char *componentName, const char *propertyName, const unsigned char *reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void *userContextCallback)
+{
+    PNP_THROTTLE_BUCKET *bucket = &g_throttleBuckets[PNP_THROTTLE_REPORTED_STATE];
+    bucket->metrics.operations++;
+
+    // Queued reports go first, the twin applies patches in the order they arrive
+    if ((g_reportedStateCount == 0) && (Acquire(bucket) == true))
+    {
+        return IoTHubDeviceClient_LL_SendReportedState(deviceClientLL, reportedState, size, reportedStateCallback, userContextCallback);
+    }
+
+    char key[PNP_THROTTLE_PROPERTY_KEY_LENGTH] = "";
+    if ((propertyName != NULL) && (snprintf(key, sizeof(key), "%s/%s", (componentName != NULL) ? componentName : "", propertyName) < 0))
+    {
+        key[0] = '\0';
+    }
+
+    PNP_THROTTLE_QUEUED_REPORT *entry = NULL;
+    for (size_t i = 0; (key[0] != '\0') && (i < g_reportedStateCount); i++)
+    {
+        if (strcmp(g_reportedStateQueue[i].key, key) == 0)
+        {
+            entry = &g_reportedStateQueue[i];
+        }
+    }
+    if ((entry == NULL) && (g_reportedStateCount == PNP_THROTTLE_REPORTED_STATE_QUEUE_LENGTH))
+    {
+        bucket->metrics.throttledOperations++;
+        LogError("Reported state dropped, %d reports already wait for the reported state budget", PNP_THROTTLE_REPORTED_STATE_QUEUE_LENGTH);
+        return IOTHUB_CLIENT_ERROR;
+    }
+
+    unsigned char *copy = (unsigned char *)malloc(size);
+    if (copy == NULL)
+    {
+        bucket->metrics.throttledOperations++;
+        LogError("Unable to allocate %u bytes to queue reported state", (unsigned)size);
+        return IOTHUB_CLIENT_ERROR;
+    }
+    memcpy(copy, reportedState, size);
+
+    if (entry == NULL)
+    {
+        entry = &g_reportedStateQueue[g_reportedStateCount++];
+        strcpy(entry->key, key);
+        entry->queuedUs = esp_timer_get_time();
+    }
+    else
+    {
+        free(entry->reportedState);
+    }
+    entry->reportedState = copy;
+    entry->size = size;
+    entry->reportedStateCallback = reportedStateCallback;
+    entry->userContextCallback = userContextCallback;
+    bucket->metrics.deferredOperations++;
+    return IOTHUB_CLIENT_OK;
+}
+
+void PnP_Throttle_Flush(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL)
+{
+    size_t sent = 0;
+    PNP_THROTTLE_BUCKET *bucket = &g_throttleBuckets[PNP_THROTTLE_REPORTED_STATE];
+    while ((sent < g_reportedStateCount) && (Acquire(bucket) == true))
+    {
+        PNP_THROTTLE_QUEUED_REPORT *entry = &g_reportedStateQueue[sent++];
+        RecordWait(bucket, entry->queuedUs);
+        IOTHUB_CLIENT_RESULT result = IoTHubDeviceClient_LL_SendReportedState(deviceClientLL, entry->reportedState, entry->size, entry->reportedStateCallback,
+                                                                              entry->userContextCallback);
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            LogError("Unable to send queued reported state %s, error=%d", entry->key, result);
+        }
+        free(entry->reportedState);
+    }
+    if (sent != 0)
+    {
+        memmove(&g_reportedStateQueue[0], &g_reportedStateQueue[sent], (g_reportedStateCount - sent) * sizeof(g_reportedStateQueue[0]));
+        g_reportedStateCount -= sent;
+    }
+
+    sent = 0;
+    bucket = &g_throttleBuckets[PNP_THROTTLE_TELEMETRY];
+    while ((sent < g_telemetryCount) && (Acquire(bucket) == true))
+    {
+        PNP_THROTTLE_QUEUED_EVENT *entry = &g_telemetryQueue[sent++];
+        RecordWait(bucket, entry->queuedUs);
+        IOTHUB_CLIENT_RESULT result = IoTHubDeviceClient_LL_SendEventAsync(deviceClientLL, entry->messageHandle, entry->eventConfirmationCallback,
+                                                                           entry->userContextCallback);
+        if (result != IOTHUB_CLIENT_OK)
+        {
+            LogError("Unable to send deferred telemetry, error=%d", result);
+        }
+        IoTHubMessage_Destroy(entry->messageHandle);
+    }
+    if (sent != 0)
+    {
+        memmove(&g_telemetryQueue[0], &g_telemetryQueue[sent], (g_telemetryCount - sent) * sizeof(g_telemetryQueue[0]));
+        g_telemetryCount -= sent;
+    }
+}
@@ -0,0 +1,102 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// This header implements client-side throttling in front of every outbound IoT Hub operation.  IoT Hub enforces quotas on
+// device-to-cloud sends, twin updates and method responses, and only reports a violation by failing the operation.  Holding each
+// operation class to a token bucket keeps the device under its budget instead of discovering the limit from errors.
+//
+// A bucket refills at ratePerMinute tokens and holds at most burst tokens.  In smoothing mode the bucket holds a single token, so
+// a burst of requests is spread evenly over time instead of being sent back to back.
+//
+// The throttle never waits: the main loop's DoWork also keeps the MQTT connection alive, so an operation without a token is either
+// refused, and the caller drops it or keeps it to try again on a later pass, or deferred: a copy is queued and PnP_Throttle_Flush
+// sends it from the main loop as tokens free up.  Reported state is always deferred, a property acknowledgement that never arrives
+// leaves the twin's desired and reported values apart.  Telemetry is deferred in smoothing mode, and refused otherwise.  Method
+// responses are returned from the method callback, so they can only be refused.
+//
+// Like the IOTHUB_DEVICE_CLIENT_LL_HANDLE it fronts, this module is not thread safe; call it from the thread that runs DoWork.
+
+#ifndef PNP_THROTTLE_H
+#define PNP_THROTTLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "iothub_device_client_ll.h"
+
+typedef enum PNP_THROTTLE_CLASS_TAG
+{
+    PNP_THROTTLE_TELEMETRY,
+    PNP_THROTTLE_REPORTED_STATE,
+    PNP_THROTTLE_METHOD_RESPONSE,
+    PNP_THROTTLE_CLASS_COUNT
+} PNP_THROTTLE_CLASS;
+
+typedef struct PNP_THROTTLE_BUDGET_TAG
+{
+    // Sustained number of operations allowed per minute.
+    uint32_t ratePerMinute;
+    // Number of operations that may be sent back to back after an idle period.
+    uint32_t burst;
+    // Spread bursts evenly at ratePerMinute instead of allowing them back to back.
+    bool smoothing;
+} PNP_THROTTLE_BUDGET;
+
+typedef struct PNP_THROTTLE_METRICS_TAG
+{
+    // Operations that asked the throttle for a token.
+    uint32_t operations;
+    // Operations refused because the bucket was empty, or its queue full.
+    uint32_t throttledOperations;
+    // Operations queued for a later pass, including reports a newer one of the same property replaced before they went out.
+    uint32_t deferredOperations;
+    // Total and longest time deferred operations waited in the queue before they were sent.
+    uint64_t totalWaitMs;
+    uint32_t maxWaitMs;
+} PNP_THROTTLE_METRICS;
+
+//
+// PnP_Throttle_Configure replaces the budget of throttleClass and fills its bucket; the metrics and any queued operations are kept.
+// In smoothing mode the bucket never holds more than one token, so senders that wait for spare tokens, like the IMU capture, stay
+// silent while telemetry is smoothed.
+//
+void PnP_Throttle_Configure(PNP_THROTTLE_CLASS throttleClass, const PNP_THROTTLE_BUDGET* budget);
+
+//
+// PnP_Throttle_TryAcquire consumes a token of throttleClass and returns true, or returns false at once if the bucket is empty.
+//
+bool PnP_Throttle_TryAcquire(PNP_THROTTLE_CLASS throttleClass);
+
+//
+// PnP_Throttle_Available returns the whole tokens throttleClass holds now, without consuming one.  Low priority senders check it
+// to only go out when regular operations would not have to wait for them.
+//
+uint32_t PnP_Throttle_Available(PNP_THROTTLE_CLASS throttleClass);
+
+//
+// PnP_Throttle_Flush sends deferred operations, oldest first in each class, while their buckets have tokens; call it on every pass
+// of the main loop.
+//
+void PnP_Throttle_Flush(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL);
+
+//
+// PnP_Throttle_GetMetrics copies the operation counts and wait statistics of throttleClass.
+//
+void PnP_Throttle_GetMetrics(PNP_THROTTLE_CLASS throttleClass, PNP_THROTTLE_METRICS* metrics);
+
+//
+// Throttled equivalent of IoTHubDeviceClient_LL_SendEventAsync.  Without a token, or behind earlier deferred telemetry, a clone of
+// messageHandle is queued in smoothing mode and IOTHUB_CLIENT_OK returned; otherwise, or with the queue full, nothing is sent and
+// IOTHUB_CLIENT_ERROR is returned.  Either way the caller still owns messageHandle.
+//
+IOTHUB_CLIENT_RESULT PnP_Throttle_SendEventAsync(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL, IOTHUB_MESSAGE_HANDLE messageHandle, IOTHUB_CLIENT_EVENT_CONFIRMATION_CALLBACK eventConfirmationCallback, void* userContextCallback);
+
+//
+// Throttled equivalent of IoTHubDeviceClient_LL_SendReportedState.  Without a token, or behind earlier queued reports, a copy of
+// reportedState is queued and IOTHUB_CLIENT_OK returned.  A report of componentName/propertyName replaces one of the same property
+// still in the queue, since the twin keeps only the latest; the queue holds more properties than the model has, so only reports
+// without a property name (NULL) can find it full, and get IOTHUB_CLIENT_ERROR.
+//
+IOTHUB_CLIENT_RESULT PnP_Throttle_SendReportedState(IOTHUB_DEVICE_CLIENT_LL_HANDLE deviceClientLL, const char* componentName, const char* propertyName, const unsigned char* reportedState, size_t size, IOTHUB_CLIENT_REPORTED_STATE_CALLBACK reportedStateCallback, void* userContextCallback);
+
+#endif /* PNP_THROTTLE_H */
@@ -0,0 +1,308 @@
+#!/usr/bin/env python
+#
+# Generates the C model header for the device from its DTDL definition.
+#
+# The header holds everything the firmware needs to know about the model so that none of it is hand typed:
+#   * the model id and the component table, in the order the components are declared
+#   * one struct per component with telemetry, a serializer that writes it into a caller supplied buffer without allocating,
+#     and the maximum length of its output as a compile-time constant
+#   * a bit per telemetry field, so a device missing a sensor can send only the fields it has
+#   * the names of telemetry with an Object schema, which the application serializes itself
+#   * lookup tables for writable properties and commands, used to dispatch twin updates and device methods
+#   * the names of read-only properties
+#
+# Usage: dtdl_codegen.py <model.json> <output.h>
+#
+
+import json
+import re
+import sys
+
+# Telemetry schemas the serializer supports, and the longest text each can produce.
+#   double  : clamped to +/-999999999.99, written with two decimals -> "-999999999.99"
+#   integer : 32 bit signed                                      -> "-2147483648"
+#   boolean :                                                    -> "false"
+SCHEMA_MAX_LENGTH = {
+    "double": 13,
+    "integer": 11,
+    "boolean": 5,
+}
+
+SCHEMA_C_TYPE = {
+    "double": "double",
+    "integer": "int32_t",
+    "boolean": "bool",
+}
+
+SCHEMA_WRITER = {
+    "double": "PnP_Model_WriteDouble",
+    "integer": "PnP_Model_WriteInteger",
+    "boolean": "PnP_Model_WriteBoolean",
+}
+
+
+def upper_snake(name):
+    return re.sub(r"(?<=[a-z0-9])(?=[A-Z])", "_", name).upper()
+
+
+def pascal(name):
+    return name[0].upper() + name[1:]
+
+
+def has_type(content, dtdl_type):
+    types = content["@type"]
+    if isinstance(types, str):
+        types = [types]
+    return dtdl_type in types
+
+
+def c_string(text):
+    return '"' + text.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def load_model(path):
+    with open(path) as f:
+        document = json.load(f)
+
+    interfaces = document if isinstance(document, list) else [document]
+    by_id = dict((interface["@id"], interface) for interface in interfaces)
+    root = interfaces[0]
+
+    components = []
+    for content in root["contents"]:
+        if not has_type(content, "Component"):
+            raise SystemExit("%s: only components are supported on the root interface, found %s" % (path, content["name"]))
+        if content["schema"] not in by_id:
+            raise SystemExit("%s: component %s uses %s, which is not defined in the file" % (path, content["name"], content["schema"]))
+        components.append((content["name"], by_id[content["schema"]]))
+
+    return root["@id"], components
+
+
+def emit_header(out, model_id, components, source):
+    w = out.append
+
+    w("// Generated by tools/dtdl_codegen.py from %s.  Do not edit." % source)
+    w("")
+    w("#ifndef PNP_M5GO_MODEL_H")
+    w("#define PNP_M5GO_MODEL_H")
+    w("")
+    w("#ifdef __cplusplus")
+    w('extern "C" {')
+    w("#endif")
+    w("")
+    w("#include <stdbool.h>")
+    w("#include <stddef.h>")
+    w("#include <stdint.h>")
+    w("#include <string.h>")
+    w("")
+    w("#define PNP_MODEL_ID %s" % c_string(model_id))
+    w("")
+
+    # Components
+    w("typedef enum PNP_COMPONENT_TAG")
+    w("{")
+    for name, _ in components:
+        w("    PNP_COMPONENT_%s," % upper_snake(name))
+    w("    PNP_COMPONENT_COUNT")
+    w("} PNP_COMPONENT;")
+    w("")
+    w("#define PNP_COMPONENT_NAMES_INITIALIZER { %s }" % ", ".join(c_string(name) for name, _ in components))
+    w("")
+
+    # Serialization helpers
+    w("// Largest magnitude a double telemetry value is written with; larger values are clamped so the output length stays bounded.")
+    w("#define PNP_MODEL_DOUBLE_LIMIT 999999999.99")
+    w("")
+    w("static inline char* PnP_Model_WriteLiteral(char* out, const char* literal, size_t length)")
+    w("{")
+    w("    memcpy(out, literal, length);")
+    w("    return out + length;")
+    w("}")
+    w("")
+    w("static inline char* PnP_Model_WriteUnsigned(char* out, uint64_t value, int minimumDigits)")
+    w("{")
+    w("    char digits[20];")
+    w("    int count = 0;")
+    w("")
+    w("    do")
+    w("    {")
+    w("        digits[count++] = (char)('0' + (value % 10));")
+    w("        value /= 10;")
+    w("    } while ((value != 0) || (count < minimumDigits));")
+    w("")
+    w("    while (count > 0)")
+    w("    {")
+    w("        *out++ = digits[--count];")
+    w("    }")
+    w("    return out;")
+    w("}")
+    w("")
+    w("static inline char* PnP_Model_WriteInteger(char* out, int32_t value)")
+    w("{")
+    w("    int64_t wide = value;")
+    w("    *out = '-';")
+    w("    out += (wide < 0);")
+    w("    return PnP_Model_WriteUnsigned(out, (uint64_t)(wide < 0 ? -wide : wide), 1);")
+    w("}")
+    w("")
+    w("static inline char* PnP_Model_WriteDouble(char* out, double value)")
+    w("{")
+    w("    // NaN fails both comparisons and is written as 0.00.")
+    w("    value = (value > PNP_MODEL_DOUBLE_LIMIT) ? PNP_MODEL_DOUBLE_LIMIT : ((value < -PNP_MODEL_DOUBLE_LIMIT) ? -PNP_MODEL_DOUBLE_LIMIT : ((value == value) ? value : 0.0));")
+    w("    int64_t hundredths = (int64_t)(value * 100.0 + ((value < 0) ? -0.5 : 0.5));")
+    w("    *out = '-';")
+    w("    out += (hundredths < 0);")
+    w("    uint64_t magnitude = (uint64_t)((hundredths < 0) ? -hundredths : hundredths);")
+    w("    out = PnP_Model_WriteUnsigned(out, magnitude / 100, 1);")
+    w("    *out++ = '.';")
+    w("    return PnP_Model_WriteUnsigned(out, magnitude % 100, 2);")
+    w("}")
+    w("")
+    w("static inline char* PnP_Model_WriteBoolean(char* out, bool value)")
+    w("{")
+    w("    return value ? PnP_Model_WriteLiteral(out, \"true\", 4) : PnP_Model_WriteLiteral(out, \"false\", 5);")
+    w("}")
+    w("")
+
+    # Telemetry
+    for name, interface in components:
+        telemetry = [c for c in interface["contents"] if has_type(c, "Telemetry")]
+        written = [t for t in telemetry if isinstance(t["schema"], dict) and t["schema"].get("@type") == "Object"]
+        telemetry = [t for t in telemetry if t not in written]
+        for t in written:
+            w("// %s.%s has an Object schema and is written by the application." % (name, t["name"]))
+            w("#define PNP_%s_TELEMETRY_%s %s" % (upper_snake(name), upper_snake(t["name"]), c_string(t["name"])))
+            w("")
+        if not telemetry:
+            continue
+
+        type_name = "PNP_%s_TELEMETRY" % upper_snake(name)
+        w("//")
+        w("// Telemetry of the %s component (%s)." % (name, interface["@id"]))
+        w("//")
+        w("typedef struct %s_TAG" % type_name)
+        w("{")
+        for t in telemetry:
+            if t["schema"] not in SCHEMA_C_TYPE:
+                raise SystemExit("Telemetry %s.%s has unsupported schema %s" % (name, t["name"], t["schema"]))
+            w("    %s %s;" % (SCHEMA_C_TYPE[t["schema"]], t["name"]))
+        w("} %s;" % type_name)
+        w("")
+
+        max_length = 2  # braces
+        max_length += len(telemetry) - 1  # commas
+        for t in telemetry:
+            max_length += len(t["name"]) + 3 + SCHEMA_MAX_LENGTH[t["schema"]]  # "name": value
+        w("// Longest message PnP_%s_SerializeTelemetry can write, excluding the NULL terminator." % pascal(name))
+        w("#define %s_MAX_LENGTH %d" % (type_name, max_length))
+        w("")
+        for index, t in enumerate(telemetry):
+            w("#define %s_FIELD_%s (1u << %d)" % (type_name, upper_snake(t["name"]), index))
+        w("#define %s_ALL_FIELDS 0x%Xu" % (type_name, (1 << len(telemetry)) - 1))
+        w("")
+        w("// Writes the fields selected by the %s_FIELD_* bits in fields." % type_name)
+        w("static inline size_t PnP_%s_SerializeTelemetryFields(const %s* telemetry, uint32_t fields, char buffer[%s_MAX_LENGTH + 1])" % (pascal(name), type_name, type_name))
+        w("{")
+        w("    char* out = buffer;")
+        w("    char separator = '{';")
+        for t in telemetry:
+            literal = '"%s":' % t["name"]
+            w("    if (fields & %s_FIELD_%s)" % (type_name, upper_snake(t["name"])))
+            w("    {")
+            w("        *out++ = separator;")
+            w("        separator = ',';")
+            w("        out = PnP_Model_WriteLiteral(out, %s, %d);" % (c_string(literal), len(literal)))
+            w("        out = %s(out, telemetry->%s);" % (SCHEMA_WRITER[t["schema"]], t["name"]))
+            w("    }")
+        w("    if (separator == '{')")
+        w("    {")
+        w("        *out++ = '{';")
+        w("    }")
+        w("    *out++ = '}';")
+        w("    *out = '\\0';")
+        w("    return (size_t)(out - buffer);")
+        w("}")
+        w("")
+        w("static inline size_t PnP_%s_SerializeTelemetry(const %s* telemetry, char buffer[%s_MAX_LENGTH + 1])" % (pascal(name), type_name, type_name))
+        w("{")
+        w("    return PnP_%s_SerializeTelemetryFields(telemetry, %s_ALL_FIELDS, buffer);" % (pascal(name), type_name))
+        w("}")
+        w("")
+
+    # Properties
+    writable = []
+    for name, interface in components:
+        for p in interface["contents"]:
+            if not has_type(p, "Property"):
+                continue
+            w("#define PNP_%s_PROPERTY_%s %s" % (upper_snake(name), upper_snake(p["name"]), c_string(p["name"])))
+            if p.get("writable", False):
+                writable.append((name, p["name"]))
+    w("")
+
+    # Commands
+    commands = []
+    for name, interface in components:
+        for c in interface["contents"]:
+            if has_type(c, "Command"):
+                commands.append((name, c["name"]))
+
+    for kind, entries in (("PROPERTY", writable), ("COMMAND", commands)):
+        enum_name = "PNP_%s" % kind
+        function = "PnP_Model_FindWritableProperty" if kind == "PROPERTY" else "PnP_Model_FindCommand"
+        w("typedef enum %s_TAG" % enum_name)
+        w("{")
+        for component, entry in entries:
+            w("    %s_%s_%s," % (enum_name, upper_snake(component), upper_snake(entry)))
+        w("    %s_COUNT" % enum_name)
+        w("} %s;" % enum_name)
+        w("")
+        w("//")
+        w("// %s looks up name on component.  Returns false if the model does not define it." % function)
+        w("//")
+        w("static inline bool %s(PNP_COMPONENT component, const char* name, %s* result)" % (function, enum_name))
+        w("{")
+        w("    static const struct")
+        w("    {")
+        w("        PNP_COMPONENT component;")
+        w("        const char* name;")
+        w("    } table[%s_COUNT + 1] = {" % enum_name)
+        for component, entry in entries:
+            w("        { PNP_COMPONENT_%s, %s }," % (upper_snake(component), c_string(entry)))
+        w("        { PNP_COMPONENT_COUNT, NULL }")
+        w("    };")
+        w("")
+        w("    for (int i = 0; i < %s_COUNT; i++)" % enum_name)
+        w("    {")
+        w("        if ((table[i].component == component) && (strcmp(table[i].name, name) == 0))")
+        w("        {")
+        w("            *result = (%s)i;" % enum_name)
+        w("            return true;")
+        w("        }")
+        w("    }")
+        w("    return false;")
+        w("}")
+        w("")
+
+    w("#ifdef __cplusplus")
+    w("}")
+    w("#endif")
+    w("")
+    w("#endif /* PNP_M5GO_MODEL_H */")
+
+
+def main(argv):
+    if len(argv) != 3:
+        raise SystemExit("usage: %s <model.json> <output.h>" % argv[0])
+
+    model_id, components = load_model(argv[1])
+    out = []
+    emit_header(out, model_id, components, argv[1].replace("\\", "/").split("/")[-1])
+
+    with open(argv[2], "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+if __name__ == "__main__":
+    main(sys.argv)
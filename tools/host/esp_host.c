@@ -0,0 +1,140 @@
+#include "esp_host.h"
+
+static int64_t host_now_us;
+
+// Every handle is distinct and non NULL, none of them ever blocks
+static int host_handle;
+
+const char *esp_err_to_name(esp_err_t err) {
+    switch (err) {
+        case ESP_OK: return "ESP_OK";
+        case ESP_FAIL: return "ESP_FAIL";
+        case ESP_ERR_NO_MEM: return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG: return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE: return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND: return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NOT_SUPPORTED: return "ESP_ERR_NOT_SUPPORTED";
+        case ESP_ERR_TIMEOUT: return "ESP_ERR_TIMEOUT";
+        default: return "ERROR";
+    }
+}
+
+int64_t esp_timer_get_time(void) {
+    return host_now_us;
+}
+
+void ets_delay_us(uint32_t us) {
+    host_now_us += us;
+}
+
+void esp_host_advance_us(int64_t us) {
+    host_now_us += us;
+}
+
+SemaphoreHandle_t xSemaphoreCreateRecursiveMutex(void) {
+    return &host_handle;
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void) {
+    return &host_handle;
+}
+
+SemaphoreHandle_t xSemaphoreCreateBinary(void) {
+    return &host_handle;
+}
+
+BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t semaphore) {
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t timeout) {
+    return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore) {
+    return pdTRUE;
+}
+
+void vSemaphoreDelete(SemaphoreHandle_t semaphore) {
+}
+
+void vTaskDelay(TickType_t ticks) {
+    host_now_us += (int64_t)ticks * portTICK_PERIOD_MS * 1000;
+}
+
+TickType_t xTaskGetTickCount(void) {
+    return (TickType_t)(host_now_us / (portTICK_PERIOD_MS * 1000));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+    return &host_handle;
+}
+
+esp_err_t gpio_reset_pin(gpio_num_t gpio) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_direction(gpio_num_t gpio, gpio_mode_t mode) {
+    return ESP_OK;
+}
+
+esp_err_t gpio_set_level(gpio_num_t gpio, uint32_t level) {
+    return ESP_OK;
+}
+
+// Idle bus lines are pulled up
+int gpio_get_level(gpio_num_t gpio) {
+    return 1;
+}
+
+esp_err_t i2c_param_config(i2c_port_t port, const i2c_config_t *conf) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_driver_install(i2c_port_t port, i2c_mode_t mode, size_t rx_buffer, size_t tx_buffer, int flags) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_driver_delete(i2c_port_t port) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+i2c_cmd_handle_t i2c_cmd_link_create(void) {
+    return NULL;
+}
+
+void i2c_cmd_link_delete(i2c_cmd_handle_t cmd) {
+}
+
+esp_err_t i2c_master_start(i2c_cmd_handle_t cmd) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_master_stop(i2c_cmd_handle_t cmd) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_master_write_byte(i2c_cmd_handle_t cmd, uint8_t data, bool ack_en) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_master_write(i2c_cmd_handle_t cmd, const uint8_t *data, size_t length, bool ack_en) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_master_read_byte(i2c_cmd_handle_t cmd, uint8_t *data, i2c_ack_type_t ack) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_master_read(i2c_cmd_handle_t cmd, uint8_t *data, size_t length, i2c_ack_type_t ack) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t i2c_master_cmd_begin(i2c_port_t port, i2c_cmd_handle_t cmd, TickType_t timeout) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,136 @@
+/*
+    Host benchmark of the sensor sweep on the simulated bus of components/unit/i2c_bus/i2c_sim.c.
+
+    U=components/unit
+    gcc -O2 -Itools/host -I$U/i2c_bus -I$U/ENV -I$U/mpu6886 -I$U/regmap -c tools/i2c_sweep_bench.c tools/host/esp_host.c \
+        $U/i2c_bus/i2c_device.c $U/i2c_bus/i2c_sim.c $U/mpu6886/mpu6886_batch.c
+    g++ -std=c++11 -O2 -Itools/host -I$U/i2c_bus -I$U/ENV -I$U/mpu6886 -I$U/regmap -c $U/ENV/env.cpp $U/mpu6886/mpu6886.cpp
+    g++ *.o -lm -o i2c_sweep_bench && rm *.o
+
+    Reads SHT30, BMP280 and MPU6886 the way the telemetry did before the sweep, one driver call per device and
+    quantity, then as one transaction of the drivers' sample ops like m5go_Sensor_Sweep, SWEEPS times each with the
+    sensors set up as m5go_Sensor_Init does. Reports per sweep the transfers, bytes on the wire and modelled bus time
+    from i2c_sim, the port lock acquisitions and clock changes from i2c_device, and the host CPU time. Exits non zero
+    if a transfer failed or the transaction costs more bus time, locks or clock changes than the per-device reads.
+*/
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "esp_host.h"
+#include "i2c_device.h"
+#include "i2c_sim.h"
+#include "env.h"
+#include "mpu6886.h"
+
+#define SWEEPS 1000
+// The SHT30 measures once a second in periodic mode and NACKs a fetch without a new result
+#define SWEEP_PERIOD_US 1000000
+
+#define SWEEP_MAX_OPS 8
+
+typedef struct {
+    const char *name;
+    i2c_sim_stats_t sim;
+    i2c_bus_stats_t bus;
+    double cpu_ns;
+} sweep_result_t;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static volatile double sink;
+
+static void sweep_per_device(void) {
+    double temperature, humidity, pressure;
+    float ax, ay, az, gx, gy, gz;
+
+    SHT30_get(&temperature, &humidity);
+    bmp280_get_temperature_and_pressure(&temperature, &pressure);
+    MPU6886_GetAccelData(&ax, &ay, &az);
+    MPU6886_GetGyroData(&gx, &gy, &gz);
+    sink = temperature + humidity + pressure + ax + ay + az + gx + gy + gz;
+}
+
+static i2c_op_t sweep_ops[SWEEP_MAX_OPS];
+static i2c_transaction_t sweep_transaction;
+
+static void sweep_transaction_init(void) {
+    i2c_transaction_init(&sweep_transaction, sweep_ops, SWEEP_MAX_OPS);
+    SHT30_add_sample_ops(&sweep_transaction);
+    bmp280_add_sample_ops(&sweep_transaction);
+    MPU6886_AddSampleOps(&sweep_transaction);
+}
+
+static void sweep_grouped(void) {
+    double temperature, humidity, pressure;
+    mpu6886_sample_t sample;
+
+    i2c_transaction_execute(&sweep_transaction);
+    SHT30_get_sample(&temperature, &humidity);
+    bmp280_get_sample(&temperature, &pressure);
+    MPU6886_GetSample(&sample);
+    sink = temperature + humidity + pressure + sample.accel[0] + sample.gyro[0];
+}
+
+static void run(sweep_result_t *result, const char *name, void (*sweep)(void)) {
+    double cpu_s = 0;
+
+    i2c_sim_reset_stats();
+    i2c_bus_reset_stats(I2C_NUM_1);
+    for (int i = 0; i < SWEEPS; i++) {
+        esp_host_advance_us(SWEEP_PERIOD_US);
+        double start = now_s();
+        sweep();
+        cpu_s += now_s() - start;
+    }
+
+    result->name = name;
+    i2c_sim_get_stats(&result->sim);
+    i2c_bus_get_stats(I2C_NUM_1, &result->bus);
+    result->cpu_ns = cpu_s * 1e9 / SWEEPS;
+}
+
+static void print_result(const sweep_result_t *result) {
+    printf("%-12s %9.2f %7.1f %9.1f %7.2f %8.2f %7lu %9.0f\n", result->name, (double)result->sim.transactions / SWEEPS,
+           (double)result->sim.bytes / SWEEPS, (double)result->sim.bus_time_us / SWEEPS, (double)result->bus.lock_count / SWEEPS,
+           (double)result->bus.clock_changes / SWEEPS, (unsigned long)(result->sim.nacks + result->sim.timeouts), result->cpu_ns);
+}
+
+int main(void) {
+    i2c_sim_config_t config;
+    i2c_sim_default_config(&config);
+    config.realtime = 0;
+    i2c_sim_install(&config);
+
+    if (SHT30_Init() != 0 || bmp280_init() != 0 || MPU6886_Init() != 0) {
+        printf("sensor init failed on the simulated bus\n");
+        return 1;
+    }
+    bmp280_set_work_mode(BMP280_FORCED_MODE);
+    sweep_transaction_init();
+
+    sweep_result_t per_device, grouped;
+    run(&per_device, "per-device", sweep_per_device);
+    run(&grouped, "transaction", sweep_grouped);
+
+    printf("%d sweeps, per sweep:\n", SWEEPS);
+    printf("%-12s %9s %7s %9s %7s %8s %7s %9s\n", "", "transfers", "bytes", "bus us", "locks", "retimes", "failed", "cpu ns");
+    print_result(&per_device);
+    print_result(&grouped);
+
+    int failed = 0;
+    if (per_device.sim.nacks + per_device.sim.timeouts + grouped.sim.nacks + grouped.sim.timeouts != 0) {
+        printf("FAIL: transfers failed\n");
+        failed = 1;
+    }
+    if (grouped.sim.bus_time_us > per_device.sim.bus_time_us || grouped.bus.lock_count > per_device.bus.lock_count ||
+        grouped.bus.clock_changes > per_device.bus.clock_changes) {
+        printf("FAIL: the transaction costs more than the per-device reads\n");
+        failed = 1;
+    }
+    return failed;
+}
@@ -0,0 +1,284 @@
+/*
+    Host replay of the accelerometer event detection in components/unit/imu/imu_detect.c.
+
+    gcc -O2 -Icomponents/unit/imu tools/imu_events_replay.c components/unit/imu/imu_detect.c -lm -o imu_events_replay
+
+    imu_events_replay [recording.csv]
+
+    A recording has one sample per line, "timestamp_us,ax,ay,az[,label]" with the acceleration in g; the label
+    names the event that starts at that sample (tap, doubleTap, shock, freeFall, step). Without a recording a
+    labelled 100 Hz scenario is synthesized: the events, walking, and distractors that must not trigger anything
+    (tilting, handling, vibration, a bumpy ride). Detections are matched to labels of the same type within
+    REPLAY_MATCH_MS; per type it reports the hits, misses, false positives and the latency from the start of the
+    event to its detection, then the detector's cost per sample. Exits non zero when anything was missed or
+    falsely detected.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "imu_detect.h"
+
+#define REPLAY_RATE_HZ 100
+#define REPLAY_MATCH_MS 300
+#define REPLAY_MAX_SAMPLES 200000
+#define REPLAY_BENCH_SECONDS 1.0
+
+typedef struct {
+    int64_t timestamp_us;
+    float accel[3];
+    int label;                  // imu_event_type_t, or -1
+} replay_sample_t;
+
+typedef struct {
+    int expected;
+    int detected;
+    int false_positives;
+    double latency_sum_ms;
+    double latency_max_ms;
+} replay_result_t;
+
+static replay_sample_t samples[REPLAY_MAX_SAMPLES];
+static uint8_t label_matched[REPLAY_MAX_SAMPLES];
+static size_t sample_count;
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float noise(float amplitude) {
+    return ((float)rand() / RAND_MAX - 0.5f) * 2.0f * amplitude;
+}
+
+static int event_type(const char *name) {
+    for (int type = 0; type < IMU_EVENT_TYPE_COUNT; type++) {
+        if (strcmp(name, imu_detect_event_name((imu_event_type_t)type)) == 0) {
+            return type;
+        }
+    }
+    return -1;
+}
+
+// Append seconds of gravity along g plus the extra acceleration shape(t) along z, labelling the first sample
+static void synth(float seconds, const float *g, float (*shape)(float t), int label) {
+    size_t n = (size_t)(seconds * REPLAY_RATE_HZ);
+    for (size_t i = 0; i < n && sample_count < REPLAY_MAX_SAMPLES; i++, sample_count++) {
+        float t = (float)i / REPLAY_RATE_HZ;
+        replay_sample_t *s = &samples[sample_count];
+        s->timestamp_us = (int64_t)sample_count * 1000000 / REPLAY_RATE_HZ;
+        for (int axis = 0; axis < 3; axis++) {
+            s->accel[axis] = g[axis] + noise(0.01f);
+        }
+        s->accel[2] += shape ? shape(t) : 0.0f;
+        s->label = (i == 0) ? label : -1;
+    }
+}
+
+static float shape_tap(float t) {
+    // A knuckle on the case: 30 ms, 1.8 g
+    return (t < 0.03f) ? 1.8f * sinf((float)M_PI * t / 0.03f) : 0.0f;
+}
+
+static float shape_shock(float t) {
+    // Dropped on the table: 80 ms up to 6 g
+    return (t < 0.08f) ? 6.0f * sinf((float)M_PI * t / 0.08f) : 0.0f;
+}
+
+static float shape_handling(float t) {
+    // Picked up and put down: 0.6 g over 400 ms, too slow for a tap and too weak for a shock
+    return 0.6f * sinf(2.0f * (float)M_PI * t / 0.4f) * (t < 0.4f);
+}
+
+static float shape_vibration(float t) {
+    // Fan or motor nearby, 30 Hz at 0.2 g
+    return 0.2f * sinf(2.0f * (float)M_PI * 30.0f * t);
+}
+
+static float shape_ride(float t) {
+    // Irregular 0.8 g jolts, spread out: carried in a bag on a bumpy road, no rhythm of steps
+    static const float starts[] = { 0.3f, 1.7f, 2.2f, 4.6f, 7.9f };
+    for (size_t i = 0; i < sizeof(starts) / sizeof(starts[0]); i++) {
+        float dt = t - starts[i];
+        if (dt >= 0.0f && dt < 0.15f) {
+            return 0.8f * sinf((float)M_PI * dt / 0.15f);
+        }
+    }
+    return 0.0f;
+}
+
+static float shape_walk(float t) {
+    // One step every 0.55 s: heel strike and push off
+    float phase = fmodf(t, 0.55f) / 0.55f;
+    return 0.35f * sinf(2.0f * (float)M_PI * phase) + 0.1f * sinf(4.0f * (float)M_PI * phase);
+}
+
+static void synth_walk(float seconds, const float *g) {
+    size_t first = sample_count;
+    synth(seconds, g, shape_walk, -1);
+    // Each step is labelled at its peak, a quarter period in
+    for (float t = 0.55f * 0.2f; t < seconds; t += 0.55f) {
+        samples[first + (size_t)(t * REPLAY_RATE_HZ)].label = IMU_EVENT_STEP;
+    }
+}
+
+static void synth_tilt(float seconds) {
+    // Turned over slowly, |a| stays at 1 g
+    size_t n = (size_t)(seconds * REPLAY_RATE_HZ);
+    for (size_t i = 0; i < n; i++) {
+        float angle = (float)M_PI * i / n;
+        float g[3] = { sinf(angle), 0.0f, cosf(angle) };
+        synth(1.0f / REPLAY_RATE_HZ, g, NULL, -1);
+    }
+}
+
+static void synth_scenario(void) {
+    static const float flat[3] = { 0.0f, 0.0f, 1.0f };
+    static const float weightless[3] = { 0.02f, -0.03f, 0.04f };
+
+    srand(1);
+    synth(2.0f, flat, NULL, -1);
+    for (int i = 0; i < 3; i++) {
+        synth(1.5f, flat, shape_tap, IMU_EVENT_TAP);
+    }
+    for (int i = 0; i < 3; i++) {
+        synth(0.2f, flat, shape_tap, IMU_EVENT_DOUBLE_TAP);
+        synth(1.5f, flat, shape_tap, -1);
+    }
+    synth(1.0f, flat, NULL, -1);
+    synth(1.5f, flat, shape_shock, IMU_EVENT_SHOCK);
+    // Dropped from about 45 cm, then the impact
+    synth(0.3f, weightless, NULL, IMU_EVENT_FREE_FALL);
+    synth(1.5f, flat, shape_shock, IMU_EVENT_SHOCK);
+    synth_walk(9.9f, flat);
+    synth(3.0f, flat, NULL, -1);
+    // Distractors
+    synth_tilt(3.0f);
+    synth(2.0f, flat, shape_handling, -1);
+    synth(2.0f, flat, shape_handling, -1);
+    synth(3.0f, flat, shape_vibration, -1);
+    synth(9.0f, flat, shape_ride, -1);
+    synth(2.0f, flat, NULL, -1);
+}
+
+static int load_csv(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL && sample_count < REPLAY_MAX_SAMPLES) {
+        replay_sample_t *s = &samples[sample_count];
+        long long timestamp;
+        char label[32] = "";
+        int fields = sscanf(line, "%lld,%f,%f,%f,%31s", &timestamp, &s->accel[0], &s->accel[1], &s->accel[2], label);
+        if (fields < 4) {
+            // Header or comment
+            continue;
+        }
+        s->timestamp_us = timestamp;
+        s->label = (fields == 5) ? event_type(label) : -1;
+        sample_count++;
+    }
+    fclose(file);
+    return 0;
+}
+
+// Nearest unmatched label of the event's type; steps are matched at the peak the event reports
+static void score(const imu_event_t *event, replay_result_t *results) {
+    static float steps;
+    // The step event that opens a run counts the earlier peaks of the run too
+    int count = 1;
+    if (event->type == IMU_EVENT_STEP) {
+        count = (int)(event->value - steps);
+        steps = event->value;
+    }
+
+    size_t best = sample_count;
+    int64_t best_distance = (int64_t)REPLAY_MATCH_MS * 1000 + 1;
+    for (size_t i = 0; i < sample_count; i++) {
+        int64_t distance = llabs(samples[i].timestamp_us - event->timestamp_us);
+        if (samples[i].label == (int)event->type && !label_matched[i] && distance < best_distance) {
+            best = i;
+            best_distance = distance;
+        }
+    }
+
+    replay_result_t *result = &results[event->type];
+    if (best == sample_count) {
+        result->false_positives += count;
+        return;
+    }
+    label_matched[best] = 1;
+    for (size_t i = best, left = count - 1; left > 0 && i-- > 0;) {
+        if (samples[i].label == IMU_EVENT_STEP && !label_matched[i]) {
+            label_matched[i] = 1;
+            left--;
+        }
+    }
+    double latency = (event->detected_us - samples[best].timestamp_us) * 1e-3;
+    result->detected += count;
+    result->latency_sum_ms += latency;
+    result->latency_max_ms = fmax(result->latency_max_ms, latency);
+}
+
+int main(int argc, char **argv) {
+    replay_result_t results[IMU_EVENT_TYPE_COUNT];
+    imu_detect_config_t config;
+    imu_detect_t detect;
+    imu_event_t events[IMU_DETECT_MAX_EVENTS];
+    int failed = 0;
+
+    if (argc > 1) {
+        if (load_csv(argv[1]) != 0) {
+            return 2;
+        }
+    } else {
+        synth_scenario();
+    }
+    printf("%zu samples, %.1f s\n", sample_count, sample_count ? (samples[sample_count - 1].timestamp_us - samples[0].timestamp_us) * 1e-6 : 0.0);
+
+    memset(results, 0, sizeof(results));
+    for (size_t i = 0; i < sample_count; i++) {
+        if (samples[i].label >= 0) {
+            results[samples[i].label].expected++;
+        }
+    }
+
+    imu_detect_default_config(&config);
+    imu_detect_init(&detect, &config);
+    for (size_t i = 0; i < sample_count; i++) {
+        size_t count = imu_detect_update(&detect, samples[i].accel, samples[i].timestamp_us, events);
+        for (size_t e = 0; e < count; e++) {
+            score(&events[e], results);
+        }
+    }
+
+    printf("%-10s %8s %8s %8s %8s %12s %12s\n", "event", "expected", "detected", "missed", "false", "latency ms", "max ms");
+    for (int type = 0; type < IMU_EVENT_TYPE_COUNT; type++) {
+        replay_result_t *result = &results[type];
+        int missed = result->expected - result->detected;
+        printf("%-10s %8d %8d %8d %8d %12.1f %12.1f\n", imu_detect_event_name((imu_event_type_t)type), result->expected, result->detected, missed,
+               result->false_positives, result->detected ? result->latency_sum_ms / result->detected : 0.0, result->latency_max_ms);
+        failed |= missed != 0 || result->false_positives != 0;
+    }
+
+    // Cost per sample, the whole recording replayed until the time is meaningful
+    long replayed = 0;
+    double start = now_s(), elapsed;
+    do {
+        imu_detect_init(&detect, &config);
+        for (size_t i = 0; i < sample_count; i++, replayed++) {
+            imu_detect_update(&detect, samples[i].accel, samples[i].timestamp_us, events);
+        }
+        elapsed = now_s() - start;
+    } while (elapsed < REPLAY_BENCH_SECONDS && sample_count > 0);
+    printf("%.1f ns per sample on this host\n", replayed ? elapsed * 1e9 / replayed : 0.0);
+
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
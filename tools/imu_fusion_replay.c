@@ -0,0 +1,318 @@
+/*
+    Host replay of the orientation fusion in components/unit/imu/imu_fusion.c.
+
+    U=components/unit
+    gcc -O2 -Itools/host -I$U/imu -I$U/mpu6886 -I$U/i2c_bus tools/imu_fusion_replay.c $U/imu/imu_fusion.c -lm -o imu_fusion_replay
+
+    imu_fusion_replay [recording.csv]
+
+    A recording has one sample per line, "timestamp_us,ax,ay,az,gx,gy,gz,roll,pitch,yaw" with the acceleration in
+    g, the rate in dps and the reference attitude in degrees, e.g. from a turntable or an optical tracker. Without
+    a recording a 100 Hz scenario is synthesized from a known trajectory: rest, tilts, a turn, rocking, shocks and
+    the bounce of walking, measured by a gyro with a constant bias and noise. The filter runs with the default
+    config and the same gap handling as on the sampler. After REPLAY_SETTLE_S it reports the tilt error, the angle
+    between the estimated and the reference gravity direction, which is independent of yaw; the yaw error, which
+    drifts without a magnetometer and is only reported; and for the synthetic scenario the tracked gyro bias, then
+    the filter's cost per update. Exits non zero when the tilt error, or the bias error around the axes gravity
+    observes at the end of the scenario, exceeds its threshold.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "imu_sampler.h"
+#include "imu_fusion.h"
+
+#define REPLAY_RATE_HZ 100
+#define REPLAY_MAX_SAMPLES 200000
+#define REPLAY_BENCH_SECONDS 1.0
+// As imu_fusion_on_sample, longer gaps are not integrated
+#define REPLAY_MAX_DT 0.1f
+#define REPLAY_SETTLE_S 2.0
+
+#define REPLAY_MAX_TILT_RMS_DEG 1.0
+#define REPLAY_MAX_TILT_DEG 2.5
+#define REPLAY_MAX_BIAS_ERROR_DPS 0.05
+
+#define DEG_TO_RAD (M_PI / 180.0)
+
+typedef struct {
+    int64_t timestamp_us;
+    float accel[3];
+    float gyro[3];
+    imu_quaternion_t reference;
+} replay_sample_t;
+
+static replay_sample_t samples[REPLAY_MAX_SAMPLES];
+static size_t sample_count;
+
+// Gyro bias of the synthetic scenario, dps
+static const float synth_bias[3] = { 0.8f, -0.5f, 0.3f };
+static int synthesized;
+
+// imu_fusion.c's sampler glue is not replayed, the filter is fed directly
+uint8_t imu_sampler_running(void) {
+    return 0;
+}
+
+esp_err_t imu_sampler_subscribe(imu_sampler_callback_t callback, void *arg) {
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+void MPU6886_ScaleSamples(const mpu6886_raw_sample_t *raw, size_t count, mpu6886_sample_t *samples) {
+}
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static float noise(float amplitude) {
+    return ((float)rand() / RAND_MAX - 0.5f) * 2.0f * amplitude;
+}
+
+// Roll, pitch, yaw in degrees to the sensor to world quaternion, the convention of imu_fusion_get
+static imu_quaternion_t from_euler(double roll, double pitch, double yaw) {
+    double cr = cos(roll * DEG_TO_RAD / 2), sr = sin(roll * DEG_TO_RAD / 2);
+    double cp = cos(pitch * DEG_TO_RAD / 2), sp = sin(pitch * DEG_TO_RAD / 2);
+    double cy = cos(yaw * DEG_TO_RAD / 2), sy = sin(yaw * DEG_TO_RAD / 2);
+    imu_quaternion_t q = {
+        (float)(cr * cp * cy + sr * sp * sy),
+        (float)(sr * cp * cy - cr * sp * sy),
+        (float)(cr * sp * cy + sr * cp * sy),
+        (float)(cr * cp * sy - sr * sp * cy),
+    };
+    return q;
+}
+
+// World vector v in the sensor frame
+static void to_sensor(const imu_quaternion_t *q, const double *v, double *s) {
+    double w = q->w, x = q->x, y = q->y, z = q->z;
+    s[0] = (w * w + x * x - y * y - z * z) * v[0] + 2.0 * (x * y + w * z) * v[1] + 2.0 * (x * z - w * y) * v[2];
+    s[1] = 2.0 * (x * y - w * z) * v[0] + (w * w - x * x + y * y - z * z) * v[1] + 2.0 * (y * z + w * x) * v[2];
+    s[2] = 2.0 * (x * z + w * y) * v[0] + 2.0 * (y * z - w * x) * v[1] + (w * w - x * x - y * y + z * z) * v[2];
+}
+
+// Gravity direction in the sensor frame
+static void gravity(const imu_quaternion_t *q, double *g) {
+    static const double up[3] = { 0.0, 0.0, 1.0 };
+    to_sensor(q, up, g);
+}
+
+static double tilt_error_deg(const imu_quaternion_t *estimate, const imu_quaternion_t *reference) {
+    double a[3], b[3];
+    gravity(estimate, a);
+    gravity(reference, b);
+    double dot = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / sqrt((a[0] * a[0] + a[1] * a[1] + a[2] * a[2]) * (b[0] * b[0] + b[1] * b[1] + b[2] * b[2]));
+    return acos(dot > 1.0 ? 1.0 : (dot < -1.0 ? -1.0 : dot)) / DEG_TO_RAD;
+}
+
+static double yaw_deg(const imu_quaternion_t *q) {
+    return atan2(q->x * q->y + q->w * q->z, 0.5 - q->y * q->y - q->z * q->z) / DEG_TO_RAD;
+}
+
+static double wrap_deg(double angle) {
+    return angle - 360.0 * floor((angle + 180.0) / 360.0);
+}
+
+/*
+    Append a segment of seconds moving linearly from the previous attitude to roll, pitch, yaw, with the linear
+    acceleration shape(t, a) in g in the world frame. The gyro measures the body rate from the previous sample.
+*/
+static double synth_roll, synth_pitch, synth_yaw;
+
+static void synth(float seconds, double roll, double pitch, double yaw, void (*shape)(float t, double *a)) {
+    size_t n = (size_t)(seconds * REPLAY_RATE_HZ);
+    double roll0 = synth_roll, pitch0 = synth_pitch, yaw0 = synth_yaw;
+
+    for (size_t i = 1; i <= n && sample_count < REPLAY_MAX_SAMPLES; i++, sample_count++) {
+        double f = (double)i / n;
+        replay_sample_t *s = &samples[sample_count];
+        imu_quaternion_t q = from_euler(roll0 + (roll - roll0) * f, pitch0 + (pitch - pitch0) * f, yaw0 + (yaw - yaw0) * f);
+        imu_quaternion_t p = sample_count ? samples[sample_count - 1].reference : q;
+
+        // Body rate 2 * conj(p) * q / dt
+        double dt = 1.0 / REPLAY_RATE_HZ;
+        double w = p.w * q.w + p.x * q.x + p.y * q.y + p.z * q.z;
+        double rate[3] = {
+            p.w * q.x - p.x * q.w - p.y * q.z + p.z * q.y,
+            p.w * q.y + p.x * q.z - p.y * q.w - p.z * q.x,
+            p.w * q.z - p.x * q.y + p.y * q.x - p.z * q.w,
+        };
+        double scale = (w < 0.0 ? -2.0 : 2.0) / dt / DEG_TO_RAD;
+
+        double a[3] = { 0.0, 0.0, 0.0 }, measured[3];
+        if (shape != NULL) {
+            shape((float)i / REPLAY_RATE_HZ, a);
+        }
+        a[2] += 1.0;
+        to_sensor(&q, a, measured);
+        s->timestamp_us = (int64_t)sample_count * 1000000 / REPLAY_RATE_HZ;
+        for (int axis = 0; axis < 3; axis++) {
+            s->accel[axis] = (float)measured[axis] + noise(0.005f);
+            s->gyro[axis] = (float)(rate[axis] * scale) + synth_bias[axis] + noise(0.05f);
+        }
+        s->reference = q;
+    }
+    synth_roll = roll;
+    synth_pitch = pitch;
+    synth_yaw = yaw;
+}
+
+static void shape_shock(float t, double *a) {
+    // Knocked sideways on the table every 2 s: 50 ms up to 3 g
+    float dt = fmodf(t, 2.0f);
+    a[0] = (dt < 0.05f) ? 3.0f * sinf((float)M_PI * dt / 0.05f) : 0.0f;
+}
+
+static void shape_walk(float t, double *a) {
+    // Carried while walking, the body bounces 0.3 g twice a second and sways 0.2 g once a second
+    a[0] = 0.2f * sinf(2.0f * (float)M_PI * t);
+    a[2] = 0.3f * sinf(2.0f * (float)M_PI * 2.0f * t);
+}
+
+static void synth_rock(float seconds, double amplitude, double period) {
+    for (float t = 0.0f; t < seconds; t += 0.05f) {
+        synth(0.05f, amplitude * sin(2.0 * M_PI * (t + 0.05f) / period), synth_pitch, synth_yaw, NULL);
+    }
+}
+
+static void synth_scenario(void) {
+    srand(1);
+    synthesized = 1;
+    synth(10.0f, 0.0, 0.0, 0.0, NULL);
+    synth(2.0f, 30.0, 0.0, 0.0, NULL);
+    synth(3.0f, 30.0, 0.0, 0.0, NULL);
+    synth(2.0f, 30.0, -45.0, 0.0, NULL);
+    synth(3.0f, 30.0, -45.0, 0.0, NULL);
+    synth(2.0f, 0.0, 0.0, 0.0, NULL);
+    synth(3.0f, 0.0, 0.0, 90.0, NULL);
+    synth(3.0f, 0.0, 0.0, 90.0, NULL);
+    synth_rock(10.0f, 20.0, 2.0);
+    synth(10.0f, 0.0, 0.0, 90.0, shape_shock);
+    synth(10.0f, 0.0, 10.0, 90.0, shape_walk);
+    synth(2.0f, 0.0, 0.0, 90.0, NULL);
+    // The bias converges with a time constant near kp / ki, 50 s with the default config
+    synth(120.0f, 0.0, 0.0, 90.0, NULL);
+}
+
+static int load_csv(const char *path) {
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL && sample_count < REPLAY_MAX_SAMPLES) {
+        replay_sample_t *s = &samples[sample_count];
+        long long timestamp;
+        double roll, pitch, yaw;
+        int fields = sscanf(line, "%lld,%f,%f,%f,%f,%f,%f,%lf,%lf,%lf", &timestamp, &s->accel[0], &s->accel[1], &s->accel[2], &s->gyro[0],
+                            &s->gyro[1], &s->gyro[2], &roll, &pitch, &yaw);
+        if (fields < 10) {
+            // Header or comment
+            continue;
+        }
+        s->timestamp_us = timestamp;
+        s->reference = from_euler(roll, pitch, yaw);
+        sample_count++;
+    }
+    fclose(file);
+    return 0;
+}
+
+static void replay(imu_fusion_t *fusion, size_t i) {
+    float dt = (i == 0) ? 0.0f : (float)(samples[i].timestamp_us - samples[i - 1].timestamp_us) * 1e-6f;
+    if (dt < 0.0f || dt > REPLAY_MAX_DT) {
+        dt = 0.0f;
+    }
+    imu_fusion_update(fusion, samples[i].accel, samples[i].gyro, dt);
+}
+
+int main(int argc, char **argv) {
+    imu_fusion_config_t config;
+    imu_fusion_t fusion;
+    imu_attitude_t attitude;
+    int failed = 0;
+
+    if (argc > 1) {
+        if (load_csv(argv[1]) != 0) {
+            return 2;
+        }
+    } else {
+        synth_scenario();
+    }
+    if (sample_count == 0) {
+        printf("no samples\n");
+        return 2;
+    }
+    printf("%zu samples, %.1f s\n", sample_count, (samples[sample_count - 1].timestamp_us - samples[0].timestamp_us) * 1e-6);
+
+    imu_fusion_default_config(&config);
+    imu_fusion_init(&fusion, &config);
+
+    double tilt_sum = 0.0, tilt_max = 0.0, yaw_max = 0.0, yaw_offset = 0.0, yaw_error = 0.0;
+    size_t scored = 0;
+    int aligned = 0;
+    for (size_t i = 0; i < sample_count; i++) {
+        replay(&fusion, i);
+        if (!fusion.initialized) {
+            continue;
+        }
+        if (!aligned) {
+            // The filter starts at yaw 0, the reference anywhere
+            yaw_offset = yaw_deg(&samples[i].reference) - yaw_deg(&fusion.q);
+            aligned = 1;
+        }
+        if ((samples[i].timestamp_us - samples[0].timestamp_us) * 1e-6 < REPLAY_SETTLE_S) {
+            continue;
+        }
+        double tilt = tilt_error_deg(&fusion.q, &samples[i].reference);
+        yaw_error = wrap_deg(yaw_deg(&fusion.q) + yaw_offset - yaw_deg(&samples[i].reference));
+        tilt_sum += tilt * tilt;
+        tilt_max = fmax(tilt_max, tilt);
+        yaw_max = fmax(yaw_max, fabs(yaw_error));
+        scored++;
+    }
+    if (scored == 0) {
+        printf("the filter never initialized, or the recording is shorter than %.1f s\n", REPLAY_SETTLE_S);
+        return 1;
+    }
+
+    double tilt_rms = sqrt(tilt_sum / scored);
+    printf("%-16s %10s %10s\n", "error deg", "rms", "max");
+    printf("%-16s %10.2f %10.2f\n", "tilt", tilt_rms, tilt_max);
+    printf("%-16s %10s %10.2f   final %.2f, not checked\n", "yaw", "", yaw_max, yaw_error);
+    failed |= tilt_rms > REPLAY_MAX_TILT_RMS_DEG || tilt_max > REPLAY_MAX_TILT_DEG;
+
+    imu_fusion_get(&fusion, &attitude);
+    if (synthesized) {
+        printf("%-16s %10s %10s %10s\n", "gyro bias dps", "x", "y", "z");
+        printf("%-16s %10.3f %10.3f %10.3f\n", "tracked", attitude.gyro_bias[0], attitude.gyro_bias[1], attitude.gyro_bias[2]);
+        printf("%-16s %10.3f %10.3f %10.3f\n", "actual", synth_bias[0], synth_bias[1], synth_bias[2]);
+        // The scenario ends at rest and flat, where gravity only shows the bias around x and y
+        for (int axis = 0; axis < 2; axis++) {
+            failed |= fabsf(attitude.gyro_bias[axis] - synth_bias[axis]) > REPLAY_MAX_BIAS_ERROR_DPS;
+        }
+    } else {
+        printf("gyro bias dps %.3f %.3f %.3f\n", attitude.gyro_bias[0], attitude.gyro_bias[1], attitude.gyro_bias[2]);
+    }
+
+    // Cost per update, the whole recording replayed until the time is meaningful
+    long replayed = 0;
+    double start = now_s(), elapsed;
+    do {
+        imu_fusion_init(&fusion, &config);
+        for (size_t i = 0; i < sample_count; i++, replayed++) {
+            replay(&fusion, i);
+        }
+        elapsed = now_s() - start;
+    } while (elapsed < REPLAY_BENCH_SECONDS);
+    printf("%.1f ns per update on this host\n", elapsed * 1e9 / replayed);
+
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
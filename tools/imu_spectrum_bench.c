@@ -0,0 +1,97 @@
+/*
+    Host check and benchmark of the vibration spectrum in components/unit/imu/imu_spectrum.c.
+
+    gcc -O3 -march=native -Icomponents/unit/imu tools/imu_spectrum_bench.c components/unit/imu/imu_spectrum.c -lm -o imu_spectrum_bench
+
+    Compares the FFT power spectrum with a direct DFT, checks the features of a known signal, and reports how
+    many three axis windows per second the portable FFT analyzes.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "imu_spectrum.h"
+
+#define BENCH_RATE_HZ 1000.0f
+#define BENCH_SECONDS 2.0
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Power spectrum of the mean removed, Hann windowed signal, the textbook way in double precision
+static void direct_power(const float *signal, double *power) {
+    double mean = 0.0;
+    for (int n = 0; n < IMU_SPECTRUM_SIZE; n++) {
+        mean += signal[n];
+    }
+    mean /= IMU_SPECTRUM_SIZE;
+    for (int k = 0; k < IMU_SPECTRUM_BINS; k++) {
+        double re = 0.0, im = 0.0;
+        for (int n = 0; n < IMU_SPECTRUM_SIZE; n++) {
+            double w = 0.5 - 0.5 * cos(2.0 * M_PI * n / IMU_SPECTRUM_SIZE);
+            double v = (signal[n] - mean) * w;
+            re += v * cos(2.0 * M_PI * k * n / IMU_SPECTRUM_SIZE);
+            im -= v * sin(2.0 * M_PI * k * n / IMU_SPECTRUM_SIZE);
+        }
+        power[k] = re * re + im * im;
+    }
+}
+
+int main(void) {
+    static float x[IMU_SPECTRUM_SIZE], y[IMU_SPECTRUM_SIZE], z[IMU_SPECTRUM_SIZE];
+    float power[IMU_SPECTRUM_BINS];
+    double reference[IMU_SPECTRUM_BINS];
+    imu_spectrum_features_t features;
+    int failed = 0;
+
+    imu_spectrum_init();
+
+    // 0.5 g at 123 Hz along x, 0.1 g at 310 Hz along y, gravity and a little noise
+    srand(1);
+    for (int n = 0; n < IMU_SPECTRUM_SIZE; n++) {
+        float t = n / BENCH_RATE_HZ;
+        float noise = ((float)rand() / RAND_MAX - 0.5f) * 0.002f;
+        x[n] = 0.5f * sinf(2.0f * (float)M_PI * 123.0f * t) + noise;
+        y[n] = 0.1f * sinf(2.0f * (float)M_PI * 310.0f * t) - noise;
+        z[n] = 1.0f + noise;
+    }
+
+    memset(power, 0, sizeof(power));
+    imu_spectrum_accumulate(x, power);
+    direct_power(x, reference);
+    double max_error = 0.0, max_power = 0.0;
+    for (int k = 0; k < IMU_SPECTRUM_BINS; k++) {
+        max_error = fmax(max_error, fabs(power[k] - reference[k]));
+        max_power = fmax(max_power, reference[k]);
+    }
+    printf("FFT against DFT: largest error %.2e of the peak power\n", max_error / max_power);
+    failed |= max_error / max_power > 1e-4;
+
+    imu_spectrum_analyze(x, y, z, BENCH_RATE_HZ, &features);
+    printf("rms %.4f g (expected about %.4f), peak %.1f Hz (expected 123)\n", features.rms, sqrtf(0.5f * 0.25f + 0.5f * 0.01f), features.peak_hz);
+    for (int b = 0; b < IMU_SPECTRUM_BANDS; b++) {
+        printf("  band %d, %5.1f - %5.1f Hz: %.5f g^2\n", b, b * BENCH_RATE_HZ / 2 / IMU_SPECTRUM_BANDS, (b + 1) * BENCH_RATE_HZ / 2 / IMU_SPECTRUM_BANDS,
+               features.band_energy[b]);
+    }
+    failed |= fabsf(features.peak_hz - 123.0f) > 1.0f || fabsf(features.rms - sqrtf(0.13f)) > 0.02f;
+
+    // Throughput of whole three axis windows
+    long windows = 0;
+    double start = now_s(), elapsed;
+    do {
+        for (int i = 0; i < 100; i++, windows++) {
+            x[i] += 1e-6f;
+            imu_spectrum_analyze(x, y, z, BENCH_RATE_HZ, &features);
+        }
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_SECONDS);
+    printf("%d point windows, 3 axes: %.0f windows/s, %.2f us per window\n", IMU_SPECTRUM_SIZE, windows / elapsed, elapsed * 1e6 / windows);
+
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
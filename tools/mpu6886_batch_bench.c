@@ -0,0 +1,112 @@
+/*
+    Host check and benchmark of the MPU6886 batch conversion in components/unit/mpu6886/mpu6886_batch.c.
+
+    gcc -O3 -march=native -Icomponents/unit/mpu6886 tools/mpu6886_batch_bench.c components/unit/mpu6886/mpu6886_batch.c -lm -o mpu6886_batch_bench
+
+    Converts random frames with the structure of arrays kernels and with a per frame reference that decodes and
+    scales one vector at a time, the way the driver converts single samples; checks they agree and reports the
+    time per frame of both at several batch sizes, for all seven channels and for the accelerometer only.
+*/
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "mpu6886_batch.h"
+
+#define BENCH_MAX_FRAMES 1024
+#define BENCH_SECONDS 0.3
+
+static uint8_t frames[BENCH_MAX_FRAMES * MPU6886_BATCH_FRAME_SIZE];
+static float columns_data[MPU6886_BATCH_CHANNELS][BENCH_MAX_FRAMES];
+static float reference[BENCH_MAX_FRAMES][MPU6886_BATCH_CHANNELS];
+
+static double now_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// One frame at a time: decode the big endian values, then scale each with its own gain and offset
+static void __attribute__((noinline)) convert_reference(const uint8_t *in, size_t count, const mpu6886_conversion_t *conversion, float (*out)[MPU6886_BATCH_CHANNELS]) {
+    for (size_t i = 0; i < count; i++, in += MPU6886_BATCH_FRAME_SIZE) {
+        for (int channel = 0; channel < MPU6886_BATCH_CHANNELS; channel++) {
+            int16_t raw = (int16_t)((in[2 * channel] << 8) | in[2 * channel + 1]);
+            out[i][channel] = (float)raw * conversion->gain[channel] - conversion->offset[channel];
+        }
+    }
+}
+
+static volatile float sink;
+
+static double time_batch(size_t batch, const mpu6886_conversion_t *conversion, float *const *columns) {
+    long frames_done = 0;
+    double start = now_s(), elapsed;
+    do {
+        for (int i = 0; i < 64; i++) {
+            MPU6886_BatchConvert(frames, batch, conversion, columns);
+            frames_done += batch;
+        }
+        sink = columns[0][0];
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_SECONDS);
+    return elapsed * 1e9 / frames_done;
+}
+
+static double time_reference(size_t batch, const mpu6886_conversion_t *conversion) {
+    long frames_done = 0;
+    double start = now_s(), elapsed;
+    do {
+        for (int i = 0; i < 64; i++) {
+            convert_reference(frames, batch, conversion, reference);
+            frames_done += batch;
+        }
+        sink = reference[0][0];
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_SECONDS);
+    return elapsed * 1e9 / frames_done;
+}
+
+int main(void) {
+    static const size_t batches[] = { 1, 8, 32, 128, 1024 };
+    mpu6886_conversion_t conversion;
+    float *all[MPU6886_BATCH_CHANNELS];
+    float *accel[MPU6886_BATCH_CHANNELS] = { columns_data[0], columns_data[1], columns_data[2] };
+    int failed = 0;
+
+    // +-8 g and +-2000 dps with a calibration, as the driver folds them
+    srand(1);
+    for (int channel = 0; channel < MPU6886_BATCH_CHANNELS; channel++) {
+        conversion.gain[channel] = (channel < 3) ? 8.0f / 32768.0f * (1.0f + 0.01f * channel) : 2000.0f / 32768.0f;
+        conversion.offset[channel] = 0.01f * (channel - 3);
+        all[channel] = columns_data[channel];
+    }
+    conversion.gain[MPU6886_CHANNEL_TEMP] = 1.0f / 326.8f;
+    conversion.offset[MPU6886_CHANNEL_TEMP] = -25.0f;
+    for (size_t i = 0; i < sizeof(frames); i++) {
+        frames[i] = (uint8_t)rand();
+    }
+
+    MPU6886_BatchConvert(frames, BENCH_MAX_FRAMES, &conversion, all);
+    convert_reference(frames, BENCH_MAX_FRAMES, &conversion, reference);
+    double max_error = 0.0;
+    for (size_t i = 0; i < BENCH_MAX_FRAMES; i++) {
+        for (int channel = 0; channel < MPU6886_BATCH_CHANNELS; channel++) {
+            max_error = fmax(max_error, fabs(columns_data[channel][i] - reference[i][channel]));
+        }
+    }
+    printf("batch against per frame conversion: largest difference %.2e\n", max_error);
+    failed |= max_error > 1e-4;
+
+    printf("%8s %14s %14s %14s\n", "frames", "per frame ns", "batch ns", "accel only ns");
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        double per_frame = time_reference(batches[b], &conversion);
+        double batch = time_batch(batches[b], &conversion, all);
+        double accel_only = time_batch(batches[b], &conversion, accel);
+        printf("%8zu %14.2f %14.2f %14.2f\n", batches[b], per_frame, batch, accel_only);
+    }
+
+    printf("%s\n", failed ? "FAILED" : "OK");
+    return failed;
+}
@@ -0,0 +1,205 @@
+/*
+    Host check that the register maps of components/unit/regmap do not cost bus traffic: runs every BMP280 and
+    MPU6886 driver call on the simulated bus of components/unit/i2c_bus/i2c_sim.c and compares its transfers and
+    bytes on the wire with those of the drivers before the register maps.
+
+    U=components/unit
+    gcc -O2 -Itools/host -I$U/i2c_bus -I$U/ENV -I$U/mpu6886 -I$U/regmap -c tools/regmap_traffic_check.c tools/host/esp_host.c \
+        $U/i2c_bus/i2c_device.c $U/i2c_bus/i2c_sim.c $U/mpu6886/mpu6886_batch.c
+    g++ -std=c++11 -O2 -Itools/host -I$U/i2c_bus -I$U/ENV -I$U/mpu6886 -I$U/regmap -c $U/ENV/env.cpp $U/mpu6886/mpu6886.cpp
+    g++ *.o -lm -o regmap_traffic_check && rm *.o
+
+    regmap_traffic_check [-r]
+
+    The calls run once each in table order after a cold start, so the config writes see the shadow registers that
+    init left. Exits non zero if a call transfers more than its reference, or fails. The reference table was
+    measured with this tool against the tree before regmap.hpp was added, its C drivers env.c and mpu6886.c compiled
+    with gcc in place of env.cpp, mpu6886.cpp and mpu6886_batch.c; -r prints the measurements as table entries.
+*/
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_host.h"
+#include "i2c_device.h"
+#include "i2c_sim.h"
+#include "env.h"
+#include "mpu6886.h"
+
+typedef struct {
+    const char *name;
+    uint32_t transactions;
+    uint32_t bytes;
+} traffic_t;
+
+// Drivers before the register maps
+static const traffic_t reference[] = {
+    { "bmp280_init", 28, 113 },
+    { "bmp280_set_work_mode", 1, 3 },
+    { "bmp280_set_standby_time", 1, 3 },
+    { "bmp280_set_filter_mode", 1, 3 },
+    { "bmp280_set_temperature_oversampling_mode", 1, 3 },
+    { "bmp280_set_pressure_oversampling_mode", 1, 3 },
+    { "bmp280_get_temperature", 3, 12 },
+    { "bmp280_get_pressure", 3, 12 },
+    { "bmp280_get_temperature_and_pressure", 6, 24 },
+    { "bmp280_add_sample_ops", 2, 12 },
+    { "MPU6886_Init", 11, 42 },
+    { "MPU6886_SetAccelFSR", 1, 3 },
+    { "MPU6886_SetGyroFSR", 1, 3 },
+    { "MPU6886_SetSampleRateDivider", 1, 3 },
+    { "MPU6886_GetAccelFSR", 0, 0 },
+    { "MPU6886_GetGyroFSR", 0, 0 },
+    { "MPU6886_GetSampleRateDivider", 0, 0 },
+    { "MPU6886_IsDataReady", 1, 4 },
+    { "MPU6886_GetAccelAdc", 1, 9 },
+    { "MPU6886_GetGyroAdc", 1, 9 },
+    { "MPU6886_GetTempAdc", 1, 5 },
+    { "MPU6886_GetAccelGyroAdc", 1, 17 },
+    { "MPU6886_AddSampleOps", 1, 17 },
+};
+
+static uint8_t scratch[16];
+static i2c_op_t sweep_ops[4];
+
+static void bmp280_init_call(void) { bmp280_init(); }
+static void bmp280_forced_mode(void) { bmp280_set_work_mode(BMP280_FORCED_MODE); }
+static void bmp280_standby(void) { bmp280_set_standby_time(BMP280_T_SB3); }
+static void bmp280_filter(void) { bmp280_set_filter_mode(BMP280_FILTER_MODE_4); }
+static void bmp280_t_oversampling(void) { bmp280_set_temperature_oversampling_mode(BMP280_T_MODE_2); }
+static void bmp280_p_oversampling(void) { bmp280_set_pressure_oversampling_mode(BMP280_P_MODE_3); }
+static void bmp280_temperature(void) { bmp280_get_temperature(); }
+static void bmp280_pressure(void) { bmp280_get_pressure(); }
+
+static void bmp280_temperature_and_pressure(void) {
+    double temperature, pressure;
+    bmp280_get_temperature_and_pressure(&temperature, &pressure);
+}
+
+static void bmp280_sweep(void) {
+    i2c_transaction_t transaction;
+    i2c_transaction_init(&transaction, sweep_ops, 4);
+    bmp280_add_sample_ops(&transaction);
+    i2c_transaction_execute(&transaction);
+}
+
+static void mpu6886_init_call(void) { MPU6886_Init(); }
+static void mpu6886_accel_fsr(void) { MPU6886_SetAccelFSR(MPU6886_AFS_4G); }
+static void mpu6886_gyro_fsr(void) { MPU6886_SetGyroFSR(MPU6886_GFS_500DPS); }
+static void mpu6886_divider(void) { MPU6886_SetSampleRateDivider(4); }
+static void mpu6886_get_accel_fsr(void) { scratch[0] = (uint8_t)MPU6886_GetAccelFSR(); }
+static void mpu6886_get_gyro_fsr(void) { scratch[0] = (uint8_t)MPU6886_GetGyroFSR(); }
+static void mpu6886_get_divider(void) { scratch[0] = MPU6886_GetSampleRateDivider(); }
+static void mpu6886_data_ready(void) { scratch[0] = MPU6886_IsDataReady(); }
+
+static void mpu6886_accel_adc(void) {
+    int16_t x, y, z;
+    MPU6886_GetAccelAdc(&x, &y, &z);
+}
+
+static void mpu6886_gyro_adc(void) {
+    int16_t x, y, z;
+    MPU6886_GetGyroAdc(&x, &y, &z);
+}
+
+static void mpu6886_temp_adc(void) {
+    int16_t t;
+    MPU6886_GetTempAdc(&t);
+}
+
+static void mpu6886_accel_gyro_adc(void) {
+    int16_t accel[3], gyro[3];
+    MPU6886_GetAccelGyroAdc(accel, gyro);
+}
+
+static void mpu6886_sweep(void) {
+    i2c_transaction_t transaction;
+    i2c_transaction_init(&transaction, sweep_ops, 4);
+    MPU6886_AddSampleOps(&transaction);
+    i2c_transaction_execute(&transaction);
+}
+
+static const struct {
+    const char *name;
+    void (*call)(void);
+} calls[] = {
+    { "bmp280_init", bmp280_init_call },
+    { "bmp280_set_work_mode", bmp280_forced_mode },
+    { "bmp280_set_standby_time", bmp280_standby },
+    { "bmp280_set_filter_mode", bmp280_filter },
+    { "bmp280_set_temperature_oversampling_mode", bmp280_t_oversampling },
+    { "bmp280_set_pressure_oversampling_mode", bmp280_p_oversampling },
+    { "bmp280_get_temperature", bmp280_temperature },
+    { "bmp280_get_pressure", bmp280_pressure },
+    { "bmp280_get_temperature_and_pressure", bmp280_temperature_and_pressure },
+    { "bmp280_add_sample_ops", bmp280_sweep },
+    { "MPU6886_Init", mpu6886_init_call },
+    { "MPU6886_SetAccelFSR", mpu6886_accel_fsr },
+    { "MPU6886_SetGyroFSR", mpu6886_gyro_fsr },
+    { "MPU6886_SetSampleRateDivider", mpu6886_divider },
+    { "MPU6886_GetAccelFSR", mpu6886_get_accel_fsr },
+    { "MPU6886_GetGyroFSR", mpu6886_get_gyro_fsr },
+    { "MPU6886_GetSampleRateDivider", mpu6886_get_divider },
+    { "MPU6886_IsDataReady", mpu6886_data_ready },
+    { "MPU6886_GetAccelAdc", mpu6886_accel_adc },
+    { "MPU6886_GetGyroAdc", mpu6886_gyro_adc },
+    { "MPU6886_GetTempAdc", mpu6886_temp_adc },
+    { "MPU6886_GetAccelGyroAdc", mpu6886_accel_gyro_adc },
+    { "MPU6886_AddSampleOps", mpu6886_sweep },
+};
+
+static const traffic_t *find_reference(const char *name) {
+    for (size_t i = 0; i < sizeof(reference) / sizeof(reference[0]); i++) {
+        if (strcmp(reference[i].name, name) == 0) {
+            return &reference[i];
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char **argv) {
+    int print_reference = (argc > 1 && strcmp(argv[1], "-r") == 0);
+    int failed = 0;
+
+    i2c_sim_config_t config;
+    i2c_sim_default_config(&config);
+    config.realtime = 0;
+    i2c_sim_install(&config);
+
+    if (!print_reference) {
+        printf("%-42s %16s %16s\n", "", "transfers", "bytes");
+    }
+    for (size_t i = 0; i < sizeof(calls) / sizeof(calls[0]); i++) {
+        i2c_sim_stats_t stats;
+        i2c_sim_reset_stats();
+        calls[i].call();
+        i2c_sim_get_stats(&stats);
+
+        if (print_reference) {
+            printf("    { \"%s\", %lu, %lu },\n", calls[i].name, (unsigned long)stats.transactions, (unsigned long)stats.bytes);
+            continue;
+        }
+
+        const traffic_t *before = find_reference(calls[i].name);
+        const char *verdict = "";
+        if (stats.nacks + stats.timeouts != 0) {
+            verdict = "  FAIL: transfers failed";
+            failed = 1;
+        } else if (before == NULL) {
+            verdict = "  no reference";
+        } else if (stats.transactions > before->transactions || stats.bytes > before->bytes) {
+            verdict = "  FAIL: more traffic";
+            failed = 1;
+        }
+        if (before != NULL) {
+            printf("%-42s %6lu <- %-6lu %6lu <- %lu%s\n", calls[i].name, (unsigned long)stats.transactions, (unsigned long)before->transactions,
+                   (unsigned long)stats.bytes, (unsigned long)before->bytes, verdict);
+        } else {
+            printf("%-42s %6lu %-9s %6lu%s\n", calls[i].name, (unsigned long)stats.transactions, "", (unsigned long)stats.bytes, verdict);
+        }
+    }
+
+    if (!print_reference) {
+        printf("%s\n", failed ? "FAILED" : "OK");
+    }
+    return failed;
+}